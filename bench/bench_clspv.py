@@ -0,0 +1,279 @@
+#!/usr/bin/env python
+
+# Copyright 2018 The Clspv Authors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Measure how fast clspv compiles a corpus of kernels, and compare the
+results with a baseline.
+
+Each program in the corpus is compiled several times.  For each program this
+records the best wall time of each stage, as reported by -time-report-json,
+the peak resident set size of the compiler, and the size of the SPIR-V it
+produces.  A program's first line may give extra options after
+"// BENCH-OPTIONS:".
+
+Given a reference executable, such as a build of the commit before a change,
+it measures that too, compiling each program with both in turn, and prints
+how each metric changed.
+"""
+
+from __future__ import print_function
+
+import argparse
+import glob
+import json
+import os
+import os.path
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+# Marks the line of a corpus program that gives extra options.
+OPTIONS_MARKER = '// BENCH-OPTIONS:'
+
+# The metrics compared with the baseline, and the option giving the relative
+# increase over the baseline that each may show before it is a regression.
+METRICS = [
+    ('wall_seconds', 'time_tolerance'),
+    ('frontend_seconds', 'time_tolerance'),
+    ('optimizer_seconds', 'time_tolerance'),
+    ('spirv_seconds', 'time_tolerance'),
+    ('peak_rss_kb', 'rss_tolerance'),
+    ('output_bytes', 'size_tolerance'),
+]
+
+# The -time-report steps that make up the frontend stage.  The SPIR-V stage
+# is the SPIR-V Producer pass, and the optimizer stage is every other pass.
+FRONTEND_STEPS = ['Frontend setup', 'Parse and generate IR']
+SPIRV_STEPS = ['SPIR-V Producer']
+
+# Changes smaller than these are noise, whatever the tolerance.
+MIN_SECONDS = 0.005
+MIN_RSS_KB = 1024
+
+
+def read_options(path):
+    """Returns the extra options given in the corpus program at |path|."""
+    with open(path) as f:
+        first_line = f.readline().strip()
+    if first_line.startswith(OPTIONS_MARKER):
+        return first_line[len(OPTIONS_MARKER):].split()
+    return []
+
+
+def run_clspv(command):
+    """Runs |command|, and returns its wall time and peak resident set size
+    in kilobytes, which is None where the platform can't report it."""
+    start = time.time()
+    process = subprocess.Popen(command)
+    if hasattr(os, 'wait4'):
+        _, status, usage = os.wait4(process.pid, 0)
+        returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1
+        peak_rss_kb = usage.ru_maxrss
+        if sys.platform == 'darwin':
+            # macOS reports bytes rather than kilobytes.
+            peak_rss_kb //= 1024
+    else:
+        returncode = process.wait()
+        peak_rss_kb = None
+    wall_seconds = time.time() - start
+    if returncode != 0:
+        raise RuntimeError('command failed: ' + ' '.join(command))
+    return wall_seconds, peak_rss_kb
+
+
+def measure(clspv, path, runs, workdir, extra_options):
+    """Compiles the program at |path| |runs| times, and returns its metrics.
+    Times are the best of all runs, which is the least noisy estimate."""
+    name = os.path.splitext(os.path.basename(path))[0]
+    output = os.path.join(workdir, name + '.spv')
+    report = os.path.join(workdir, name + '.json')
+    command = ([clspv, path, '-o', output, '-time-report-json=' + report] +
+               read_options(path) + extra_options)
+
+    result = {}
+    for _ in range(runs):
+        wall_seconds, peak_rss_kb = run_clspv(command)
+        with open(report) as f:
+            steps = json.load(f)['steps']
+        frontend = sum(s['wall_seconds'] for s in steps
+                       if s['name'] in FRONTEND_STEPS)
+        spirv = sum(s['wall_seconds'] for s in steps
+                    if s['name'] in SPIRV_STEPS)
+        optimizer = sum(s['wall_seconds'] for s in steps
+                        if s['name'] not in FRONTEND_STEPS + SPIRV_STEPS)
+        run = {
+            'wall_seconds': wall_seconds,
+            'frontend_seconds': frontend,
+            'optimizer_seconds': optimizer,
+            'spirv_seconds': spirv,
+            'peak_rss_kb': peak_rss_kb,
+        }
+        for key, value in run.items():
+            if value is not None and (key not in result or
+                                      value < result[key]):
+                result[key] = value
+    result['output_bytes'] = os.path.getsize(output)
+    return name, result
+
+
+def compare(results, baseline, args):
+    """Returns a description of each metric in |results| that regressed
+    beyond its tolerance compared with |baseline|."""
+    regressions = []
+    for name in sorted(results):
+        if name not in baseline:
+            print('note: {} is not in the baseline'.format(name))
+            continue
+        for metric, tolerance_option in METRICS:
+            old = baseline[name].get(metric)
+            new = results[name].get(metric)
+            if old is None or new is None:
+                continue
+            tolerance = getattr(args, tolerance_option)
+            if metric.endswith('_seconds'):
+                noise = MIN_SECONDS
+            elif metric == 'peak_rss_kb':
+                noise = MIN_RSS_KB
+            else:
+                noise = 0
+            if new > old * (1 + tolerance) and new - old > noise:
+                regressions.append(
+                    '{} {}: {} -> {} (+{:.1f}%, tolerance {:.1f}%)'.format(
+                        name, metric, old, new,
+                        100.0 * (new - old) / old if old else float('inf'),
+                        100.0 * tolerance))
+    return regressions
+
+
+def format_value(metric, value):
+    """Returns |value| of |metric| as text."""
+    if metric.endswith('_seconds'):
+        return '{:.3f}s'.format(value)
+    return str(value)
+
+
+def print_changes(results, reference):
+    """Prints how each metric in |results| differs from |reference|."""
+    for name in sorted(results):
+        if name not in reference:
+            continue
+        for metric, _ in METRICS:
+            old = reference[name].get(metric)
+            new = results[name].get(metric)
+            if old is None or new is None:
+                continue
+            print('{:<24} {:<18} {:>10} -> {:>10}  {}'.format(
+                name, metric, format_value(metric, old),
+                format_value(metric, new),
+                '{:+.1f}%'.format(100.0 * (new - old) / old) if old else ''))
+
+
+def print_result(name, result):
+    """Prints the metrics of the program called |name|."""
+    print('{:<24} {:8.3f}s  frontend {:.3f}s  optimizer {:.3f}s  '
+          'spirv {:.3f}s  rss {} KB  output {} bytes'.format(
+              name, result['wall_seconds'], result['frontend_seconds'],
+              result['optimizer_seconds'], result['spirv_seconds'],
+              result.get('peak_rss_kb', '?'), result['output_bytes']))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--clspv', required=True,
+                        help='the clspv executable to measure')
+    parser.add_argument('--corpus', required=True,
+                        help='the directory of .cl programs to compile')
+    parser.add_argument('--output', required=True,
+                        help='the file to write the results to, as JSON')
+    parser.add_argument('--reference',
+                        help='a clspv executable to measure as well, and '
+                        'compare with')
+    parser.add_argument('--clspv-options', default='',
+                        help='extra options to compile every program with, '
+                        'such as -time-passes')
+    parser.add_argument('--baseline',
+                        help='a results file to compare with, if it exists')
+    parser.add_argument('--update-baseline', action='store_true',
+                        help='write the results to the baseline file, '
+                        'rather than compare with it')
+    parser.add_argument('--runs', type=int, default=5,
+                        help='the number of times to compile each program')
+    parser.add_argument('--time-tolerance', type=float, default=0.10,
+                        help='the relative increase in a time that is not '
+                        'a regression')
+    parser.add_argument('--rss-tolerance', type=float, default=0.10,
+                        help='the relative increase in peak RSS that is not '
+                        'a regression')
+    parser.add_argument('--size-tolerance', type=float, default=0.0,
+                        help='the relative increase in output size that is '
+                        'not a regression')
+    args = parser.parse_args()
+
+    programs = sorted(glob.glob(os.path.join(args.corpus, '*.cl')))
+    if not programs:
+        print('error: no programs in ' + args.corpus, file=sys.stderr)
+        return 1
+
+    workdir = tempfile.mkdtemp(prefix='bench-clspv-')
+    extra_options = args.clspv_options.split()
+    results = {}
+    reference = {}
+    try:
+        for path in programs:
+            if args.reference:
+                name, result = measure(args.reference, path, args.runs,
+                                       workdir, extra_options)
+                reference[name] = result
+                print_result(name + ' (reference)', result)
+            name, result = measure(args.clspv, path, args.runs, workdir,
+                                   extra_options)
+            results[name] = result
+            print_result(name, result)
+    finally:
+        shutil.rmtree(workdir)
+
+    with open(args.output, 'w') as f:
+        json.dump(results, f, indent=2, sort_keys=True)
+    if args.reference:
+        with open(os.path.splitext(args.output)[0] + '.reference.json',
+                  'w') as f:
+            json.dump(reference, f, indent=2, sort_keys=True)
+        print('\nChanges from the reference:')
+        print_changes(results, reference)
+
+    if not args.baseline:
+        return 0
+    if args.update_baseline:
+        with open(args.baseline, 'w') as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+        print('wrote baseline ' + args.baseline)
+        return 0
+    if not os.path.exists(args.baseline):
+        print('note: no baseline at {}, nothing to compare with'.format(
+            args.baseline))
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    regressions = compare(results, baseline, args)
+    for regression in regressions:
+        print('regression: ' + regression, file=sys.stderr)
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,134 @@
+#!/usr/bin/env python
+
+# Copyright 2018 The Clspv Authors. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Check that two clspv executables produce the same output for the tests.
+
+Each clspv command in the RUN lines of each test is run with both
+executables, and the SPIR-V and descriptor maps they write are compared byte
+for byte.  This shows that a change meant to leave the output alone, such as
+reorganizing passes, does, when the reference is built from the commit before
+it.
+"""
+
+from __future__ import print_function
+
+import argparse
+import filecmp
+import os
+import os.path
+import shutil
+import subprocess
+import sys
+import tempfile
+
+RUN_MARKER = '// RUN: clspv '
+
+
+def read_commands(path):
+    """Returns the arguments of each clspv command in the RUN lines of the
+    test at |path|, without its outputs.  Commands that read standard input
+    or write to a pipe are left out."""
+    commands = []
+    with open(path) as f:
+        for line in f:
+            if not line.startswith(RUN_MARKER):
+                continue
+            words = line[len(RUN_MARKER):].split()
+            if any(w in ('<', '>', '|', '-') for w in words):
+                continue
+            args = []
+            i = 0
+            while i < len(words):
+                word = words[i]
+                if word == '-o':
+                    i += 2
+                    continue
+                if (word.startswith('-descriptormap') or
+                        word.startswith('-time-')):
+                    i += 1
+                    continue
+                word = word.replace('%s', path)
+                word = word.replace('%S', os.path.dirname(path))
+                args.append(word)
+                i += 1
+            if any('%' in a for a in args):
+                continue
+            commands.append(args)
+    return commands
+
+
+def run(clspv, args, workdir, prefix):
+    """Runs |clspv| with |args|, and returns the paths of the SPIR-V and
+    descriptor map it writes, or None if it fails."""
+    output = os.path.join(workdir, prefix + '.spv')
+    descriptor_map = os.path.join(workdir, prefix + '.map')
+    command = ([clspv] + args +
+               ['-o', output, '-descriptormap=' + descriptor_map])
+    with open(os.devnull, 'w') as devnull:
+        if subprocess.call(command, stdout=devnull, stderr=devnull) != 0:
+            return None
+    return output, descriptor_map
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('--clspv', required=True,
+                        help='the clspv executable to check')
+    parser.add_argument('--reference', required=True,
+                        help='the clspv executable to compare with')
+    parser.add_argument('--tests', required=True,
+                        help='the directory of .cl tests to compile')
+    args = parser.parse_args()
+
+    tests = []
+    for root, _, files in os.walk(args.tests):
+        tests += [os.path.join(root, f) for f in files if f.endswith('.cl')]
+    tests.sort()
+    if not tests:
+        print('error: no tests in ' + args.tests, file=sys.stderr)
+        return 1
+
+    workdir = tempfile.mkdtemp(prefix='compare-clspv-')
+    compared = 0
+    differences = []
+    try:
+        for path in tests:
+            for n, command in enumerate(read_commands(path)):
+                name = '{}#{}'.format(os.path.relpath(path, args.tests), n)
+                new = run(args.clspv, command, workdir, 'new')
+                old = run(args.reference, command, workdir, 'old')
+                if new is None and old is None:
+                    continue
+                if new is None or old is None:
+                    differences.append(name + ': only one compiles')
+                    continue
+                for new_file, old_file in zip(new, old):
+                    if not filecmp.cmp(new_file, old_file, shallow=False):
+                        differences.append('{}: {} differs'.format(
+                            name, os.path.splitext(new_file)[1]))
+                compared += 1
+    finally:
+        shutil.rmtree(workdir)
+
+    for difference in differences:
+        print('difference: ' + difference, file=sys.stderr)
+    print('compared {} compilations, {} differ'.format(compared,
+                                                        len(differences)))
+    return 1 if differences else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,40 @@
+// BENCH-OPTIONS: -module-constants-in-storage-buffer
+// Large __constant lookup tables, of scalars and of vectors.
+
+#define V(i) ((float)(i) * 0.001953125f - 4.0f)
+#define X4(i) V(i), V(i + 1), V(i + 2), V(i + 3)
+#define X16(i) X4(i), X4(i + 4), X4(i + 8), X4(i + 12)
+#define X64(i) X16(i), X16(i + 16), X16(i + 32), X16(i + 48)
+#define X256(i) X64(i), X64(i + 64), X64(i + 128), X64(i + 192)
+#define X1024(i) X256(i), X256(i + 256), X256(i + 512), X256(i + 768)
+
+constant float curve[4096] = {X1024(0), X1024(1024), X1024(2048),
+                              X1024(3072)};
+
+#define W(i) (int)((i) * 2654435761u >> 20)
+#define Y4(i) W(i), W(i + 1), W(i + 2), W(i + 3)
+#define Y16(i) Y4(i), Y4(i + 4), Y4(i + 8), Y4(i + 12)
+#define Y64(i) Y16(i), Y16(i + 16), Y16(i + 32), Y16(i + 48)
+#define Y256(i) Y64(i), Y64(i + 64), Y64(i + 128), Y64(i + 192)
+
+constant int hashes[1024] = {Y256(0), Y256(256), Y256(512), Y256(768)};
+
+#define C(i) (float4)(V(i), V(i + 1), V(i + 2), 1.0f)
+#define Z4(i) C(i), C(i + 1), C(i + 2), C(i + 3)
+#define Z16(i) Z4(i), Z4(i + 4), Z4(i + 8), Z4(i + 12)
+#define Z64(i) Z16(i), Z16(i + 16), Z16(i + 32), Z16(i + 48)
+
+constant float4 palette[256] = {Z64(0), Z64(64), Z64(128), Z64(192)};
+
+kernel void lookup(global float *out, global const float *in) {
+  int i = get_global_id(0);
+  float x = clamp(in[i], -4.0f, 4.0f);
+  int index = (int)((x + 4.0f) * 512.0f) & 4095;
+  out[i] = curve[index] + (float)hashes[index & 1023];
+}
+
+kernel void colorize(global float4 *out, global const float *in) {
+  int i = get_global_id(0);
+  int index = hashes[i & 1023] & 255;
+  out[i] = palette[index] * in[i];
+}
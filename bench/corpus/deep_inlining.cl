@@ -0,0 +1,32 @@
+// A call tree of helper functions, each called twice by the level above, all
+// of which are inlined into the kernels.
+
+#define LEVEL(n, next)                                                         \
+  float level##n(float x, global const float *table, int i) {                 \
+    float a = next(x * 0.5f + table[i & 63], table, i + 1);                    \
+    float b = next(x - a * 0.25f, table, i + 3);                               \
+    return a > b ? a - b * x : b + a * x;                                      \
+  }
+
+float level0(float x, global const float *table, int i) {
+  return sqrt(fabs(x)) + table[i & 63];
+}
+
+LEVEL(1, level0)
+LEVEL(2, level1)
+LEVEL(3, level2)
+LEVEL(4, level3)
+LEVEL(5, level4)
+LEVEL(6, level5)
+LEVEL(7, level6)
+LEVEL(8, level7)
+
+kernel void deep_a(global float *out, global const float *table) {
+  int i = get_global_id(0);
+  out[i] = level8(out[i], table, i);
+}
+
+kernel void deep_b(global float *out, global const float *table, float bias) {
+  int i = get_global_id(0);
+  out[i] = level7(out[i] + bias, table, i) * level6(bias, table, i);
+}
@@ -0,0 +1,24 @@
+// One kernel with a long straight-line body.  Most of its compile time and
+// memory goes to generating SPIR-V instructions rather than to the optimizer.
+
+#define STEP                                                                   \
+  acc = mad(acc, in[j & mask], acc.yzwx);                                      \
+  j = j * 5 + 1;
+#define STEP2 STEP STEP
+#define STEP4 STEP2 STEP2
+#define STEP8 STEP4 STEP4
+#define STEP16 STEP8 STEP8
+#define STEP32 STEP16 STEP16
+#define STEP64 STEP32 STEP32
+#define STEP128 STEP64 STEP64
+#define STEP256 STEP128 STEP128
+#define STEP512 STEP256 STEP256
+#define STEP1024 STEP512 STEP512
+
+kernel void long_body(global float4 *out, global const float4 *in,
+                      uint mask) {
+  uint j = get_global_id(0);
+  float4 acc = in[j & mask];
+  STEP1024
+  out[get_global_id(0)] = acc;
+}
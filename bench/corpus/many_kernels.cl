@@ -0,0 +1,34 @@
+// Many kernels in one module, each with its own arguments and a mix of
+// integer and floating point work.
+
+#define KERNEL(n)                                                              \
+  kernel void saxpy_##n(global float *y, global const float *x, float a,      \
+                        int count) {                                           \
+    int i = get_global_id(0);                                                  \
+    if (i < count) {                                                           \
+      y[i] = a * x[i] + y[i] + (float)(n);                                     \
+    }                                                                          \
+  }                                                                            \
+  kernel void histogram_##n(global const uint *data, global uint *bins,       \
+                            local uint *scratch, uint shift) {                 \
+    uint l = get_local_id(0);                                                  \
+    scratch[l] = 0;                                                            \
+    barrier(CLK_LOCAL_MEM_FENCE);                                              \
+    uint bin = (data[get_global_id(0)] >> shift) & (get_local_size(0) - 1);    \
+    atomic_inc(&scratch[bin]);                                                 \
+    barrier(CLK_LOCAL_MEM_FENCE);                                              \
+    atomic_add(&bins[l], scratch[l] + (n));                                    \
+  }                                                                            \
+  kernel void blend_##n(global float4 *out, global const float4 *a,           \
+                        global const float4 *b, float t) {                     \
+    size_t i = get_global_id(0);                                               \
+    out[i] = mix(a[i], b[i], t) * (float4)((n), 1.0f, 0.5f, 0.25f);            \
+  }
+
+#define KERNELS4(n) KERNEL(n##0) KERNEL(n##1) KERNEL(n##2) KERNEL(n##3)
+#define KERNELS16(n) KERNELS4(n##0) KERNELS4(n##1) KERNELS4(n##2) KERNELS4(n##3)
+
+KERNELS16(1)
+KERNELS16(2)
+KERNELS16(3)
+KERNELS16(4)
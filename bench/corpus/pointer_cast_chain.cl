@@ -0,0 +1,65 @@
+// A long chain of pointer casts, each with an offset, and a deep chain of
+// calls that each pass a cast pointer on, all of which are inlined.
+
+#define CAST1 p = (global uint *)((global float *)p + 1);
+#define CAST2 CAST1 CAST1
+#define CAST4 CAST2 CAST2
+#define CAST8 CAST4 CAST4
+#define CAST16 CAST8 CAST8
+#define CAST32 CAST16 CAST16
+#define CAST64 CAST32 CAST32
+#define CAST128 CAST64 CAST64
+#define CAST256 CAST128 CAST128
+#define CAST512 CAST256 CAST256
+#define CAST1024 CAST512 CAST512
+#define CAST2048 CAST1024 CAST1024
+#define CAST4096 CAST2048 CAST2048
+#define CAST8192 CAST4096 CAST4096
+
+kernel void casts(global uint *A, uint x) {
+  global uint *p = A + get_global_id(0);
+  CAST8192
+  *p = x;
+}
+
+#define CALL_AS_FLOAT(n, m)                                                    \
+  void f##n(global uint *p, uint x) { f##m((global float *)p + 1, x); }
+#define CALL_AS_UINT(n, m)                                                     \
+  void f##n(global float *p, uint x) { f##m((global uint *)p + 1, x + 1); }
+
+void f0(global uint *p, uint x) { *p = x; }
+
+CALL_AS_UINT(1, 0)
+CALL_AS_FLOAT(2, 1)
+CALL_AS_UINT(3, 2)
+CALL_AS_FLOAT(4, 3)
+CALL_AS_UINT(5, 4)
+CALL_AS_FLOAT(6, 5)
+CALL_AS_UINT(7, 6)
+CALL_AS_FLOAT(8, 7)
+CALL_AS_UINT(9, 8)
+CALL_AS_FLOAT(10, 9)
+CALL_AS_UINT(11, 10)
+CALL_AS_FLOAT(12, 11)
+CALL_AS_UINT(13, 12)
+CALL_AS_FLOAT(14, 13)
+CALL_AS_UINT(15, 14)
+CALL_AS_FLOAT(16, 15)
+CALL_AS_UINT(17, 16)
+CALL_AS_FLOAT(18, 17)
+CALL_AS_UINT(19, 18)
+CALL_AS_FLOAT(20, 19)
+CALL_AS_UINT(21, 20)
+CALL_AS_FLOAT(22, 21)
+CALL_AS_UINT(23, 22)
+CALL_AS_FLOAT(24, 23)
+CALL_AS_UINT(25, 24)
+CALL_AS_FLOAT(26, 25)
+CALL_AS_UINT(27, 26)
+CALL_AS_FLOAT(28, 27)
+CALL_AS_UINT(29, 28)
+CALL_AS_FLOAT(30, 29)
+CALL_AS_UINT(31, 30)
+CALL_AS_FLOAT(32, 31)
+
+kernel void calls(global uint *A, uint x) { f32(A + get_global_id(0), x); }
@@ -0,0 +1,31 @@
+// A tiled matrix multiply through local memory, unrolled.
+
+#define TILE 16
+
+kernel void sgemm(global const float *A, global const float *B,
+                  global float *C, int M, int N, int K, float alpha,
+                  float beta) {
+  local float tileA[TILE][TILE];
+  local float tileB[TILE][TILE];
+
+  int row = get_local_id(1);
+  int col = get_local_id(0);
+  int globalRow = TILE * get_group_id(1) + row;
+  int globalCol = TILE * get_group_id(0) + col;
+
+  float acc = 0.0f;
+  for (int t = 0; t < K / TILE; t++) {
+    tileA[row][col] = A[globalRow * K + t * TILE + col];
+    tileB[row][col] = B[(t * TILE + row) * N + globalCol];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+#pragma unroll
+    for (int k = 0; k < TILE; k++) {
+      acc = mad(tileA[row][k], tileB[k][col], acc);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+  }
+
+  C[globalRow * N + globalCol] =
+      alpha * acc + beta * C[globalRow * N + globalCol];
+}
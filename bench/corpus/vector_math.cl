@@ -0,0 +1,53 @@
+// Heavy float4 arithmetic, geometric and math builtins, and vector loads and
+// stores of scalar arrays.
+
+float4 rotate(float4 q, float4 v) {
+  float3 t = 2.0f * cross(q.xyz, v.xyz);
+  return (float4)(v.xyz + q.w * t + cross(q.xyz, t), v.w);
+}
+
+float4 shade(float4 normal, float4 light, float4 view, float4 albedo) {
+  float4 n = normalize(normal);
+  float4 l = normalize(light);
+  float4 h = normalize(l + normalize(view));
+  float diffuse = max(dot(n, l), 0.0f);
+  float specular = pow(max(dot(n, h), 0.0f), 32.0f);
+  return albedo * diffuse + (float4)(specular);
+}
+
+kernel void transform(global float4 *positions, global const float4 *rotations,
+                      float4 translation, int steps) {
+  size_t i = get_global_id(0);
+  float4 p = positions[i];
+  float4 q = normalize(rotations[i]);
+  for (int s = 0; s < steps; s++) {
+    p = rotate(q, p) + translation;
+    p = fma(p, (float4)(0.99f), (float4)(0.01f));
+  }
+  positions[i] = p;
+}
+
+kernel void lighting(global float *pixels, global const float *normals,
+                     float4 light, float4 view) {
+  size_t i = get_global_id(0);
+  float4 n = vload4(i, normals);
+  float4 c = shade(n, light, view, (float4)(0.8f, 0.6f, 0.4f, 1.0f));
+  c += shade(n, light.yzxw, view, (float4)(0.1f, 0.2f, 0.3f, 1.0f));
+  c += shade(n, light.zxyw, view.yxzw, (float4)(0.3f, 0.1f, 0.2f, 1.0f));
+  vstore4(clamp(c, 0.0f, 1.0f), i, pixels);
+}
+
+kernel void filter(global float4 *out, global const float4 *in, int width) {
+  int x = get_global_id(0);
+  int y = get_global_id(1);
+  float4 sum = (float4)(0.0f);
+  float weight = 0.0f;
+  for (int dy = -2; dy <= 2; dy++) {
+    for (int dx = -2; dx <= 2; dx++) {
+      float w = exp(-(float)(dx * dx + dy * dy) * 0.5f);
+      sum += w * in[(y + dy) * width + x + dx];
+      weight += w;
+    }
+  }
+  out[y * width + x] = sum / weight;
+}
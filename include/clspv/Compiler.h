@@ -0,0 +1,54 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_INCLUDE_CLSPV_COMPILER_H_
+#define CLSPV_INCLUDE_CLSPV_COMPILER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace clspv {
+
+// Compiles as the clspv command line tool does, given its command line
+// |argc| and |argv|.  Returns 0 on success.
+int Compile(const int argc, const char *const argv[]);
+
+// Compiles the OpenCL C source in |program| to a SPIR-V module.  The
+// |options| are given as on the clspv command line, but must not name input
+// or output files, nor select an output format other than a SPIR-V binary.
+// Nor may they be LLVM's own options, which would apply to later calls too.
+// The |sampler_map| holds the contents of a literal sampler map file, or is
+// empty if there is none.
+//
+// Returns 0 on success, having stored the SPIR-V words in |output_binary|
+// and the descriptor map in |output_descriptor_map|, if not null.  Errors
+// are stored in |output_log|, if not null.  If |output_time_report| is not
+// null, the time and heap memory each compilation step took is stored in it
+// as a JSON object, in the format written by the -time-report-json option.
+//
+// This can be called from several threads at once.  Each call compiles in
+// its own clang and LLVM contexts, while the builtins header, the option
+// tables and the registered passes are set up once and shared by all calls.
+int CompileFromSourceString(const std::string &program,
+                            const std::string &sampler_map,
+                            const std::string &options,
+                            std::vector<uint32_t> *output_binary,
+                            std::string *output_descriptor_map = nullptr,
+                            std::string *output_log = nullptr,
+                            std::string *output_time_report = nullptr);
+
+} // namespace clspv
+
+#endif
@@ -12,12 +12,23 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <memory>
+#include <string>
+
 namespace clspv {
 namespace Option {
 
+// Returns true if code generation can use SPV_KHR_8bit_storage, and the Int8
+// capability for arithmetic on the 8-bit values loaded.
+bool F8BitStorage();
+
 // Returns true if code generation can use SPV_KHR_16bit_storage.
 bool F16BitStorage();
 
+// Returns true if kernels may use the cl_khr_fp16 extension, and code
+// generation can use the Float16 capability for arithmetic on half values.
+bool FP16();
+
 // Returns true if each kernel must use its own descriptor set for all arguments.
 bool DistinctKernelDescriptorSets();
 
@@ -51,5 +62,61 @@ bool PodArgsInUniformBuffer();
 // code generation.
 bool ShowIDs();
 
+// Returns true if stack variables should be zero-initialized.
+bool ZeroInitializeAllocas();
+
+// Returns true if only the bytes of stack variables that may be read before
+// they are written should be zero-initialized.
+bool ZeroInitializeAllocasAsNeeded();
+
+// Returns true if the number of bytes of stack variables zero-initialized in
+// each function, and the number left alone, should be reported on stderr.
+bool ZeroInitializeAllocasReport();
+
+// Returns the number of threads to generate SPIR-V function bodies on, or 0
+// for one per hardware thread.  The module produced is the same for any
+// number.
+unsigned SPIRVThreads();
+
+// Returns the values of all of the options above that affect the module
+// produced as a string, which differs whenever any of those values do.
+std::string ValuesString();
+
+// The options above are command line options, shared by the whole process.
+// Constructing a ScopedValues captures their current values.  While it is
+// alive, the functions above return the captured values on the thread that
+// constructed it, even if the command line options are parsed again, e.g.
+// for a compilation on another thread.
+class ScopedValues {
+public:
+  ScopedValues();
+  ~ScopedValues();
+
+  // The captured values.  Defined in Option.cpp.
+  struct Values;
+
+  // Returns the values in effect on the calling thread, or null if they are
+  // the command line options themselves.
+  static const Values *Current();
+
+  // Makes |values|, returned by Current on another thread, the values in
+  // effect on this thread, so that it can do part of the same compilation.
+  explicit ScopedValues(const Values *values);
+
+private:
+  ScopedValues(const ScopedValues &) = delete;
+  ScopedValues &operator=(const ScopedValues &) = delete;
+
+  std::unique_ptr<const Values> Captured;
+
+  // The values captured for this thread before this instance, if any.
+  const Values *Previous;
+};
+
+// Restores the options above to their default values, before parsing a new
+// command line.  The caller must make sure no other thread is parsing or
+// reading command line options at the same time.
+void ResetToDefaults();
+
 } // namespace Option
 } // namespace clspv
@@ -59,6 +59,21 @@ llvm::ModulePass *createDefineOpenCLWorkItemBuiltinsPass();
 /// if we were creating an OpenCL library though.
 llvm::ModulePass *createFunctionInternalizerPass();
 
+/// Run the LLVM optimizations on independent parts of the module at once.
+/// @return An LLVM module pass.
+///
+/// The module is split into pieces, one for each kernel, and one for each
+/// other function that no kernel calls.  Pieces that share a function or a
+/// variable with local linkage are merged.  Other functions are copied into
+/// each piece that calls them.  Each piece is optimized in its own
+/// LLVMContext, as by PassManagerBuilder at |OptLevel| and |SizeLevel|, on up
+/// to |Threads| threads at once, or one per hardware thread if that is 0.
+/// The pieces are then linked back into the module, in their original order.
+/// The result does not depend on the number of threads.
+llvm::ModulePass *createParallelOptimizePass(unsigned Threads,
+                                             unsigned OptLevel,
+                                             unsigned SizeLevel);
+
 /// Inline call instructions which have pointer bitcast as arguments.
 /// @return An LLVM module pass.
 ///
@@ -94,6 +109,16 @@ llvm::ModulePass *createRewriteConstantExpressionsPass();
 /// builtins where appropriate.
 llvm::ModulePass *createOpenCLInlinerPass();
 
+/// Remove barriers that order no shared memory accesses.
+/// @return An LLVM module pass.
+///
+/// A barrier in a kernel orders the accesses to global and local memory made
+/// before it with those made after it.  If no such access may be made before
+/// it, or none after it, or it follows the same barrier with no access in
+/// between, it orders nothing and is removed.  Calls that may access memory
+/// count as accesses.
+llvm::ModulePass *createRemoveRedundantBarriersPass();
+
 /// Create a re-order basic blocks pass.
 /// @return An LLVM module pass.
 ///
@@ -148,23 +173,29 @@ llvm::ModulePass *createReplacePointerBitcastPass();
 /// valid SPIR-V for Vulkan (which cannot handle pointer bitcasts at all).
 llvm::ModulePass *createSimplifyPointerBitcastPass();
 
-/// Splat scalar type arguments to vector type.
+/// Legalize the instructions SPIR-V for Vulkan can't represent.
 /// @return An LLVM module pass.
 ///
-/// min/max/mix/clamp function have function prototype with scalar type on
-/// OpenCL. But vulkan does not support it. In order to fit it, the pass
-/// promotes scalar arument to vector argument.
-llvm::ModulePass *createSplatArgPass();
-
-/// Undo Clang's use of an i8 to form a bool type.
-/// @return An LLVM module pass.
-///
-/// Clang uses i8 to represent a bool as it is stored, but for SPIR-V we want
-/// the bool to remain as an i1. This pass will undo what Clang has done.
-///
-/// If we could add a SPIR-V target to Clang in future, we could do away with
-/// this pass and simply instruct Clang that bool's as stored are i1.
-llvm::ModulePass *createUndoBoolPass();
+/// This pass visits each instruction once, and legalizes those instructions
+/// it creates in turn, to undo what Clang and LLVM have done:
+/// - Clang uses i8 to represent a bool as it is stored, but for SPIR-V we want
+///   the bool to remain as an i1, so a trunc of a zext of a bool becomes the
+///   bool.
+/// - LLVM will optimize switch instruction conditions such that it will
+///   sometimes produce invalid integer types, so a switch on a truncated
+///   integer switches on the integer instead.
+/// - LLVM will generate get element pointer constant expressions when we have
+///   a constant index into a global variable, so these become instructions.
+/// - LLVM will optimize two calls to __translate_sampler_initializer into a
+///   single call with a select as the argument, which stops us from finding
+///   the samplers statically, so such a call becomes a select of two calls.
+/// - min/max/mix/clamp have overloads with scalar arguments mixed with vector
+///   ones, which Vulkan does not support, so the scalars are splatted.
+/// - A select with a scalar bool condition but vector operands gets a bool
+///   vector condition with as many elements as the operands.
+///
+/// This pass must run before the CFG is structurized, which lowers switches.
+llvm::ModulePass *createLegalizePass();
 
 /// Undo Clang's use of a pointer parameter when dealing with a struct passed as
 /// function parameter.
@@ -187,15 +218,6 @@ llvm::ModulePass *createUndoBoolPass();
 /// normal.
 llvm::ModulePass *createUndoByvalPass();
 
-/// Undo LLVM's use of get element pointer constant expressions on global
-/// variables.
-/// @return An LLVM module pass.
-///
-/// LLVM will generate get element pointer constant expressions when we have a
-/// constant index into a global variable. SPIR-V for Vulkan can't represent
-/// this, so this pass will turn them back into regular instructions.
-llvm::ModulePass *createUndoGetElementPtrConstantExprPass();
-
 /// Undo Clang's use of a pointer parameter when dealing with a struct returned
 /// from a function.
 /// @return An LLVM module pass.
@@ -216,31 +238,6 @@ llvm::ModulePass *createUndoGetElementPtrConstantExprPass();
 /// this pass and simply instruct Clang to return the struct as normal.
 llvm::ModulePass *createUndoSRetPass();
 
-/// Undo LLVM optimizing calls to __translate_sampler_initializer.
-/// @return An LLVM module pass.
-///
-/// LLVM will optimize two calls to __translate_sampler_initializer into a
-/// single call to the function, with a select as the argument. This is really
-/// bad for us when we are trying to statically find out the number of samplers
-/// we are using, and mapping them to the sampler map. This pass will undo this
-/// optimization.
-///
-/// If we could add a function attribute to LLVM to stop it ever doing any
-/// optimizations on a function that would help here.
-llvm::ModulePass *createUndoTranslateSamplerFoldPass();
-
-/// Undo LLVM optimizing switch instruction conditions by truncating them.
-/// @return An LLVM module pass.
-///
-/// LLVM will optimize switch instructions conditions such that it will
-/// sometimes produce invalid integer types. LLVM backends can handle this, but
-/// since this backend does not conform to the normal process, we undo this
-/// optimization here instead.
-///
-/// If we could add a flag to our LLVM target to indiciate "please do not create
-/// malformed types" that would make this pass redundant.
-llvm::ModulePass *createUndoTruncatedSwitchConditionPass();
-
 /// Cluster module-scope __constant variables.
 /// @return An LLVM module pass.
 ///
@@ -257,14 +254,6 @@ llvm::ModulePass *createClusterModuleScopeConstantVars();
 /// arguments (maxPerStageDescriptorStorageBuffers), which is very easy to reach.
 llvm::ModulePass *createClusterPodKernelArgumentsPass();
 
-/// Splat select scalar condition with vector data operands.
-/// @return An LLVM module pass.
-///
-/// Converts a select with scalar bool argument but vector operands so that
-/// the bool condition is converted into a bool vector with as many elements
-/// as the operands.
-llvm::ModulePass *createSplatSelectConditionPass();
-
 /// Hide loads from __constant address space.
 /// @return An LLVM module pass.
 ///
@@ -0,0 +1,406 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "BuiltinsTable.h"
+
+#include <clang/AST/ASTConsumer.h>
+#include <clang/AST/ASTContext.h>
+#include <clang/AST/Attr.h>
+#include <clang/AST/Decl.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Lex/Lexer.h>
+#include <clang/Sema/Lookup.h>
+#include <clang/Sema/Sema.h>
+#include <llvm/Support/ErrorHandling.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace clang;
+
+// Each line of the table is one overload, as tab separated fields:
+//   <name> <attributes> <return type> <parameter types>...
+// The attributes are letters: 'c' for const, 'p' for pure and 'v' for
+// convergent, or '-' for none.  A type is its local qualifiers as an opaque
+// number, then ':' and one of:
+//   b<kind>      the builtin type with the given BuiltinType::Kind
+//   t<name>;     the typedef with the given name, declared in the prelude
+//   p<type>      a pointer to <type>
+//   v<n>,<type>  an extended vector of <n> elements of <type>
+// Enumerator values are only meaningful to the Clang that wrote them.  That is
+// fine as the table is written at build time by a copy of the compiler that
+// reads it.
+
+namespace {
+
+bool EncodeType(QualType QT, llvm::raw_ostream &out) {
+  out << QT.getLocalQualifiers().getAsOpaqueValue() << ':';
+
+  const Type *Ty = QT.getTypePtr();
+  if (auto *TT = dyn_cast<TypedefType>(Ty)) {
+    out << 't' << TT->getDecl()->getName() << ';';
+    return true;
+  } else if (auto *PT = dyn_cast<PointerType>(Ty)) {
+    out << 'p';
+    return EncodeType(PT->getPointeeType(), out);
+  } else if (auto *BT = dyn_cast<BuiltinType>(Ty)) {
+    out << 'b' << static_cast<unsigned>(BT->getKind());
+    return true;
+  } else if (auto *VT = dyn_cast<ExtVectorType>(Ty)) {
+    out << 'v' << VT->getNumElements() << ',';
+    return EncodeType(VT->getElementType(), out);
+  }
+
+  return false;
+}
+
+QualType GetBuiltinType(ASTContext &Context, unsigned Kind) {
+  switch (static_cast<BuiltinType::Kind>(Kind)) {
+#define IMAGE_TYPE(ImgType, Id, SingletonId, Access, Suffix)                   \
+  case BuiltinType::Id:                                                        \
+    return Context.SingletonId;
+#include <clang/Basic/OpenCLImageTypes.def>
+#define SHARED_SINGLETON_TYPE(Expansion)
+#define BUILTIN_TYPE(Id, SingletonId)                                          \
+  case BuiltinType::Id:                                                        \
+    return Context.SingletonId;
+#include <clang/AST/BuiltinTypes.def>
+  case BuiltinType::Char_U:
+  case BuiltinType::Char_S:
+    return Context.CharTy;
+  case BuiltinType::WChar_U:
+  case BuiltinType::WChar_S:
+    return Context.WCharTy;
+  }
+
+  llvm::report_fatal_error("Unknown builtin type in OpenCL builtins table");
+}
+
+struct BuiltinsTableConsumer final : public ASTConsumer {
+  BuiltinsTableConsumer(CompilerInstance &Instance, llvm::raw_ostream &table,
+                        llvm::raw_ostream &prelude)
+      : Instance(Instance), Table(table), Prelude(prelude), Failed(false) {
+    UnsupportedDeclID = Instance.getDiagnostics().getCustomDiagID(
+        DiagnosticsEngine::Error,
+        "unsupported builtin function declaration for the builtins table");
+  }
+
+  bool HandleTopLevelDecl(DeclGroupRef DG) override {
+    for (auto *D : DG) {
+      auto *FD = dyn_cast<FunctionDecl>(D);
+      if (!FD || FD->hasBody() || !FD->hasAttr<OverloadableAttr>()) {
+        continue;
+      }
+
+      if (!AddOverload(FD)) {
+        Instance.getDiagnostics().Report(FD->getLocation(), UnsupportedDeclID);
+        Failed = true;
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  void HandleTranslationUnit(ASTContext &) override {
+    if (Failed) {
+      return;
+    }
+
+    // Group the overloads of each builtin together, in declaration order.
+    std::stable_sort(Overloads.begin(), Overloads.end(),
+                     [](const std::pair<StringRef, std::string> &lhs,
+                        const std::pair<StringRef, std::string> &rhs) {
+                       return lhs.first < rhs.first;
+                     });
+    for (auto &overload : Overloads) {
+      Table << overload.second << '\n';
+    }
+
+    // The prelude is the header with all of those declarations cut out.
+    const SourceManager &SM = Instance.getSourceManager();
+    const StringRef Header = SM.getBufferData(SM.getMainFileID());
+    unsigned Pos = 0;
+    for (auto &cut : Cuts) {
+      Prelude << Header.slice(Pos, cut.first);
+      Pos = cut.second;
+    }
+    Prelude << Header.substr(Pos);
+  }
+
+private:
+  // Encodes |FD| into the table, and records the text of its declaration to
+  // be cut from the prelude.  Returns false if |FD| can't be encoded.
+  bool AddOverload(FunctionDecl *FD) {
+    const SourceManager &SM = Instance.getSourceManager();
+    const SourceLocation Begin = SM.getExpansionLoc(FD->getLocStart());
+    const SourceLocation End = SM.getExpansionLoc(FD->getLocEnd());
+    const SourceLocation AfterSemi = Lexer::findLocationAfterToken(
+        End, tok::semi, SM, Instance.getLangOpts(), false);
+    if (!SM.isInMainFile(Begin) || AfterSemi.isInvalid()) {
+      return false;
+    }
+    Cuts.emplace_back(SM.getFileOffset(Begin), SM.getFileOffset(AfterSemi));
+
+    // Only the first declaration of each overload goes in the table, as the
+    // declarations we make from it are never redeclared.
+    if (FD->getPreviousDecl()) {
+      return true;
+    }
+
+    const auto *FPT = FD->getType()->getAs<FunctionProtoType>();
+    if (!FPT || FPT->isVariadic()) {
+      return false;
+    }
+
+    std::string attributes;
+    for (const Attr *A : FD->attrs()) {
+      if (A->isImplicit()) {
+        continue;
+      }
+
+      switch (A->getKind()) {
+      case attr::Overloadable:
+        break;
+      case attr::Const:
+        attributes += 'c';
+        break;
+      case attr::Pure:
+        attributes += 'p';
+        break;
+      case attr::Convergent:
+        attributes += 'v';
+        break;
+      default:
+        return false;
+      }
+    }
+
+    std::string overload;
+    llvm::raw_string_ostream out(overload);
+    out << FD->getName() << '\t' << (attributes.empty() ? "-" : attributes)
+        << '\t';
+    if (!EncodeType(FPT->getReturnType(), out)) {
+      return false;
+    }
+    for (QualType ParamTy : FPT->getParamTypes()) {
+      out << '\t';
+      if (!EncodeType(ParamTy, out)) {
+        return false;
+      }
+    }
+
+    Overloads.emplace_back(FD->getName(), out.str());
+    return true;
+  }
+
+  CompilerInstance &Instance;
+  llvm::raw_ostream &Table;
+  llvm::raw_ostream &Prelude;
+  unsigned UnsupportedDeclID;
+  bool Failed;
+
+  // The name and encoding of each overload.
+  std::vector<std::pair<StringRef, std::string>> Overloads;
+  // The file offsets of the declarations to cut from the prelude, in order.
+  std::vector<std::pair<unsigned, unsigned>> Cuts;
+};
+
+} // namespace
+
+namespace clspv {
+
+std::unique_ptr<ASTConsumer>
+BuiltinsTableAction::CreateASTConsumer(CompilerInstance &CI, StringRef) {
+  return std::unique_ptr<ASTConsumer>(
+      new BuiltinsTableConsumer(CI, Table, Prelude));
+}
+
+BuiltinsIndex::BuiltinsIndex(StringRef table) {
+  while (!table.empty()) {
+    StringRef line;
+    std::tie(line, table) = table.split('\n');
+    if (!line.empty()) {
+      StringRef name, overload;
+      std::tie(name, overload) = line.split('\t');
+      Overloads[name].push_back(overload);
+    }
+  }
+}
+
+ArrayRef<StringRef> BuiltinsIndex::lookup(StringRef name) const {
+  auto iter = Overloads.find(name);
+  if (iter == Overloads.end()) {
+    return ArrayRef<StringRef>();
+  }
+  return iter->second;
+}
+
+bool BuiltinsSemaSource::LookupUnqualified(LookupResult &R, Scope *) {
+  if (!SemaPtr || R.getLookupKind() != Sema::LookupOrdinaryName) {
+    return false;
+  }
+
+  IdentifierInfo *name = R.getLookupName().getAsIdentifierInfo();
+  if (!name) {
+    return false;
+  }
+
+  // Once declared, ordinary lookup finds the declarations we made.
+  if (Declared.count(name->getName())) {
+    return false;
+  }
+
+  const ArrayRef<StringRef> overloads = Index.lookup(name->getName());
+  if (overloads.empty()) {
+    return false;
+  }
+
+  for (StringRef overload : overloads) {
+    R.addDecl(DeclareOverload(name, overload, R.getNameLoc()));
+  }
+  R.resolveKind();
+
+  Declared.insert(name->getName());
+
+  return true;
+}
+
+FunctionDecl *BuiltinsSemaSource::DeclareOverload(IdentifierInfo *name,
+                                                  StringRef overload,
+                                                  SourceLocation loc) {
+  Sema &S = *SemaPtr;
+  ASTContext &Context = S.Context;
+
+  SmallVector<StringRef, 8> fields;
+  overload.split(fields, '\t');
+  if (fields.size() < 2) {
+    llvm::report_fatal_error("Malformed OpenCL builtins table");
+  }
+
+  QualType RetTy = DecodeType(fields[1]);
+  SmallVector<QualType, 4> ParamTys;
+  for (size_t i = 2; i < fields.size(); i++) {
+    ParamTys.push_back(DecodeType(fields[i]));
+  }
+
+  FunctionProtoType::ExtProtoInfo EPI(
+      Context.getDefaultCallingConvention(false, false));
+  QualType FnTy = Context.getFunctionType(RetTy, ParamTys, EPI);
+
+  TranslationUnitDecl *TU = Context.getTranslationUnitDecl();
+  FunctionDecl *FD = FunctionDecl::Create(Context, TU, loc, loc, name, FnTy,
+                                          nullptr, SC_Extern, false, true);
+
+  SmallVector<ParmVarDecl *, 4> Params;
+  for (unsigned i = 0; i < ParamTys.size(); i++) {
+    ParmVarDecl *Param =
+        ParmVarDecl::Create(Context, FD, loc, loc, nullptr, ParamTys[i],
+                            nullptr, SC_None, nullptr);
+    Param->setScopeInfo(0, i);
+    Params.push_back(Param);
+  }
+  FD->setParams(Params);
+
+  FD->addAttr(OverloadableAttr::CreateImplicit(Context));
+  for (char attribute : fields[0]) {
+    switch (attribute) {
+    case 'c':
+      FD->addAttr(ConstAttr::CreateImplicit(Context));
+      break;
+    case 'p':
+      FD->addAttr(PureAttr::CreateImplicit(Context));
+      break;
+    case 'v':
+      FD->addAttr(ConvergentAttr::CreateImplicit(Context));
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Declare the function at translation unit scope, wherever the lookup
+  // happened.
+  DeclContext *SavedContext = S.CurContext;
+  S.CurContext = TU;
+  S.PushOnScopeChains(FD, S.TUScope);
+  S.CurContext = SavedContext;
+
+  return FD;
+}
+
+QualType BuiltinsSemaSource::DecodeType(StringRef &encoded) {
+  ASTContext &Context = SemaPtr->Context;
+
+  StringRef quals;
+  std::tie(quals, encoded) = encoded.split(':');
+  unsigned opaqueQuals = 0;
+  if (quals.getAsInteger(10, opaqueQuals) || encoded.empty()) {
+    llvm::report_fatal_error("Malformed OpenCL builtins table");
+  }
+
+  const char kind = encoded.front();
+  encoded = encoded.drop_front();
+
+  QualType Ty;
+  switch (kind) {
+  case 'b': {
+    const size_t end = encoded.find_first_not_of("0123456789");
+    unsigned builtinKind = 0;
+    if (encoded.substr(0, end).getAsInteger(10, builtinKind)) {
+      llvm::report_fatal_error("Malformed OpenCL builtins table");
+    }
+    encoded = encoded.substr(end);
+    Ty = GetBuiltinType(Context, builtinKind);
+    break;
+  }
+  case 't': {
+    StringRef typedefName;
+    std::tie(typedefName, encoded) = encoded.split(';');
+    for (NamedDecl *D : Context.getTranslationUnitDecl()->lookup(
+             &Context.Idents.get(typedefName))) {
+      if (auto *TD = dyn_cast<TypedefNameDecl>(D)) {
+        Ty = Context.getTypedefType(TD);
+        break;
+      }
+    }
+    if (Ty.isNull()) {
+      llvm::report_fatal_error("OpenCL builtins table refers to typedef '" +
+                               typedefName + "' missing from the prelude");
+    }
+    break;
+  }
+  case 'p':
+    Ty = Context.getPointerType(DecodeType(encoded));
+    break;
+  case 'v': {
+    StringRef count;
+    std::tie(count, encoded) = encoded.split(',');
+    unsigned numElements = 0;
+    if (count.getAsInteger(10, numElements)) {
+      llvm::report_fatal_error("Malformed OpenCL builtins table");
+    }
+    Ty = Context.getExtVectorType(DecodeType(encoded), numElements);
+    break;
+  }
+  default:
+    llvm::report_fatal_error("Malformed OpenCL builtins table");
+  }
+
+  return Context.getQualifiedType(Ty, Qualifiers::fromOpaqueValue(opaqueQuals));
+}
+
+} // namespace clspv
@@ -0,0 +1,96 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_BUILTINSTABLE_H_
+#define CLSPV_LIB_BUILTINSTABLE_H_
+
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/Sema/ExternalSemaSource.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace clspv {
+
+// A frontend action that parses the OpenCL builtins header and splits it in
+// two.  Declarations of overloaded builtin functions are written to |table|,
+// one encoded overload per line.  Everything else (macros, typedefs, pragmas
+// and preprocessor conditionals) is written unchanged to |prelude|.
+class BuiltinsTableAction final : public clang::ASTFrontendAction {
+public:
+  BuiltinsTableAction(llvm::raw_ostream &table, llvm::raw_ostream &prelude)
+      : Table(table), Prelude(prelude) {}
+
+protected:
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &CI,
+                    llvm::StringRef InFile) override;
+
+private:
+  llvm::raw_ostream &Table;
+  llvm::raw_ostream &Prelude;
+};
+
+// The encoded overloads of each builtin function in a table written by
+// BuiltinsTableAction, indexed by name.  The index refers into the table
+// rather than copying it, and does not change once built, so one index can
+// be shared by any number of compilations.
+class BuiltinsIndex {
+public:
+  explicit BuiltinsIndex(llvm::StringRef table);
+
+  // Returns the encoded overloads of the builtin called |name|, or none if
+  // there is no such builtin.
+  llvm::ArrayRef<llvm::StringRef> lookup(llvm::StringRef name) const;
+
+private:
+  llvm::StringMap<llvm::SmallVector<llvm::StringRef, 8>> Overloads;
+};
+
+// An external Sema source that declares the overloads of an OpenCL builtin
+// function the first time its name is looked up, using the given |index|.
+// It must be used together with the prelude written by BuiltinsTableAction,
+// which declares the types the table refers to.
+class BuiltinsSemaSource final : public clang::ExternalSemaSource {
+public:
+  explicit BuiltinsSemaSource(const BuiltinsIndex &index)
+      : SemaPtr(nullptr), Index(index) {}
+
+  void InitializeSema(clang::Sema &S) override { SemaPtr = &S; }
+  void ForgetSema() override { SemaPtr = nullptr; }
+
+  bool LookupUnqualified(clang::LookupResult &R, clang::Scope *S) override;
+
+private:
+  // Returns the function declared by the encoded |overload| of |name|.
+  clang::FunctionDecl *DeclareOverload(clang::IdentifierInfo *name,
+                                       llvm::StringRef overload,
+                                       clang::SourceLocation loc);
+
+  // Decodes the type at the start of |encoded|, and drops it from |encoded|.
+  clang::QualType DecodeType(llvm::StringRef &encoded);
+
+  clang::Sema *SemaPtr;
+
+  const BuiltinsIndex &Index;
+
+  // The names of the builtins already declared in this compilation.
+  llvm::StringSet<> Declared;
+};
+
+} // namespace clspv
+
+#endif
@@ -0,0 +1,140 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CompilationCache.h"
+
+#include <clang/Basic/SourceManager.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Lex/PPCallbacks.h>
+#include <clang/Lex/Preprocessor.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace clang;
+
+namespace {
+
+// Hashes the text of each pragma directive.  The preprocessor consumes
+// pragmas rather than returning them as tokens, but some of them, such as
+// '#pragma OPENCL EXTENSION', change how the program compiles.
+class HashPragmas final : public PPCallbacks {
+public:
+  HashPragmas(const SourceManager &SM, llvm::SHA1 &hasher)
+      : SM(SM), Hasher(hasher) {}
+
+  void PragmaDirective(SourceLocation Loc,
+                       PragmaIntroducerKind Introducer) override {
+    const llvm::StringRef text(SM.getCharacterData(SM.getSpellingLoc(Loc)));
+    Hasher.update(text.substr(0, text.find('\n')));
+    Hasher.update("\n");
+  }
+
+private:
+  const SourceManager &SM;
+  llvm::SHA1 &Hasher;
+};
+
+} // namespace
+
+namespace clspv {
+
+void HashPreprocessedAction::ExecuteAction() {
+  Preprocessor &PP = getCompilerInstance().getPreprocessor();
+  PP.addPPCallbacks(llvm::make_unique<HashPragmas>(
+      getCompilerInstance().getSourceManager(), Hasher));
+
+  PP.EnterMainSourceFile();
+
+  llvm::SmallString<64> buffer;
+  Token tok;
+  for (PP.Lex(tok); tok.isNot(tok::eof); PP.Lex(tok)) {
+    // Separate tokens with a character no token contains, so that different
+    // token sequences can't hash the same.
+    Hasher.update(PP.getSpelling(tok, buffer));
+    Hasher.update("\n");
+  }
+}
+
+std::string CompilationCache::Key(llvm::SHA1 &hash) {
+  return llvm::toHex(hash.final());
+}
+
+bool CompilationCache::Load(llvm::StringRef key, std::string *output,
+                            std::string *descriptorMap) const {
+  // The output is written last, so if it exists the entry is complete.
+  auto errorOrOutput = llvm::MemoryBuffer::getFile(EntryPath(key, "out"));
+  if (!errorOrOutput) {
+    return false;
+  }
+  auto errorOrDescriptorMap =
+      llvm::MemoryBuffer::getFile(EntryPath(key, "map"));
+  if (!errorOrDescriptorMap) {
+    return false;
+  }
+
+  *output = errorOrOutput.get()->getBuffer().str();
+  *descriptorMap = errorOrDescriptorMap.get()->getBuffer().str();
+  return true;
+}
+
+void CompilationCache::Store(llvm::StringRef key, llvm::StringRef output,
+                             llvm::StringRef descriptorMap) const {
+  if (llvm::sys::fs::create_directories(Directory)) {
+    return;
+  }
+
+  if (WriteFile(EntryPath(key, "map"), descriptorMap)) {
+    WriteFile(EntryPath(key, "out"), output);
+  }
+}
+
+std::string CompilationCache::EntryPath(llvm::StringRef key,
+                                        llvm::StringRef extension) const {
+  llvm::SmallString<128> path(Directory);
+  llvm::sys::path::append(path, key + "." + extension);
+  return path.str();
+}
+
+bool CompilationCache::WriteFile(const std::string &path,
+                                 llvm::StringRef contents) const {
+  int fd;
+  llvm::SmallString<128> tempPath;
+  if (llvm::sys::fs::createUniqueFile(path + ".%%%%%%%%.tmp", fd, tempPath)) {
+    return false;
+  }
+
+  {
+    llvm::raw_fd_ostream out(fd, true);
+    out << contents;
+    out.close();
+    if (out.has_error()) {
+      out.clear_error();
+      llvm::sys::fs::remove(tempPath);
+      return false;
+    }
+  }
+
+  if (llvm::sys::fs::rename(tempPath, path)) {
+    llvm::sys::fs::remove(tempPath);
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace clspv
@@ -0,0 +1,75 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_COMPILATIONCACHE_H_
+#define CLSPV_LIB_COMPILATIONCACHE_H_
+
+#include "clang/Frontend/FrontendAction.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/SHA1.h"
+
+#include <string>
+
+namespace clspv {
+
+// A frontend action that feeds the preprocessed tokens of its input, and the
+// text of the pragmas in it, to |hasher|.  Comments and formatting do not
+// affect the hash.
+class HashPreprocessedAction final : public clang::PreprocessorFrontendAction {
+public:
+  explicit HashPreprocessedAction(llvm::SHA1 &hasher) : Hasher(hasher) {}
+
+protected:
+  void ExecuteAction() override;
+
+private:
+  llvm::SHA1 &Hasher;
+};
+
+// A directory of compilation results, keyed by a hash of everything that
+// determines them.  Each result is stored as two files named after its key,
+// <key>.out holding the output module and <key>.map the descriptor map.
+// Entries are written to temporary files and renamed into place, so
+// concurrent compilers can share a directory.
+class CompilationCache {
+public:
+  explicit CompilationCache(llvm::StringRef directory) : Directory(directory) {}
+
+  // Returns the key for the given |hash|.
+  static std::string Key(llvm::SHA1 &hash);
+
+  // Returns true, and sets |output| and |descriptorMap| to the stored
+  // result, if there is an entry for |key|.
+  bool Load(llvm::StringRef key, std::string *output,
+            std::string *descriptorMap) const;
+
+  // Stores |output| and |descriptorMap| as the entry for |key|.  Failing to
+  // store an entry is not an error: the next compilation just misses.
+  void Store(llvm::StringRef key, llvm::StringRef output,
+             llvm::StringRef descriptorMap) const;
+
+private:
+  // Returns the path of the file with the given |extension| for |key|.
+  std::string EntryPath(llvm::StringRef key, llvm::StringRef extension) const;
+
+  // Atomically replaces the file at |path| with |contents|.  Returns true on
+  // success.
+  bool WriteFile(const std::string &path, llvm::StringRef contents) const;
+
+  const std::string Directory;
+};
+
+} // namespace clspv
+
+#endif
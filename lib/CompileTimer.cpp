@@ -0,0 +1,193 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "CompileTimer.h"
+#include "TimeTrace.h"
+
+#include <llvm/Pass.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/Process.h>
+
+using namespace llvm;
+
+namespace {
+
+// Returns the number of instructions in |module|, or -1 if it is null.
+int64_t CountInstructions(const Module *module) {
+  if (!module) {
+    return -1;
+  }
+  int64_t count = 0;
+  for (const auto &F : *module) {
+    for (const auto &BB : F) {
+      count += BB.size();
+    }
+  }
+  return count;
+}
+
+// A pass that starts or stops a step of a CompileTimer.
+struct TimerStepPass : public ModulePass {
+  static char ID;
+  TimerStepPass(clspv::CompileTimer &timer, StringRef name, bool start)
+      : ModulePass(ID), Timer(timer), Name(name.str()), Start(start) {}
+
+  StringRef getPassName() const override { return "Compile timer step"; }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  bool runOnModule(Module &M) override {
+    if (Start) {
+      Timer.StartStep(Name, &M);
+    } else {
+      Timer.StopStep(&M);
+    }
+    return false;
+  }
+
+private:
+  clspv::CompileTimer &Timer;
+  const std::string Name;
+  const bool Start;
+};
+
+char TimerStepPass::ID = 0;
+
+} // namespace
+
+namespace clspv {
+
+void CompileTimer::StartStep(StringRef name, const Module *module) {
+  Step step;
+  step.Name = name.str();
+  step.WallSeconds = 0;
+  step.AllocatedBytes = 0;
+  step.InstructionsBefore = CountInstructions(module);
+  step.InstructionsAfter = -1;
+  Steps.push_back(step);
+
+  if (TimeTrace *trace = TimeTrace::Current()) {
+    trace->Begin(name);
+  }
+
+  StartMallocUsage = sys::Process::GetMallocUsage();
+  StartTime = std::chrono::steady_clock::now();
+}
+
+void CompileTimer::StopStep(const Module *module) {
+  const auto stopTime = std::chrono::steady_clock::now();
+  const size_t stopMallocUsage = sys::Process::GetMallocUsage();
+
+  Step &step = Steps.back();
+  step.WallSeconds =
+      std::chrono::duration<double>(stopTime - StartTime).count();
+  step.AllocatedBytes =
+      static_cast<int64_t>(stopMallocUsage) - int64_t(StartMallocUsage);
+  step.InstructionsAfter = CountInstructions(module);
+
+  if (TimeTrace *trace = TimeTrace::Current()) {
+    trace->End();
+  }
+}
+
+void CompileTimer::PrintReport(raw_ostream &out) const {
+  double total = 0;
+  for (const Step &step : Steps) {
+    total += step.WallSeconds;
+  }
+
+  out << "===" << std::string(73, '-') << "===\n";
+  out << "                      Clspv compilation time report\n";
+  out << "===" << std::string(73, '-') << "===\n";
+  out << format("  Total Execution Time: %.4f seconds\n\n", total);
+  out << "    ---Wall Time---  ---Allocated---  --IR Instructions--  "
+         "--- Name ---\n";
+
+  for (const Step &step : Steps) {
+    out << format("   %7.4f (%5.1f%%)", step.WallSeconds,
+                  total > 0 ? 100 * step.WallSeconds / total : 0.0);
+    out << format("  %15lld", static_cast<long long>(step.AllocatedBytes));
+    if (step.InstructionsAfter < 0) {
+      out << std::string(21, ' ');
+    } else if (step.InstructionsBefore < 0) {
+      out << std::string(12, ' ')
+          << format("%9lld", static_cast<long long>(step.InstructionsAfter));
+    } else {
+      out << format("  %8lld->%9lld",
+                    static_cast<long long>(step.InstructionsBefore),
+                    static_cast<long long>(step.InstructionsAfter));
+    }
+    out << "  " << step.Name << "\n";
+  }
+  out << format("   %7.4f (100.0%%)", total) << "  Total\n\n";
+}
+
+void CompileTimer::PrintJSON(raw_ostream &out) const {
+  double total = 0;
+  int64_t allocated = 0;
+  for (const Step &step : Steps) {
+    total += step.WallSeconds;
+    allocated += step.AllocatedBytes;
+  }
+
+  out << "{\n";
+  out << format("  \"wall_seconds\": %.6f,\n", total);
+  out << "  \"allocated_bytes\": " << allocated << ",\n";
+  out << "  \"steps\": [";
+  for (size_t i = 0; i < Steps.size(); i++) {
+    const Step &step = Steps[i];
+    out << (i ? ",\n" : "\n") << "    {\"name\": ";
+    WriteJSONString(out, step.Name);
+    out << format(", \"wall_seconds\": %.6f", step.WallSeconds);
+    out << ", \"allocated_bytes\": " << step.AllocatedBytes;
+    if (step.InstructionsBefore >= 0) {
+      out << ", \"instructions_before\": " << step.InstructionsBefore;
+    }
+    if (step.InstructionsAfter >= 0) {
+      out << ", \"instructions_after\": " << step.InstructionsAfter;
+    }
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+void TimedPassManager::add(Pass *pass) {
+  if (!Timer || InGroup) {
+    legacy::PassManager::add(pass);
+    return;
+  }
+
+  const std::string name = pass->getPassName().str();
+  legacy::PassManager::add(new TimerStepPass(*Timer, name, true));
+  legacy::PassManager::add(pass);
+  legacy::PassManager::add(new TimerStepPass(*Timer, name, false));
+}
+
+void TimedPassManager::BeginGroup(StringRef name) {
+  if (Timer) {
+    legacy::PassManager::add(new TimerStepPass(*Timer, name, true));
+  }
+  InGroup = true;
+}
+
+void TimedPassManager::EndGroup() {
+  InGroup = false;
+  if (Timer) {
+    legacy::PassManager::add(new TimerStepPass(*Timer, "", false));
+  }
+}
+
+} // namespace clspv
@@ -0,0 +1,89 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_COMPILETIMER_H_
+#define CLSPV_LIB_COMPILETIMER_H_
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace clspv {
+
+// Records what each step of one compilation costs.  The steps are the
+// frontend phases and the passes of the pipeline.  For each step it records
+// the wall time, the change in heap bytes in use, and the change in the
+// number of IR instructions.  Heap usage is process wide, so it is only
+// meaningful when a single compilation is running.  Each step is also a span
+// of the thread's TimeTrace, if there is one.
+class CompileTimer {
+public:
+  // Starts timing the step called |name|.  |module| is the IR it works on,
+  // if there is any yet.
+  void StartStep(llvm::StringRef name, const llvm::Module *module = nullptr);
+
+  // Stops timing the step started last, which left |module| behind.
+  void StopStep(const llvm::Module *module = nullptr);
+
+  // Writes a table of the steps, in the style of -time-passes, to |out|.
+  void PrintReport(llvm::raw_ostream &out) const;
+
+  // Writes the steps to |out| as a JSON object.
+  void PrintJSON(llvm::raw_ostream &out) const;
+
+private:
+  struct Step {
+    std::string Name;
+    double WallSeconds;
+    int64_t AllocatedBytes;
+    // The number of IR instructions before and after the step, or -1 where
+    // there was no module.
+    int64_t InstructionsBefore;
+    int64_t InstructionsAfter;
+  };
+
+  std::vector<Step> Steps;
+  std::chrono::steady_clock::time_point StartTime;
+  size_t StartMallocUsage = 0;
+};
+
+// A pass manager that times each pass added to it as a step of |timer|, if
+// that is not null.  Timing a pass adds a module pass before and after it,
+// so consecutive function passes each run over the whole module in turn.
+class TimedPassManager : public llvm::legacy::PassManager {
+public:
+  explicit TimedPassManager(CompileTimer *timer) : Timer(timer) {}
+
+  void add(llvm::Pass *pass) override;
+
+  // Times the passes added until EndGroup as a single step called |name|,
+  // so that passes nested by the group, such as those run from the inliner,
+  // stay nested.
+  void BeginGroup(llvm::StringRef name);
+  void EndGroup();
+
+private:
+  CompileTimer *Timer;
+  bool InGroup = false;
+};
+
+} // namespace clspv
+
+#endif
@@ -0,0 +1,1998 @@
+// Copyright 2017 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <clang/AST/RecursiveASTVisitor.h>
+#include <clang/Basic/TargetInfo.h>
+#include <clang/Basic/VirtualFileSystem.h>
+#include <clang/CodeGen/CodeGenAction.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Frontend/FrontendPluginRegistry.h>
+#include <clang/Frontend/MultiplexConsumer.h>
+#include <clang/Frontend/TextDiagnosticPrinter.h>
+#include <clang/Lex/PPCallbacks.h>
+#include <clang/Lex/Preprocessor.h>
+#include <clang/Lex/PreprocessorOptions.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/InitializePasses.h>
+#include <llvm/LinkAllPasses.h>
+#include <llvm/PassInfo.h>
+#include <llvm/PassRegistry.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/StringSaver.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+
+#include "clspv/Compiler.h"
+#include "clspv/Option.h"
+#include "clspv/Passes.h"
+#include "clspv/opencl_builtins_header.h"
+
+#ifdef CLSPV_PRECOMPILED_BUILTINS
+#include "clspv/opencl_builtins_default_pch.h"
+#include "clspv/opencl_builtins_fast_relaxed_math_pch.h"
+#include "clspv/opencl_builtins_prelude.h"
+#include "clspv/opencl_builtins_table.h"
+#endif
+
+#include "BuiltinsTable.h"
+#include "CompilationCache.h"
+#include "CompileTimer.h"
+#include "ResetOption.h"
+#include "TimeTrace.h"
+
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace clang;
+
+namespace {
+struct ExtraValidationConsumer final : public ASTConsumer {
+private:
+  CompilerInstance &Instance;
+  llvm::StringRef InFile;
+
+  enum CustomDiagnosticType {
+    CustomDiagnosticVectorsMoreThan4Elements = 0,
+    CustomDiagnosticVoidPointer = 1,
+    CustomDiagnosticTotal
+  };
+  std::vector<unsigned> CustomDiagnosticsIDMap;
+
+  bool IsSupportedType(QualType QT, SourceRange SR) {
+    auto *Ty = QT.getTypePtr();
+
+    // First check if we have a pointer type.
+    if (Ty->isPointerType()) {
+      const Type *pointeeTy = Ty->getPointeeType().getTypePtr();
+      if (pointeeTy && pointeeTy->isVoidType()) {
+        // We don't support void pointers.
+        Instance.getDiagnostics().Report(
+            SR.getBegin(), CustomDiagnosticsIDMap[CustomDiagnosticVoidPointer]);
+        return false;
+      }
+      // Otherwise check recursively.
+      return IsSupportedType(Ty->getPointeeType(), SR);
+    }
+
+    const auto &canonicalType = QT.getCanonicalType();
+    if (auto *VT = llvm::dyn_cast<ExtVectorType>(canonicalType)) {
+      // We don't support vectors with more than 4 elements.
+      if (4 < VT->getNumElements()) {
+        Instance.getDiagnostics().Report(
+            SR.getBegin(),
+            CustomDiagnosticsIDMap[CustomDiagnosticVectorsMoreThan4Elements]);
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // This will be used to check the inside of function bodies.
+  class DeclVisitor : public RecursiveASTVisitor<DeclVisitor> {
+  private:
+    ExtraValidationConsumer &consumer;
+
+  public:
+    explicit DeclVisitor(ExtraValidationConsumer &VC) : consumer(VC) {}
+
+    // Visits a declaration.  Emits a diagnostic and returns false if the
+    // declaration represents an unsupported vector value or vector type.
+    // Otherwise returns true.
+    bool VisitDecl(Decl *D) {
+      // Looking at the Decl class hierarchy, it seems ValueDecl and TypeDecl
+      // are the only two that might represent an unsupported vector type.
+      if (auto *VD = dyn_cast<ValueDecl>(D)) {
+        return consumer.IsSupportedType(VD->getType(), D->getSourceRange());
+      } else if (auto *TD = dyn_cast<TypeDecl>(D)) {
+        QualType DefinedType = TD->getASTContext().getTypeDeclType(TD);
+        return consumer.IsSupportedType(DefinedType, TD->getSourceRange());
+      }
+      return true;
+    }
+  };
+
+  DeclVisitor Visitor;
+
+public:
+  explicit ExtraValidationConsumer(CompilerInstance &Instance,
+                                   llvm::StringRef InFile)
+      : Instance(Instance), InFile(InFile),
+        CustomDiagnosticsIDMap(CustomDiagnosticTotal), Visitor(*this) {
+    auto &DE = Instance.getDiagnostics();
+
+    CustomDiagnosticsIDMap[CustomDiagnosticVectorsMoreThan4Elements] =
+        DE.getCustomDiagID(
+            DiagnosticsEngine::Error,
+            "vectors with more than 4 elements are not supported");
+    CustomDiagnosticsIDMap[CustomDiagnosticVoidPointer] =
+        DE.getCustomDiagID(
+            DiagnosticsEngine::Error,
+            "pointer-to-void is not supported");
+  }
+
+  virtual bool HandleTopLevelDecl(DeclGroupRef DG) override {
+    for (auto *D : DG) {
+      if (auto *FD = llvm::dyn_cast<FunctionDecl>(D)) {
+        // If the function has a body it means we are not an OpenCL builtin
+        // function.
+        if (FD->hasBody()) {
+          if (!IsSupportedType(FD->getReturnType(),
+                               FD->getReturnTypeSourceRange())) {
+            return false;
+          }
+
+          for (auto *P : FD->parameters()) {
+            if (!IsSupportedType(P->getOriginalType(), P->getSourceRange())) {
+              return false;
+            }
+          }
+
+          // Check for unsupported vector types.
+          Visitor.TraverseDecl(FD);
+        }
+      }
+    }
+
+    return true;
+  }
+};
+
+struct ExtraValidationASTAction final : public PluginASTAction {
+  virtual std::unique_ptr<ASTConsumer>
+  CreateASTConsumer(CompilerInstance &CI, llvm::StringRef InFile) override {
+    return std::unique_ptr<ASTConsumer>(
+        new ExtraValidationConsumer(CI, InFile));
+  }
+
+  virtual bool ParseArgs(const CompilerInstance &CI,
+                         const std::vector<std::string> &arg) override {
+    // Parsing succeeded.
+    return true;
+  }
+
+  virtual PluginASTAction::ActionType getActionType() override {
+    return PluginASTAction::AddBeforeMainAction;
+  }
+};
+}
+
+// Returns the precompiled form of the OpenCL builtins header that was built
+// with language options compatible with |opts|, or an empty string if there
+// is none.  Clang rejects a precompiled header whose language options differ
+// from those of the compilation using it, so in that case we fall back to
+// including the header textually.  Sets |variant| to the name of the form
+// returned, if not null.
+static llvm::StringRef GetBuiltinsPCH(const LangOptions &opts,
+                                      llvm::StringRef *variant = nullptr) {
+#ifdef CLSPV_PRECOMPILED_BUILTINS
+  if (opts.SinglePrecisionConstants) {
+    return llvm::StringRef();
+  }
+  if (opts.FastRelaxedMath) {
+    if (variant) {
+      *variant = "fast_relaxed_math";
+    }
+    return llvm::StringRef(opencl_builtins_fast_relaxed_math_pch_data,
+                           opencl_builtins_fast_relaxed_math_pch_size - 1);
+  }
+  if (!opts.FiniteMathOnly) {
+    if (variant) {
+      *variant = "default";
+    }
+    return llvm::StringRef(opencl_builtins_default_pch_data,
+                           opencl_builtins_default_pch_size - 1);
+  }
+#endif
+  return llvm::StringRef();
+}
+
+static FrontendPluginRegistry::Add<ExtraValidationASTAction>
+    X("extra-validation",
+      "Perform extra validation on OpenCL C when targeting Vulkan");
+
+static llvm::cl::opt<bool> cl_single_precision_constants(
+    "cl-single-precision-constant", llvm::cl::init(false),
+    llvm::cl::desc("Treat double precision floating-point constant as single "
+                   "precision constant."));
+
+static llvm::cl::opt<bool> cl_denorms_are_zero(
+    "cl-denorms-are-zero", llvm::cl::init(false),
+    llvm::cl::desc("If specified, denormalized floating point numbers may be "
+                   "flushed to zero."));
+
+static llvm::cl::opt<bool> cl_fp32_correctly_rounded_divide_sqrt(
+    "cl-fp32-correctly-rounded-divide-sqrt", llvm::cl::init(false),
+    llvm::cl::desc("Single precision floating-point divide (x/y and 1/x) and "
+                   "sqrt used are correctly rounded."));
+
+static llvm::cl::opt<bool>
+    cl_opt_disable("cl-opt-disable", llvm::cl::init(false),
+                   llvm::cl::desc("This option disables all optimizations. The "
+                                  "default is optimizations are enabled."));
+
+static llvm::cl::opt<bool> cl_mad_enable(
+    "cl-mad-enable", llvm::cl::init(false),
+    llvm::cl::desc("Allow a * b + c to be replaced by a mad. The mad computes "
+                   "a * b + c with reduced accuracy."));
+
+static llvm::cl::opt<bool> cl_no_signed_zeros(
+    "cl-no-signed-zeros", llvm::cl::init(false),
+    llvm::cl::desc("Allow optimizations for floating-point arithmetic that "
+                   "ignore the signedness of zero."));
+
+static llvm::cl::opt<bool> cl_unsafe_math_optimizations(
+    "cl-unsafe-math-optimizations", llvm::cl::init(false),
+    llvm::cl::desc("Allow optimizations for floating-point arithmetic that (a) "
+                   "assume that arguments and results are valid, (b) may "
+                   "violate IEEE 754 standard and (c) may violate the OpenCL "
+                   "numerical compliance requirements. This option includes "
+                   "the -cl-no-signed-zeros and -cl-mad-enable options."));
+
+static llvm::cl::opt<bool> cl_finite_math_only(
+    "cl-finite-math-only", llvm::cl::init(false),
+    llvm::cl::desc("Allow optimizations for floating-point arithmetic that "
+                   "assume that arguments and results are not NaNs or INFs."));
+
+static llvm::cl::opt<bool> cl_fast_relaxed_math(
+    "cl-fast-relaxed-math", llvm::cl::init(false),
+    llvm::cl::desc("This option causes the preprocessor macro "
+                   "__FAST_RELAXED_MATH__ to be defined. Sets the optimization "
+                   "options -cl-finite-math-only and "
+                   "-cl-unsafe-math-optimizations."));
+
+static llvm::cl::list<std::string>
+    Includes("I", llvm::cl::desc("Add a directory to the list of directories "
+                                 "to be searched for header files."),
+             llvm::cl::ZeroOrMore, llvm::cl::value_desc("include path"));
+
+static llvm::cl::list<std::string>
+    Defines(llvm::cl::Prefix, "D",
+            llvm::cl::desc("Define a #define directive."), llvm::cl::ZeroOrMore,
+            llvm::cl::value_desc("define"));
+
+static llvm::cl::opt<std::string>
+    InputFilename(llvm::cl::Positional, llvm::cl::desc("<input .cl file>"),
+                  llvm::cl::init("-"));
+
+static llvm::cl::opt<std::string>
+    OutputFilename("o", llvm::cl::desc("Override output filename"),
+                   llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string>
+    DescriptorMapFilename("descriptormap",
+                          llvm::cl::desc("Output file for descriptor map"),
+                          llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<char>
+    OptimizationLevel(llvm::cl::Prefix, "O", llvm::cl::init('2'),
+                      llvm::cl::desc("Optimization level to use"),
+                      llvm::cl::value_desc("level"));
+
+static llvm::cl::opt<bool>
+    OutputAssembly("S", llvm::cl::init(false),
+                   llvm::cl::desc("This option controls output of assembly"));
+
+static llvm::cl::opt<std::string> OutputFormat(
+    "mfmt", llvm::cl::init(""),
+    llvm::cl::desc(
+        "Specify special output format. 'c' is as a C initializer list"),
+    llvm::cl::value_desc("format"));
+
+static llvm::cl::opt<std::string>
+    SamplerMap("samplermap", llvm::cl::desc("Literal sampler map"),
+               llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<bool> cluster_non_pointer_kernel_args(
+    "cluster-pod-kernel-args", llvm::cl::init(false),
+    llvm::cl::desc("Collect plain-old-data kernel arguments into a struct in "
+                   "a single storage buffer, using a binding number after "
+                   "other arguments. Use this to reduce storage buffer "
+                   "descriptors."));
+
+static llvm::cl::opt<bool> remove_redundant_barriers(
+    "remove-redundant-barriers", llvm::cl::init(false),
+    llvm::cl::desc("Remove the barriers in kernels that have no global or "
+                   "local memory accesses before them, or none after them"));
+
+static llvm::cl::opt<bool> LazyBuiltins(
+    "lazy-builtins", llvm::cl::init(false),
+    llvm::cl::desc("Declare only the OpenCL builtin functions a kernel refers "
+                   "to, from a table, instead of parsing all of them from the "
+                   "builtins header"));
+
+static llvm::cl::opt<bool> PrintBuiltins(
+    "print-builtins", llvm::cl::init(false), llvm::cl::Hidden,
+    llvm::cl::desc("Write which form of the OpenCL builtins header the "
+                   "compilation uses to stderr: a precompiled form and its "
+                   "variant, the header, or the table"));
+
+static llvm::cl::opt<bool> EmitBuiltinsTable(
+    "emit-builtins-table", llvm::cl::init(false), llvm::cl::Hidden,
+    llvm::cl::desc("Write the table of OpenCL builtin functions used by "
+                   "-lazy-builtins to the output file, and the rest of the "
+                   "builtins header to the -builtins-prelude file, instead of "
+                   "compiling an input file"));
+
+static llvm::cl::opt<std::string> BuiltinsPrelude(
+    "builtins-prelude", llvm::cl::Hidden,
+    llvm::cl::desc("Output file for the builtins header prelude written by "
+                   "-emit-builtins-table"),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<bool> EmitBuiltinsPCH(
+    "emit-builtins-pch", llvm::cl::init(false), llvm::cl::Hidden,
+    llvm::cl::desc("Write a precompiled form of the OpenCL builtins header, "
+                   "for the given OpenCL compiler options, to the output file "
+                   "instead of compiling an input file"));
+
+static llvm::cl::opt<std::string> BatchManifest(
+    "batch",
+    llvm::cl::desc("Compile each line of the given manifest file as a "
+                   "separate command line, several at once.  Other options "
+                   "given with -batch apply to every line.  Blank lines and "
+                   "lines starting with '#' are ignored"),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<unsigned> BatchJobs(
+    "batch-jobs", llvm::cl::init(0),
+    llvm::cl::desc("The number of -batch compilations to run at once.  The "
+                   "default is one per hardware thread"),
+    llvm::cl::value_desc("count"));
+
+static llvm::cl::opt<std::string> CacheDir(
+    "cache-dir",
+    llvm::cl::desc("Reuse the results of earlier compilations of the same "
+                   "preprocessed program with the same options, stored in "
+                   "the given directory.  New results are added to it"),
+    llvm::cl::value_desc("directory"));
+
+static llvm::cl::opt<bool> TimeReport(
+    "time-report", llvm::cl::init(false),
+    llvm::cl::desc("Report the wall time, the change in heap usage and the "
+                   "change in IR size of each frontend phase and each pass "
+                   "on stderr"));
+
+static llvm::cl::opt<std::string> TimeReportJSON(
+    "time-report-json",
+    llvm::cl::desc("Write the measurements of -time-report to the given file "
+                   "as JSON"),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<std::string> TimeTraceFilename(
+    "time-trace",
+    llvm::cl::desc("Write a trace of the frontend phases, the passes and the "
+                   "phases of SPIR-V generation to the given file, in the "
+                   "Chrome trace event format"),
+    llvm::cl::value_desc("filename"));
+
+static llvm::cl::opt<unsigned> OptThreads(
+    "opt-threads", llvm::cl::init(1),
+    llvm::cl::desc("The number of threads to run the LLVM optimizations on.  "
+                   "Other than 1, each kernel, along with the functions it "
+                   "calls, is optimized separately in a context of its own, "
+                   "and the results are linked back together.  0 means one "
+                   "thread per hardware thread"),
+    llvm::cl::value_desc("count"));
+
+static llvm::cl::opt<std::string> PassPipeline(
+    "passes",
+    llvm::cl::desc("Run the given comma separated passes before producing "
+                   "SPIR-V, instead of the default ones.  Each is the name a "
+                   "pass is registered under, or 'llvm-opt' for the LLVM "
+                   "optimizations at the -O level.  Use -print-pipeline to "
+                   "see the default"),
+    llvm::cl::value_desc("pass,..."));
+
+static llvm::cl::opt<bool> PrintPipeline(
+    "print-pipeline", llvm::cl::init(false),
+    llvm::cl::desc("Write the passes that would run before producing SPIR-V, "
+                   "in the form -passes takes, to stdout instead of "
+                   "compiling"));
+
+namespace {
+
+// Command line options are process wide.  Compilations hold this while they
+// parse them and set themselves up from them, so that compilations on other
+// threads can't change them in the meantime.  Once set up, a compilation
+// only reads its options through a clspv::Option::ScopedValues.
+std::mutex OptionsMutex;
+
+// Restores the driver options above to their default values.
+void ResetDriverOptions() {
+  clspv::ResetOption(cl_single_precision_constants);
+  clspv::ResetOption(cl_denorms_are_zero);
+  clspv::ResetOption(cl_fp32_correctly_rounded_divide_sqrt);
+  clspv::ResetOption(cl_opt_disable);
+  clspv::ResetOption(cl_mad_enable);
+  clspv::ResetOption(cl_no_signed_zeros);
+  clspv::ResetOption(cl_unsafe_math_optimizations);
+  clspv::ResetOption(cl_finite_math_only);
+  clspv::ResetOption(cl_fast_relaxed_math);
+  clspv::ResetOption(Includes);
+  clspv::ResetOption(Defines);
+  clspv::ResetOption(InputFilename);
+  clspv::ResetOption(OutputFilename);
+  clspv::ResetOption(DescriptorMapFilename);
+  clspv::ResetOption(OptimizationLevel);
+  clspv::ResetOption(OutputAssembly);
+  clspv::ResetOption(OutputFormat);
+  clspv::ResetOption(SamplerMap);
+  clspv::ResetOption(cluster_non_pointer_kernel_args);
+  clspv::ResetOption(remove_redundant_barriers);
+  clspv::ResetOption(LazyBuiltins);
+  clspv::ResetOption(PrintBuiltins);
+  clspv::ResetOption(EmitBuiltinsTable);
+  clspv::ResetOption(BuiltinsPrelude);
+  clspv::ResetOption(EmitBuiltinsPCH);
+  clspv::ResetOption(BatchManifest);
+  clspv::ResetOption(BatchJobs);
+  clspv::ResetOption(CacheDir);
+  clspv::ResetOption(TimeReport);
+  clspv::ResetOption(TimeReportJSON);
+  clspv::ResetOption(TimeTraceFilename);
+  clspv::ResetOption(OptThreads);
+  clspv::ResetOption(PassPipeline);
+  clspv::ResetOption(PrintPipeline);
+}
+
+// Does the set up that every compilation in the process shares, the first
+// time it is called.
+void InitializeOnce(const char *programName) {
+  static std::once_flag initialized;
+  std::call_once(initialized, [programName]() {
+    // We need to change how one of the called passes works by spoofing
+    // ParseCommandLineOptions with the specific option.
+    const int llvmArgc = 2;
+    const char *llvmArgv[llvmArgc] = {
+        programName, "-simplifycfg-sink-common=false",
+    };
+
+    llvm::cl::ParseCommandLineOptions(llvmArgc, llvmArgv);
+
+    llvm::PassRegistry &Registry = *llvm::PassRegistry::getPassRegistry();
+    llvm::initializeCore(Registry);
+    llvm::initializeAnalysis(Registry);
+    llvm::initializeTransformUtils(Registry);
+    llvm::initializeScalarOpts(Registry);
+    llvm::initializeInstCombine(Registry);
+    llvm::initializeIPO(Registry);
+  });
+}
+
+// Returns the LLVM option that the argument |arg| gives, or nullptr if it
+// gives none, such as when it is one of clspv's own options.
+const llvm::cl::Option *FindLLVMOption(llvm::StringRef arg) {
+  if (!arg.startswith("-") || arg == "-" || arg == "--") {
+    return nullptr;
+  }
+  const auto &registered = llvm::cl::getRegisteredOptions();
+  const auto option = registered.find(arg.ltrim('-').split('=').first);
+  if (option == registered.end() ||
+      clspv::OwnOptions().count(option->second)) {
+    return nullptr;
+  }
+  return option->second;
+}
+
+// Parses the command line |argv| into the options, starting from their
+// default values.  Unless |llvmOptions|, only clspv's own options may be
+// given: LLVM's options are not reset between compilations, so one given to
+// a compilation would also apply to every later one in the process, and
+// would change while other compilations' passes read it.  Returns 0 on
+// success, or -1 after writing the problem to |err|.  The caller must hold
+// OptionsMutex.
+int ParseOptions(const int argc, const char *const argv[], bool llvmOptions,
+                 llvm::raw_ostream &err) {
+  clspv::Option::ResetToDefaults();
+  ResetDriverOptions();
+  llvm::cl::ResetAllOptionOccurrences();
+
+  if (!llvmOptions) {
+    for (int i = 1; i < argc; i++) {
+      const llvm::StringRef arg(argv[i]);
+      if (arg == "--") {
+        break;
+      }
+      if (FindLLVMOption(arg)) {
+        err << "Error: LLVM option '-" << arg.ltrim('-').split('=').first
+            << "' applies to the whole process, so it cannot be given to a "
+               "single compilation!\n";
+        return -1;
+      }
+    }
+  }
+
+  if (!llvm::cl::ParseCommandLineOptions(argc, argv, "", &err)) {
+    return -1;
+  }
+
+  switch (OptimizationLevel) {
+  case '0':
+  case '1':
+  case '2':
+  case '3':
+  case 's':
+  case 'z':
+    break;
+  default:
+    err << "Unknown optimization level -O" << OptimizationLevel
+        << " specified!\n";
+    return -1;
+  }
+
+#ifndef CLSPV_PRECOMPILED_BUILTINS
+  if (LazyBuiltins) {
+    err << "Error: -lazy-builtins is not available in this build of clspv!\n";
+    return -1;
+  }
+#endif
+
+  if (EmitBuiltinsTable && BuiltinsPrelude.empty()) {
+    err << "Error: -emit-builtins-table requires -builtins-prelude!\n";
+    return -1;
+  }
+
+  llvm::SmallVector<llvm::StringRef, 32> passNames;
+  llvm::StringRef(PassPipeline).split(passNames, ',', -1, false);
+  const llvm::PassRegistry &registry = *llvm::PassRegistry::getPassRegistry();
+  for (llvm::StringRef name : passNames) {
+    name = name.trim();
+    if ("llvm-opt" == name) {
+      continue;
+    }
+    const llvm::PassInfo *info = registry.getPassInfo(name);
+    if (!info || !info->getNormalCtor()) {
+      err << "Error: Unknown pass '" << name << "' in -passes!\n";
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+// Parses the literal sampler map |samplerMap| into |samplerMapEntries|.
+// Returns 0 on success, or -1 after writing the problem to |err|.
+int ParseSamplerMap(
+    llvm::StringRef samplerMap,
+    llvm::SmallVectorImpl<std::pair<unsigned, std::string>> *samplerMapEntries,
+    llvm::raw_ostream &err) {
+  llvm::SmallVector<llvm::StringRef, 3> samplerStrings;
+
+  // We need to keep track of the beginning of the current entry.
+  const char *b = samplerMap.begin();
+  for (const char *i = b, *e = samplerMap.end();; i++) {
+    // If we have a separator between declarations.
+    if ((i == e) || (*i == '|') || (*i == ',')) {
+      if (i == b) {
+        err << "Error: Sampler map contained an empty entry!\n";
+        return -1;
+      }
+
+      samplerStrings.push_back(llvm::StringRef(b, i - b).trim());
+
+      // And set b the next character after i.
+      b = i + 1;
+    }
+
+    // If we have a separator between declarations within a single sampler.
+    if ((i == e) || (*i == ',')) {
+      enum NormalizedCoords {
+        CLK_NORMALIZED_COORDS_FALSE = 0x00,
+        CLK_NORMALIZED_COORDS_TRUE = 0x01,
+        CLK_NORMALIZED_COORDS_NOT_SET
+      } NormalizedCoord = CLK_NORMALIZED_COORDS_NOT_SET;
+
+      enum AddressingModes {
+        CLK_ADDRESS_NONE = 0x00,
+        CLK_ADDRESS_CLAMP_TO_EDGE = 0x02,
+        CLK_ADDRESS_CLAMP = 0x04,
+        CLK_ADDRESS_MIRRORED_REPEAT = 0x08,
+        CLK_ADDRESS_REPEAT = 0x06,
+        CLK_ADDRESS_NOT_SET
+      } AddressingMode = CLK_ADDRESS_NOT_SET;
+
+      enum FilterModes {
+        CLK_FILTER_NEAREST = 0x10,
+        CLK_FILTER_LINEAR = 0x20,
+        CLK_FILTER_NOT_SET
+      } FilterMode = CLK_FILTER_NOT_SET;
+
+      for (auto str : samplerStrings) {
+        if ("CLK_NORMALIZED_COORDS_FALSE" == str) {
+          if (CLK_NORMALIZED_COORDS_NOT_SET != NormalizedCoord) {
+            err << "Error: Sampler map normalized coordinates was "
+                   "previously set!\n";
+            return -1;
+          }
+          NormalizedCoord = CLK_NORMALIZED_COORDS_FALSE;
+        } else if ("CLK_NORMALIZED_COORDS_TRUE" == str) {
+          if (CLK_NORMALIZED_COORDS_NOT_SET != NormalizedCoord) {
+            err << "Error: Sampler map normalized coordinates was "
+                   "previously set!\n";
+            return -1;
+          }
+          NormalizedCoord = CLK_NORMALIZED_COORDS_TRUE;
+        } else if ("CLK_ADDRESS_NONE" == str) {
+          if (CLK_ADDRESS_NOT_SET != AddressingMode) {
+            err << "Error: Sampler map addressing mode was previously set!\n";
+            return -1;
+          }
+          AddressingMode = CLK_ADDRESS_NONE;
+        } else if ("CLK_ADDRESS_CLAMP_TO_EDGE" == str) {
+          if (CLK_ADDRESS_NOT_SET != AddressingMode) {
+            err << "Error: Sampler map addressing mode was previously set!\n";
+            return -1;
+          }
+          AddressingMode = CLK_ADDRESS_CLAMP_TO_EDGE;
+        } else if ("CLK_ADDRESS_CLAMP" == str) {
+          if (CLK_ADDRESS_NOT_SET != AddressingMode) {
+            err << "Error: Sampler map addressing mode was previously set!\n";
+            return -1;
+          }
+          AddressingMode = CLK_ADDRESS_CLAMP;
+        } else if ("CLK_ADDRESS_MIRRORED_REPEAT" == str) {
+          if (CLK_ADDRESS_NOT_SET != AddressingMode) {
+            err << "Error: Sampler map addressing mode was previously set!\n";
+            return -1;
+          }
+          AddressingMode = CLK_ADDRESS_MIRRORED_REPEAT;
+        } else if ("CLK_ADDRESS_REPEAT" == str) {
+          if (CLK_ADDRESS_NOT_SET != AddressingMode) {
+            err << "Error: Sampler map addressing mode was previously set!\n";
+            return -1;
+          }
+          AddressingMode = CLK_ADDRESS_REPEAT;
+        } else if ("CLK_FILTER_NEAREST" == str) {
+          if (CLK_FILTER_NOT_SET != FilterMode) {
+            err << "Error: Sampler map filtering mode was previously set!\n";
+            return -1;
+          }
+          FilterMode = CLK_FILTER_NEAREST;
+        } else if ("CLK_FILTER_LINEAR" == str) {
+          if (CLK_FILTER_NOT_SET != FilterMode) {
+            err << "Error: Sampler map filtering mode was previously set!\n";
+            return -1;
+          }
+          FilterMode = CLK_FILTER_LINEAR;
+        } else {
+          err << "Error: Unknown sampler string '" << str << "' found!\n";
+          return -1;
+        }
+      }
+
+      if (CLK_NORMALIZED_COORDS_NOT_SET == NormalizedCoord) {
+        err << "Error: Sampler map entry did not contain normalized "
+               "coordinates entry!\n";
+        return -1;
+      }
+
+      if (CLK_ADDRESS_NOT_SET == AddressingMode) {
+        err << "Error: Sampler map entry did not contain addressing "
+               "mode entry!\n";
+        return -1;
+      }
+
+      if (CLK_FILTER_NOT_SET == FilterMode) {
+        err << "Error: Sampler map entry did not contain filer mode entry!\n";
+        return -1;
+      }
+
+      // Generate an equivalent expression in string form.  Sort the
+      // strings to get a canonical ordering.
+      std::sort(samplerStrings.begin(), samplerStrings.end(),
+                std::less<StringRef>());
+      const auto samplerExpr = std::accumulate(
+          samplerStrings.begin(), samplerStrings.end(), std::string(),
+          [](std::string left, std::string right) {
+            return left + std::string(left.empty() ? "" : "|") + right;
+          });
+
+      samplerMapEntries->emplace_back(
+          NormalizedCoord | AddressingMode | FilterMode, samplerExpr);
+
+      // And reset the sampler strings for the next sampler in the map.
+      samplerStrings.clear();
+    }
+
+    // And lastly, if we are at the end of the map
+    if (i == e) {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+// Sets up |instance| from the options to compile |program|, whose file name
+// is |inputName|, writing diagnostics to |diagnosticsStream|.  When emitting
+// the builtins header's precompiled forms |program| is null.  The caller must
+// hold OptionsMutex.
+void SetCompilerInstanceOptions(CompilerInstance &instance,
+                                llvm::StringRef inputName,
+                                std::unique_ptr<llvm::MemoryBuffer> program,
+                                llvm::raw_string_ostream &diagnosticsStream) {
+  const bool emitBuiltins = !program;
+
+  clang::LangStandard::Kind standard = clang::LangStandard::lang_opencl12;
+
+  // We are targeting OpenCL 1.2 only
+  instance.getLangOpts().OpenCLVersion = 120;
+
+  instance.getLangOpts().C99 = true;
+  instance.getLangOpts().RTTI = false;
+  instance.getLangOpts().RTTIData = false;
+  instance.getLangOpts().MathErrno = false;
+  instance.getLangOpts().Optimize = false;
+  instance.getLangOpts().NoBuiltin = true;
+  instance.getLangOpts().ModulesSearchAll = false;
+  instance.getLangOpts().SinglePrecisionConstants = true;
+  instance.getCodeGenOpts().StackRealignment = true;
+  instance.getCodeGenOpts().SimplifyLibCalls = false;
+  instance.getCodeGenOpts().EmitOpenCLArgMetadata = false;
+  instance.getCodeGenOpts().DisableO0ImplyOptNone = true;
+  instance.getDiagnosticOpts().IgnoreWarnings = false;
+
+  instance.getLangOpts().SinglePrecisionConstants =
+      cl_single_precision_constants;
+  // cl_denorms_are_zero ignored for now!
+  // cl_fp32_correctly_rounded_divide_sqrt ignored for now!
+  instance.getCodeGenOpts().LessPreciseFPMAD =
+      cl_mad_enable || cl_unsafe_math_optimizations;
+  // cl_no_signed_zeros ignored for now!
+  instance.getCodeGenOpts().UnsafeFPMath =
+      cl_unsafe_math_optimizations || cl_fast_relaxed_math;
+  instance.getLangOpts().FiniteMathOnly =
+      cl_finite_math_only || cl_fast_relaxed_math;
+  instance.getLangOpts().FastRelaxedMath = cl_fast_relaxed_math;
+  if (cl_fast_relaxed_math) {
+    instance.getPreprocessorOpts().addMacroDef("__FAST_RELAXED_MATH__");
+  }
+
+  for (auto define : Defines) {
+    instance.getPreprocessorOpts().addMacroDef(define);
+  }
+
+  for (auto include : Includes) {
+    instance.getHeaderSearchOpts().AddPath(include, clang::frontend::After,
+                                           false, false);
+  }
+
+  // We always compile on opt 0 so we preserve as much debug information about
+  // the source as possible. We'll run optimization later, once we've had a
+  // chance to view the unoptimal code first
+  instance.getCodeGenOpts().OptimizationLevel = 0;
+
+// Debug information is disabled temporarily to call instruction.
+#if 0
+  instance.getCodeGenOpts().setDebugInfo(clang::codegenoptions::FullDebugInfo);
+#endif
+
+  // We use the 32-bit pointer-width SPIR triple
+  llvm::Triple triple("spir-unknown-unknown");
+
+  instance.getInvocation().setLangDefaults(
+      instance.getLangOpts(), clang::InputKind::OpenCL, triple,
+      instance.getPreprocessorOpts(), standard);
+
+  // Override the C99 inline semantics to accommodate for more OpenCL C
+  // programs in the wild.
+  instance.getLangOpts().GNUInline = true;
+  instance.createDiagnostics(
+      new clang::TextDiagnosticPrinter(diagnosticsStream,
+                                       &instance.getDiagnosticOpts()),
+      true);
+
+  instance.getTargetOpts().Triple = triple.str();
+
+  // The builtins header, and its precompiled form, live in an in-memory file
+  // system at a fixed absolute location.  A precompiled header records the
+  // paths of its inputs, so this keeps the images made at build time valid
+  // wherever the compiler is run from.  With -lazy-builtins, the header is
+  // just the prelude of types and macros that the builtins table refers to.
+#ifdef _MSC_VER
+  const std::string builtinsDir("C:\\clspv\\include\\");
+#else
+  const std::string builtinsDir("/clspv/include/");
+#endif
+  const std::string builtinsHeaderPath(builtinsDir + "openclc.h");
+  const std::string builtinsPCHPath(builtinsDir + "openclc.pch");
+
+  llvm::StringRef builtinsHeader(opencl_builtins_header_data,
+                                 opencl_builtins_header_size - 1);
+#ifdef CLSPV_PRECOMPILED_BUILTINS
+  if (LazyBuiltins && !emitBuiltins) {
+    builtinsHeader = llvm::StringRef(opencl_builtins_prelude_data,
+                                     opencl_builtins_prelude_size - 1);
+  }
+#endif
+
+  llvm::IntrusiveRefCntPtr<clang::vfs::InMemoryFileSystem> builtinsFS(
+      new clang::vfs::InMemoryFileSystem);
+  builtinsFS->addFile(
+      builtinsHeaderPath, 0,
+      llvm::MemoryBuffer::getMemBuffer(builtinsHeader, builtinsHeaderPath));
+
+  instance.getCodeGenOpts().MainFileName = inputName;
+  instance.getCodeGenOpts().PreserveVec3Type = true;
+  // Disable generation of lifetime intrinsic.
+  instance.getCodeGenOpts().DisableLifetimeMarkers = true;
+  clang::FrontendInputFile kernelFile(
+      emitBuiltins ? llvm::StringRef(builtinsHeaderPath) : inputName,
+      clang::InputKind::OpenCL);
+  instance.getFrontendOpts().Inputs.push_back(kernelFile);
+
+  if (emitBuiltins) {
+    instance.getFrontendOpts().OutputFile = OutputFilename;
+  } else {
+    instance.getPreprocessorOpts().addRemappedFile(inputName,
+                                                   program.release());
+
+    const llvm::StringRef builtinsPCH =
+        LazyBuiltins ? llvm::StringRef()
+                     : GetBuiltinsPCH(instance.getLangOpts());
+    if (builtinsPCH.empty()) {
+      instance.getPreprocessorOpts().Includes.push_back(builtinsHeaderPath);
+    } else {
+      builtinsFS->addFile(builtinsPCHPath, 0,
+                          llvm::MemoryBuffer::getMemBuffer(
+                              builtinsPCH, builtinsPCHPath, false));
+      instance.getPreprocessorOpts().ImplicitPCHInclude = builtinsPCHPath;
+    }
+
+    // With -fp16, kernels do arithmetic on half values without having to
+    // enable cl_khr_fp16 themselves.
+    if (clspv::Option::FP16()) {
+      const std::string fp16HeaderPath(builtinsDir + "fp16.h");
+      builtinsFS->addFile(
+          fp16HeaderPath, 0,
+          llvm::MemoryBuffer::getMemBuffer(
+              "#pragma OPENCL EXTENSION cl_khr_fp16 : enable\n",
+              fp16HeaderPath));
+      instance.getPreprocessorOpts().Includes.push_back(fp16HeaderPath);
+    }
+  }
+
+  llvm::IntrusiveRefCntPtr<clang::vfs::OverlayFileSystem> overlayFS(
+      new clang::vfs::OverlayFileSystem(clang::vfs::getRealFileSystem()));
+  overlayFS->pushOverlay(builtinsFS);
+  instance.setVirtualFileSystem(overlayFS);
+
+  // Add the VULKAN macro.
+  instance.getPreprocessorOpts().addMacroDef("VULKAN=100");
+
+  // Add the __OPENCL_VERSION__ macro.
+  instance.getPreprocessorOpts().addMacroDef("__OPENCL_VERSION__=120");
+
+  instance.setTarget(clang::TargetInfo::CreateTargetInfo(
+      instance.getDiagnostics(),
+      std::make_shared<clang::TargetOptions>(instance.getTargetOpts())));
+
+  instance.createFileManager();
+  instance.createSourceManager(instance.getFileManager());
+}
+
+// Writes the precompiled form of the builtins header selected by the options,
+// set up in |instance|.  Returns 0 on success, or -1 after writing the
+// problem to |err|.
+int GenerateBuiltins(CompilerInstance &instance, const std::string &log,
+                     llvm::raw_ostream &err) {
+  std::unique_ptr<clang::FrontendAction> action;
+  std::unique_ptr<llvm::raw_fd_ostream> tableOut;
+  std::unique_ptr<llvm::raw_fd_ostream> preludeOut;
+
+  if (EmitBuiltinsPCH) {
+    action.reset(new clang::GeneratePCHAction);
+  } else {
+    std::error_code error;
+    tableOut.reset(new llvm::raw_fd_ostream(OutputFilename, error,
+                                            llvm::sys::fs::F_Text));
+    if (error) {
+      err << "Unable to open output file '" << OutputFilename
+          << "': " << error.message() << '\n';
+      return -1;
+    }
+    preludeOut.reset(new llvm::raw_fd_ostream(BuiltinsPrelude, error,
+                                              llvm::sys::fs::F_Text));
+    if (error) {
+      err << "Unable to open output file '" << BuiltinsPrelude
+          << "': " << error.message() << '\n';
+      return -1;
+    }
+    action.reset(new clspv::BuiltinsTableAction(*tableOut, *preludeOut));
+  }
+
+  const clang::FrontendInputFile &input = instance.getFrontendOpts().Inputs[0];
+  if (!action->BeginSourceFile(instance, input)) {
+    return -1;
+  }
+
+  action->Execute();
+  action->EndSourceFile();
+
+  clang::DiagnosticConsumer *const consumer =
+      instance.getDiagnostics().getClient();
+  consumer->finish();
+
+  if (consumer->getNumErrors() > 0) {
+    err << log << "\n";
+    return -1;
+  }
+
+  return 0;
+}
+
+// Returns the passes to run before the SPIR-V producer, in the form -passes
+// takes: the names they are registered under, separated by commas, where
+// "llvm-opt" stands for the LLVM optimizations.  The caller must hold
+// OptionsMutex.
+std::string GetPipeline() {
+  if (!PassPipeline.empty()) {
+    return PassPipeline;
+  }
+
+  std::vector<llvm::StringRef> passes;
+  passes.push_back("ZeroInitializeAllocasPass");
+  passes.push_back("DefineOpenCLWorkItemBuiltins");
+
+  if ('0' != OptimizationLevel) {
+    passes.push_back("OpenCLInliner");
+  }
+
+  passes.push_back("UndoByval");
+  passes.push_back("UndoSRet");
+  if (cluster_non_pointer_kernel_args) {
+    passes.push_back("ClusterPodKernelArgumentsPass");
+  }
+  passes.push_back("ReplaceOpenCLBuiltin");
+
+  // We need to run mem2reg and inst combine early because our
+  // InlineFuncWithPointerBitCastArg pass cannot handle the pattern
+  //   %1 = alloca i32 1
+  //        store <something> %1
+  //   %2 = bitcast float* %1
+  //   %3 = load float %2
+  passes.push_back("mem2reg");
+
+  // Hide loads from __constant address space away from instcombine.
+  // This prevents us from generating select between pointers-to-__constant.
+  // See https://github.com/google/clspv/issues/71
+  passes.push_back("HideConstantLoads");
+
+  passes.push_back("instcombine");
+
+  passes.push_back("InlineFuncWithPointerBitCastArg");
+  passes.push_back("InlineFuncWithPointerToFunctionArgPass");
+
+  if ('0' == OptimizationLevel) {
+    // Mem2Reg pass should be run early because O0 level optimization leaves
+    // redundant alloca, load and store instructions from function arguments.
+    // clspv needs to remove them ahead of transformation.
+    passes.push_back("mem2reg");
+
+    // SROA pass is run because it will fold structs/unions that are problematic
+    // on Vulkan SPIR-V away.
+    passes.push_back("sroa");
+
+    // InstructionCombining pass folds bitcast and gep instructions which are
+    // not supported by Vulkan SPIR-V.
+    passes.push_back("instcombine");
+  }
+
+  // Now we add any of the LLVM optimizations we wanted
+  passes.push_back("llvm-opt");
+
+  // Unhide loads from __constant address space.  Undoes the action of
+  // HideConstantLoadsPass.
+  passes.push_back("UnhideConstantLoads");
+
+  passes.push_back("FunctionInternalizer");
+  passes.push_back("ReplaceLLVMIntrinsics");
+  if (remove_redundant_barriers) {
+    passes.push_back("RemoveRedundantBarriers");
+  }
+  passes.push_back("Legalize");
+  passes.push_back("structurizecfg");
+  passes.push_back("ReorderBasicBlocks");
+  passes.push_back("SimplifyPointerBitcast");
+  passes.push_back("ReplacePointerBitcast");
+
+  if (clspv::Option::ModuleConstantsInStorageBuffer()) {
+    passes.push_back("ClusterModuleScopeConstantVars");
+  }
+
+  passes.push_back("RewriteInserts");
+
+  return llvm::join(passes.begin(), passes.end(), ",");
+}
+
+// Adds the clspv pipeline, as selected by the options, to |pm|.  It writes
+// the SPIR-V module to |binaryStream| and the descriptor map to
+// |descriptorMapStream|.  The caller must hold OptionsMutex.
+void PopulatePassManager(
+    clspv::TimedPassManager *pm, llvm::raw_pwrite_stream *binaryStream,
+    llvm::raw_string_ostream *descriptorMapStream,
+    llvm::ArrayRef<std::pair<unsigned, std::string>> samplerMapEntries) {
+  llvm::PassManagerBuilder pmBuilder;
+
+  switch (OptimizationLevel) {
+  case '0':
+    pmBuilder.OptLevel = 0;
+    break;
+  case '1':
+    pmBuilder.OptLevel = 1;
+    break;
+  case '2':
+    pmBuilder.OptLevel = 2;
+    break;
+  case '3':
+    pmBuilder.OptLevel = 3;
+    break;
+  case 's':
+    pmBuilder.SizeLevel = 1;
+    break;
+  case 'z':
+    pmBuilder.SizeLevel = 2;
+    break;
+  default:
+    break;
+  }
+
+  // ParseOptions has checked that each pass is registered.
+  const std::string pipeline = GetPipeline();
+  llvm::SmallVector<llvm::StringRef, 32> passNames;
+  llvm::StringRef(pipeline).split(passNames, ',', -1, false);
+  const llvm::PassRegistry &registry = *llvm::PassRegistry::getPassRegistry();
+  for (llvm::StringRef name : passNames) {
+    name = name.trim();
+    if ("llvm-opt" != name) {
+      pm->add(registry.getPassInfo(name)->createPass());
+      continue;
+    }
+
+    pm->BeginGroup("LLVM optimizations");
+    if (OptThreads == 1) {
+      pmBuilder.populateModulePassManager(*pm);
+    } else {
+      pm->add(clspv::createParallelOptimizePass(
+          OptThreads, pmBuilder.OptLevel, pmBuilder.SizeLevel));
+    }
+    pm->EndGroup();
+  }
+
+  pm->add(clspv::createSPIRVProducerPass(
+      *binaryStream, *descriptorMapStream, samplerMapEntries,
+      OutputAssembly.getValue(), OutputFormat == "c"));
+}
+
+// Returns the index of the builtins table used by -lazy-builtins, which is
+// built the first time it is needed and then shared by all compilations.
+const clspv::BuiltinsIndex &GetBuiltinsIndex() {
+#ifdef CLSPV_PRECOMPILED_BUILTINS
+  static const clspv::BuiltinsIndex index(llvm::StringRef(
+      opencl_builtins_table_data, opencl_builtins_table_size - 1));
+#else
+  static const clspv::BuiltinsIndex index((llvm::StringRef()));
+#endif
+  return index;
+}
+
+// Traces the headers the preprocessor enters, such as the builtins header
+// when it is not precompiled, as spans of |trace|.
+class TraceHeadersCallbacks : public clang::PPCallbacks {
+public:
+  TraceHeadersCallbacks(clspv::TimeTrace &trace,
+                        clang::SourceManager &sourceManager)
+      : Trace(trace), SM(sourceManager) {}
+
+  void FileChanged(clang::SourceLocation loc, FileChangeReason reason,
+                   clang::SrcMgr::CharacteristicKind, clang::FileID) override {
+    if (reason == EnterFile) {
+      // Only included files are traced.  The main file and the predefines
+      // buffer are covered by the span of the whole parse.
+      const bool included = SM.getIncludeLoc(SM.getFileID(loc)).isValid();
+      if (included) {
+        Trace.Begin("Parse header", SM.getFilename(loc));
+      }
+      Entered.push_back(included);
+    } else if (reason == ExitFile && !Entered.empty()) {
+      if (Entered.back()) {
+        Trace.End();
+      }
+      Entered.pop_back();
+    }
+  }
+
+private:
+  clspv::TimeTrace &Trace;
+  clang::SourceManager &SM;
+  // Whether each file entered and not yet left began a span.
+  std::vector<bool> Entered;
+};
+
+// Returns the name of the function defined in |group|, or an empty string if
+// it defines none.
+std::string DefinedFunctionName(clang::DeclGroupRef group) {
+  for (const clang::Decl *decl : group) {
+    const auto *function = llvm::dyn_cast<clang::FunctionDecl>(decl);
+    if (function && function->doesThisDeclarationHaveABody()) {
+      return function->getNameAsString();
+    }
+  }
+  return std::string();
+}
+
+// Begins, if |begin|, or ends the span of |trace| in which the consumer after
+// it generates the code of each function definition, and of the rest of the
+// translation unit at its end.
+class TraceCodegenConsumer : public clang::ASTConsumer {
+public:
+  TraceCodegenConsumer(clspv::TimeTrace &trace, bool begin)
+      : Trace(trace), Begin(begin) {}
+
+  bool HandleTopLevelDecl(clang::DeclGroupRef group) override {
+    const std::string name = DefinedFunctionName(group);
+    if (!name.empty()) {
+      Mark("Codegen function", name);
+    }
+    return true;
+  }
+
+  void HandleTranslationUnit(clang::ASTContext &) override {
+    Mark("Codegen translation unit", "");
+  }
+
+private:
+  void Mark(llvm::StringRef name, llvm::StringRef detail) {
+    if (Begin) {
+      Trace.Begin(name, detail);
+    } else {
+      Trace.End();
+    }
+  }
+
+  clspv::TimeTrace &Trace;
+  const bool Begin;
+};
+
+// Generates IR like EmitLLVMOnlyAction, tracing the headers parsed and the
+// code generated in the current thread's TimeTrace, if there is one.
+class TracedEmitLLVMOnlyAction : public clang::EmitLLVMOnlyAction {
+public:
+  explicit TracedEmitLLVMOnlyAction(llvm::LLVMContext *context)
+      : clang::EmitLLVMOnlyAction(context) {}
+
+protected:
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(CompilerInstance &instance,
+                    llvm::StringRef inFile) override {
+    std::unique_ptr<clang::ASTConsumer> consumer =
+        clang::EmitLLVMOnlyAction::CreateASTConsumer(instance, inFile);
+    clspv::TimeTrace *trace = clspv::TimeTrace::Current();
+    if (!consumer || !trace) {
+      return consumer;
+    }
+
+    instance.getPreprocessor().addPPCallbacks(
+        llvm::make_unique<TraceHeadersCallbacks>(
+            *trace, instance.getSourceManager()));
+
+    std::vector<std::unique_ptr<clang::ASTConsumer>> consumers;
+    consumers.push_back(llvm::make_unique<TraceCodegenConsumer>(*trace, true));
+    consumers.push_back(std::move(consumer));
+    consumers.push_back(llvm::make_unique<TraceCodegenConsumer>(*trace, false));
+    return llvm::make_unique<clang::MultiplexConsumer>(std::move(consumers));
+  }
+};
+
+// Compiles the program set up in |instance| to a module in |context|, and
+// runs |pm| on it.  Declares builtin functions on demand if |lazyBuiltins|.
+// Times the frontend phases with |timer|, if not null.  Returns 0 on
+// success, or -1 after writing the diagnostics in |log| to |err|.  This does
+// not read command line options, so the caller should not hold
+// OptionsMutex.
+int CompileModule(CompilerInstance &instance, llvm::LLVMContext &context,
+                  llvm::legacy::PassManager &pm, bool lazyBuiltins,
+                  clspv::CompileTimer *timer, const std::string &log,
+                  llvm::raw_ostream &err) {
+  TracedEmitLLVMOnlyAction action(&context);
+
+  // Prepare the action for processing the input file
+  if (timer) {
+    timer->StartStep("Frontend setup");
+  }
+  const bool success =
+      action.BeginSourceFile(instance, instance.getFrontendOpts().Inputs[0]);
+  if (timer) {
+    timer->StopStep();
+  }
+  if (!success) {
+    return -1;
+  }
+
+  if (lazyBuiltins) {
+    instance.setExternalSemaSource(
+        new clspv::BuiltinsSemaSource(GetBuiltinsIndex()));
+  }
+
+  if (timer) {
+    timer->StartStep("Parse and generate IR");
+  }
+  action.Execute();
+  action.EndSourceFile();
+
+  clang::DiagnosticConsumer *const consumer =
+      instance.getDiagnostics().getClient();
+  consumer->finish();
+
+  auto num_errors = consumer->getNumErrors();
+  if (num_errors > 0) {
+    err << log << "\n";
+    return -1;
+  }
+
+  std::unique_ptr<llvm::Module> module(action.takeModule());
+  if (timer) {
+    timer->StopStep(module.get());
+  }
+  pm.run(*module);
+
+  return 0;
+}
+
+// Compiles |program| with the command line |options|, for
+// clspv::CompileFromSourceString.  Returns 0 on success, or -1 after writing
+// the problem to |err|.
+int CompileSourceString(const std::string &program,
+                        const std::string &sampler_map,
+                        const std::string &options,
+                        std::vector<uint32_t> *output_binary,
+                        std::string *output_descriptor_map,
+                        std::string *output_time_report,
+                        llvm::raw_ostream &err) {
+  InitializeOnce("clspv");
+
+  // Split the options into arguments the way a shell would.
+  llvm::BumpPtrAllocator allocator;
+  llvm::StringSaver saver(allocator);
+  llvm::SmallVector<const char *, 16> argv;
+  argv.push_back("clspv");
+  llvm::cl::TokenizeGNUCommandLine(options, saver, argv);
+
+  std::unique_lock<std::mutex> optionsLock(OptionsMutex);
+
+  if (ParseOptions(static_cast<int>(argv.size()), argv.data(), false, err)) {
+    return -1;
+  }
+
+  // Inputs and outputs are passed in memory, and the output is always a
+  // SPIR-V binary.
+  if (InputFilename != "-" || !OutputFilename.empty() ||
+      !DescriptorMapFilename.empty() || !SamplerMap.empty() ||
+      OutputAssembly || !OutputFormat.empty() || EmitBuiltinsPCH ||
+      EmitBuiltinsTable || !BatchManifest.empty() || !CacheDir.empty() ||
+      TimeReport || !TimeReportJSON.empty() || !TimeTraceFilename.empty() ||
+      PrintPipeline) {
+    err << "Error: Files and output formats cannot be given in the options "
+           "of an in-memory compilation!\n";
+    return -1;
+  }
+
+  llvm::SmallVector<std::pair<unsigned, std::string>, 8> SamplerMapEntries;
+  if (!sampler_map.empty() &&
+      ParseSamplerMap(sampler_map, &SamplerMapEntries, err)) {
+    return -1;
+  }
+
+  std::string log;
+  llvm::raw_string_ostream diagnosticsStream(log);
+
+  const llvm::StringRef inputName("source.cl");
+  clang::CompilerInstance instance;
+  SetCompilerInstanceOptions(
+      instance, inputName, llvm::MemoryBuffer::getMemBuffer(program, inputName),
+      diagnosticsStream);
+
+  SmallVector<char, 10000> binary;
+  llvm::raw_svector_ostream binaryStream(binary);
+  std::string descriptor_map;
+  llvm::raw_string_ostream descriptor_map_out(descriptor_map);
+
+  std::unique_ptr<clspv::CompileTimer> timer;
+  if (output_time_report) {
+    timer.reset(new clspv::CompileTimer);
+  }
+
+  clspv::TimedPassManager pm(timer.get());
+  PopulatePassManager(&pm, &binaryStream, &descriptor_map_out,
+                      SamplerMapEntries);
+
+  const bool lazyBuiltins = LazyBuiltins;
+  clspv::Option::ScopedValues optionValues;
+  optionsLock.unlock();
+
+  llvm::LLVMContext context;
+  if (CompileModule(instance, context, pm, lazyBuiltins, timer.get(), log,
+                    err)) {
+    return -1;
+  }
+
+  // The binary is a whole number of SPIR-V words.
+  output_binary->resize(binary.size() / sizeof(uint32_t));
+  std::memcpy(output_binary->data(), binary.data(),
+              output_binary->size() * sizeof(uint32_t));
+
+  if (output_descriptor_map) {
+    *output_descriptor_map = descriptor_map_out.str();
+  }
+
+  if (timer) {
+    output_time_report->clear();
+    llvm::raw_string_ostream report(*output_time_report);
+    timer->PrintJSON(report);
+  }
+
+  return 0;
+}
+
+// Returns a string identifying this build of the compiler, so that results
+// cached by one build are not used by another: the path, size and
+// modification time of the running executable.  Returns an empty string if
+// the executable can't be found.
+const std::string &GetBuildID(const char *programName) {
+  static std::string buildID;
+  static std::once_flag found;
+  std::call_once(found, [programName]() {
+    const std::string path = llvm::sys::fs::getMainExecutable(
+        programName, reinterpret_cast<void *>(
+                         reinterpret_cast<intptr_t>(&GetBuildID)));
+    llvm::sys::fs::file_status status;
+    if (path.empty() || llvm::sys::fs::status(path, status)) {
+      return;
+    }
+    llvm::raw_string_ostream(buildID)
+        << path << ':' << status.getSize() << ':'
+        << status.getLastModificationTime().time_since_epoch().count();
+  });
+  return buildID;
+}
+
+// Feeds the options that determine the result of a compilation, and its
+// |samplerMapEntries|, to |hash|.  The caller must hold OptionsMutex.
+void HashCompilationOptions(
+    llvm::SHA1 *hash,
+    llvm::ArrayRef<std::pair<unsigned, std::string>> samplerMapEntries) {
+  std::string options;
+  llvm::raw_string_ostream out(options);
+  out << '\n' << clspv::Option::ValuesString() << '\n';
+  out << cl_single_precision_constants << cl_denorms_are_zero
+      << cl_fp32_correctly_rounded_divide_sqrt << cl_opt_disable
+      << cl_mad_enable << cl_no_signed_zeros << cl_unsafe_math_optimizations
+      << cl_finite_math_only << cl_fast_relaxed_math << '\n';
+  // Splitting the module for -opt-threads can change the result, but the
+  // number of threads does not.
+  out << OptimizationLevel << OutputAssembly << cluster_non_pointer_kernel_args
+      << remove_redundant_barriers << LazyBuiltins << (OptThreads != 1)
+      << '\n';
+  out << OutputFormat << '\n';
+  out << PassPipeline << '\n';
+  for (const auto &entry : samplerMapEntries) {
+    out << entry.first << ' ' << entry.second << '\n';
+  }
+  hash->update(out.str());
+}
+
+// Preprocesses the program set up in |instance|, feeding the result to
+// |hash|, and returns the resulting cache key.  Returns an empty string if
+// the program can't be preprocessed.
+std::string ComputeCacheKey(CompilerInstance &instance, llvm::SHA1 &hash) {
+  clspv::HashPreprocessedAction action(hash);
+  if (!action.BeginSourceFile(instance, instance.getFrontendOpts().Inputs[0])) {
+    return std::string();
+  }
+  {
+    clspv::TimeTraceScope scope("Preprocess");
+    action.Execute();
+  }
+  action.EndSourceFile();
+
+  if (instance.getDiagnostics().hasErrorOccurred()) {
+    return std::string();
+  }
+
+  return clspv::CompilationCache::Key(hash);
+}
+
+// Writes the |descriptorMap| to |descriptorMapFilename|, if given.  Returns 0
+// on success, or -1 after writing the problem to |err|.
+int WriteDescriptorMap(llvm::StringRef descriptorMap,
+                       const std::string &descriptorMapFilename,
+                       llvm::raw_ostream &err) {
+  if (descriptorMapFilename.empty()) {
+    return 0;
+  }
+
+  std::error_code error;
+  llvm::raw_fd_ostream descriptor_map_out_fd(
+      descriptorMapFilename, error, llvm::sys::fs::F_RW | llvm::sys::fs::F_Text);
+  if (error) {
+    err << "Unable to open descriptor map file '" << descriptorMapFilename
+        << "': " << error.message() << '\n';
+    return -1;
+  }
+  descriptor_map_out_fd << descriptorMap;
+  descriptor_map_out_fd.close();
+
+  return 0;
+}
+
+// Writes the |descriptorMap| to |descriptorMapFilename|, if given, and the
+// |output| module to |outputFilename|.  Returns 0 on success, or -1 after
+// writing the problem to |err|.
+int WriteOutputs(llvm::StringRef output, llvm::StringRef descriptorMap,
+                 const std::string &outputFilename,
+                 const std::string &descriptorMapFilename,
+                 llvm::raw_ostream &err) {
+  if (WriteDescriptorMap(descriptorMap, descriptorMapFilename, err)) {
+    return -1;
+  }
+
+  // Write the resulting binary.
+  // Wait until now to try writing the file so that we only write it on
+  // successful compilation.
+  std::error_code error;
+  llvm::raw_fd_ostream outStream(outputFilename, error, llvm::sys::fs::F_RW);
+
+  if (error) {
+    err << "Unable to open output file '" << outputFilename
+        << "': " << error.message() << '\n';
+    return -1;
+  }
+  outStream << output;
+
+  return 0;
+}
+
+// Opens |stream| for the producer pass to write the module to
+// |outputFilename| as it goes.  Unless that is "-" for stdout, the stream
+// writes to a new temporary file next to it, named in |tempFilename|, for
+// CommitOutput to put in place once the compilation has succeeded.  Returns
+// 0 on success, or -1 after writing the problem to |err|.
+int OpenOutput(const std::string &outputFilename,
+               std::unique_ptr<llvm::raw_fd_ostream> *stream,
+               llvm::SmallVectorImpl<char> *tempFilename,
+               llvm::raw_ostream &err) {
+  std::error_code error;
+  if ("-" == outputFilename) {
+    stream->reset(
+        new llvm::raw_fd_ostream(outputFilename, error, llvm::sys::fs::F_RW));
+  } else {
+    int fd;
+    error = llvm::sys::fs::createUniqueFile(outputFilename + "-%%%%%%.tmp", fd,
+                                            *tempFilename);
+    if (!error) {
+      stream->reset(new llvm::raw_fd_ostream(fd, true));
+    }
+  }
+
+  if (error) {
+    err << "Unable to open output file '" << outputFilename
+        << "': " << error.message() << '\n';
+    return -1;
+  }
+
+  return 0;
+}
+
+// Closes the |stream| opened by OpenOutput, and moves its |tempFilename|, if
+// any, to |outputFilename|.  Returns 0 on success, or -1 after writing the
+// problem to |err|.
+int CommitOutput(llvm::raw_fd_ostream &stream, llvm::StringRef tempFilename,
+                 const std::string &outputFilename, llvm::raw_ostream &err) {
+  stream.close();
+  std::error_code error = stream.error();
+  if (!error && !tempFilename.empty()) {
+    error = llvm::sys::fs::rename(tempFilename, outputFilename);
+  }
+
+  if (error) {
+    stream.clear_error();
+    err << "Unable to write output file '" << outputFilename
+        << "': " << error.message() << '\n';
+    return -1;
+  }
+
+  return 0;
+}
+
+// Reports the steps recorded by |timer|, if not null, on stderr if
+// |timeReport|, and as JSON to |timeReportFilename| if that is not empty.
+// Returns 0 on success, or -1 after writing the problem to |err|.
+int WriteTimeReport(const clspv::CompileTimer *timer, bool timeReport,
+                    const std::string &timeReportFilename,
+                    llvm::raw_ostream &err) {
+  if (!timer) {
+    return 0;
+  }
+
+  if (timeReport) {
+    // Write the whole report at once, so that the reports of concurrent
+    // compilations don't interleave.
+    std::string report;
+    llvm::raw_string_ostream reportStream(report);
+    timer->PrintReport(reportStream);
+    llvm::errs() << reportStream.str();
+  }
+
+  if (!timeReportFilename.empty()) {
+    std::error_code error;
+    llvm::raw_fd_ostream out(timeReportFilename, error, llvm::sys::fs::F_Text);
+    if (error) {
+      err << "Unable to open time report file '" << timeReportFilename
+          << "': " << error.message() << '\n';
+      return -1;
+    }
+    timer->PrintJSON(out);
+  }
+
+  return 0;
+}
+
+// Writes |trace| to |traceFilename|, if not empty, labelled with
+// |inputFilename|.  Returns 0 on success, or -1 after writing the problem to
+// |err|.
+int WriteTimeTrace(const clspv::TimeTrace &trace,
+                   const std::string &traceFilename,
+                   const std::string &inputFilename, llvm::raw_ostream &err) {
+  if (traceFilename.empty()) {
+    return 0;
+  }
+
+  std::error_code error;
+  llvm::raw_fd_ostream out(traceFilename, error, llvm::sys::fs::F_Text);
+  if (error) {
+    err << "Unable to open time trace file '" << traceFilename
+        << "': " << error.message() << '\n';
+    return -1;
+  }
+  trace.Write(out, "clspv " + inputFilename);
+  return 0;
+}
+
+int CompileBatch(const char *programName,
+                 llvm::ArrayRef<std::string> commonArgs,
+                 const std::string &manifestFilename, unsigned jobs,
+                 llvm::raw_ostream &err);
+
+// Compiles as the command line |argv| says to, writing any problems to
+// |err|.  Returns 0 on success.  Runs a batch of compilations if the command
+// line has -batch, and |allowBatch| is true.  Only the process's own command
+// line, where |allowBatch| is true, may give LLVM's options.
+int CompileCommandLine(const int argc, const char *const argv[],
+                       bool allowBatch, llvm::raw_ostream &err) {
+  std::unique_lock<std::mutex> optionsLock(OptionsMutex);
+
+  if (ParseOptions(argc, argv, allowBatch, err)) {
+    return -1;
+  }
+
+  if (PrintPipeline) {
+    llvm::outs() << GetPipeline() << "\n";
+    return 0;
+  }
+
+  if (!BatchManifest.empty()) {
+    if (!allowBatch) {
+      err << "Error: -batch cannot be used in a batch manifest!\n";
+      return -1;
+    }
+    if ("-" != InputFilename) {
+      err << "Error: -batch takes its input files from the manifest!\n";
+      return -1;
+    }
+
+    // The options given alongside -batch apply to each of its compilations.
+    // LLVM's options have been set for the whole process by the parse above,
+    // so they are left out rather than parsed again by each compilation.
+    std::vector<std::string> commonArgs;
+    for (int i = 1; i < argc; i++) {
+      const llvm::StringRef arg(argv[i]);
+      const llvm::StringRef name = arg.ltrim('-').split('=').first;
+      const llvm::cl::Option *llvmOption = FindLLVMOption(arg);
+      if (("batch" == name) || ("batch-jobs" == name) ||
+          (llvmOption &&
+           llvmOption->getValueExpectedFlag() == llvm::cl::ValueRequired)) {
+        // Skip the option's value too, if it is a separate argument.
+        if (!arg.contains('=')) {
+          i++;
+        }
+        continue;
+      }
+      if (llvmOption) {
+        continue;
+      }
+      commonArgs.push_back(arg.str());
+    }
+
+    const std::string manifestFilename = BatchManifest;
+    const unsigned jobs = BatchJobs;
+    optionsLock.unlock();
+
+    return CompileBatch(argv[0], commonArgs, manifestFilename, jobs, err);
+  }
+
+  // When building the builtins header's precompiled forms there is no input
+  // file to compile.
+  const bool emitBuiltins = EmitBuiltinsPCH || EmitBuiltinsTable;
+
+  llvm::StringRef overiddenInputFilename = InputFilename.getValue();
+
+  // If we are reading our input file from stdin.
+  if ("-" == InputFilename) {
+    // We need to overwrite the file name we use.
+    overiddenInputFilename = "stdin.cl";
+  }
+
+  std::unique_ptr<llvm::MemoryBuffer> inputFile;
+  if (!emitBuiltins) {
+    auto errorOrInputFile =
+        llvm::MemoryBuffer::getFileOrSTDIN(InputFilename.getValue());
+
+    // If there was an error in getting the input file.
+    if (!errorOrInputFile) {
+      err << "Error: " << errorOrInputFile.getError().message() << " '"
+          << InputFilename.getValue() << "'\n";
+      return -1;
+    }
+
+    inputFile = std::move(errorOrInputFile.get());
+  }
+
+  // if no output file was provided, use a default
+  if (OutputFilename.empty()) {
+    // if we've to output assembly
+    if (OutputAssembly) {
+      OutputFilename = "a.spvasm";
+    } else if (OutputFormat=="c") {
+      OutputFilename = "a.spvinc";
+    } else {
+      OutputFilename = "a.spv";
+    }
+  }
+
+  llvm::SmallVector<std::pair<unsigned, std::string>, 8> SamplerMapEntries;
+
+  if (!SamplerMap.empty()) {
+    auto errorOrSamplerMapFile =
+        llvm::MemoryBuffer::getFile(SamplerMap.getValue());
+
+    // If there was an error in getting the sampler map file.
+    if (!errorOrSamplerMapFile) {
+      err << "Error: " << errorOrSamplerMapFile.getError().message()
+          << " '" << SamplerMap.getValue() << "'\n";
+      return -1;
+    }
+
+    auto samplerMapBuffer = std::move(errorOrSamplerMapFile.get());
+
+    if (0 == samplerMapBuffer->getBufferSize()) {
+      err << "Error: Sampler map was an empty file!\n";
+      return -1;
+    }
+
+    if (ParseSamplerMap(samplerMapBuffer->getBuffer(), &SamplerMapEntries,
+                        err)) {
+      return -1;
+    }
+  }
+
+  // With -cache-dir, the result is looked up by a hash of the preprocessed
+  // program and everything else that determines it.  The program is
+  // preprocessed by an instance of its own, as it would be compiled.
+  std::unique_ptr<clang::CompilerInstance> preprocessInstance;
+  std::string preprocessLog;
+  llvm::raw_string_ostream preprocessStream(preprocessLog);
+  llvm::SHA1 cacheHash;
+  const std::string &buildID = GetBuildID(argv[0]);
+  const std::string cacheDir =
+      emitBuiltins ? std::string() : CacheDir.getValue();
+  if (!cacheDir.empty() && !buildID.empty()) {
+    cacheHash.update(buildID);
+    HashCompilationOptions(&cacheHash, SamplerMapEntries);
+
+    preprocessInstance.reset(new clang::CompilerInstance);
+    SetCompilerInstanceOptions(
+        *preprocessInstance, overiddenInputFilename,
+        llvm::MemoryBuffer::getMemBuffer(inputFile->getBuffer(),
+                                         overiddenInputFilename),
+        preprocessStream);
+
+    // Leave out the builtins header.  It is the same for every compilation
+    // with a given build of the compiler and options, which are hashed
+    // already, so lexing it would only take time.
+    preprocessInstance->getPreprocessorOpts().Includes.clear();
+    preprocessInstance->getPreprocessorOpts().ImplicitPCHInclude.clear();
+  }
+
+  std::string log;
+  llvm::raw_string_ostream diagnosticsStream(log);
+
+  clang::CompilerInstance instance;
+  SetCompilerInstanceOptions(instance, overiddenInputFilename,
+                             std::move(inputFile), diagnosticsStream);
+
+  if (emitBuiltins) {
+    return GenerateBuiltins(instance, log, err);
+  }
+
+  if (PrintBuiltins) {
+    llvm::StringRef variant;
+    if (LazyBuiltins) {
+      err << "builtins: table\n";
+    } else if (!GetBuiltinsPCH(instance.getLangOpts(), &variant).empty()) {
+      err << "builtins: precompiled " << variant << "\n";
+    } else {
+      err << "builtins: header\n";
+    }
+  }
+
+  // The module is written straight to the output file as it is produced,
+  // unless it has to be kept in memory to be cached.  In that case, or if a
+  // cached result is used, the output is written once the result is known.
+  SmallVector<char, 10000> binary;
+  llvm::raw_svector_ostream binaryStream(binary);
+  llvm::FileRemover tempFileRemover;
+  llvm::SmallString<128> tempFilename;
+  std::unique_ptr<llvm::raw_fd_ostream> outputStream;
+  if (!preprocessInstance) {
+    if (OpenOutput(OutputFilename, &outputStream, &tempFilename, err)) {
+      return -1;
+    }
+    if (!tempFilename.empty()) {
+      tempFileRemover.setFile(tempFilename);
+    }
+  }
+
+  std::string descriptor_map;
+  llvm::raw_string_ostream descriptor_map_out(descriptor_map);
+
+  // Tracing records the compile timer's steps as spans.
+  std::unique_ptr<clspv::CompileTimer> timer;
+  if (TimeReport || !TimeReportJSON.empty() || !TimeTraceFilename.empty()) {
+    timer.reset(new clspv::CompileTimer);
+  }
+
+  clspv::TimedPassManager pm(timer.get());
+  PopulatePassManager(&pm,
+                      outputStream ? static_cast<llvm::raw_pwrite_stream *>(
+                                         outputStream.get())
+                                   : &binaryStream,
+                      &descriptor_map_out, SamplerMapEntries);
+
+  const bool lazyBuiltins = LazyBuiltins;
+  const std::string outputFilename = OutputFilename;
+  const std::string descriptorMapFilename = DescriptorMapFilename;
+  const bool timeReport = TimeReport;
+  const std::string timeReportFilename = TimeReportJSON;
+  const std::string timeTraceFilename = TimeTraceFilename;
+  const std::string inputFilename = InputFilename;
+  clspv::Option::ScopedValues optionValues;
+  optionsLock.unlock();
+
+  clspv::TimeTrace trace;
+  clspv::TimeTrace::ScopedCurrent traceScope(
+      timeTraceFilename.empty() ? nullptr : &trace);
+
+  const clspv::CompilationCache cache(cacheDir);
+  std::string cacheKey;
+  if (preprocessInstance) {
+    if (timer) {
+      timer->StartStep("Cache lookup");
+    }
+    cacheKey = ComputeCacheKey(*preprocessInstance, cacheHash);
+    std::string output, cachedDescriptorMap;
+    const bool hit = !cacheKey.empty() &&
+                     cache.Load(cacheKey, &output, &cachedDescriptorMap);
+    if (timer) {
+      timer->StopStep();
+    }
+    if (hit) {
+      if (WriteOutputs(output, cachedDescriptorMap, outputFilename,
+                       descriptorMapFilename, err)) {
+        return -1;
+      }
+      if (WriteTimeTrace(trace, timeTraceFilename, inputFilename, err)) {
+        return -1;
+      }
+      return WriteTimeReport(timer.get(), timeReport, timeReportFilename, err);
+    }
+  }
+
+  llvm::LLVMContext context;
+  if (CompileModule(instance, context, pm, lazyBuiltins, timer.get(), log,
+                    err)) {
+    return -1;
+  }
+
+  if (outputStream) {
+    if (CommitOutput(*outputStream, tempFilename, outputFilename, err)) {
+      return -1;
+    }
+    tempFileRemover.releaseFile();
+    if (WriteDescriptorMap(descriptor_map_out.str(), descriptorMapFilename,
+                           err)) {
+      return -1;
+    }
+  } else {
+    if (!cacheKey.empty()) {
+      cache.Store(cacheKey, binaryStream.str(), descriptor_map_out.str());
+    }
+
+    if (WriteOutputs(binaryStream.str(), descriptor_map_out.str(),
+                     outputFilename, descriptorMapFilename, err)) {
+      return -1;
+    }
+  }
+
+  if (WriteTimeTrace(trace, timeTraceFilename, inputFilename, err)) {
+    return -1;
+  }
+  return WriteTimeReport(timer.get(), timeReport, timeReportFilename, err);
+}
+
+
+// Compiles each line of the manifest file |manifestFilename| as a command
+// line, after the arguments in |commonArgs|, running up to |jobs| of them at
+// once.  Each compilation has its own clang and LLVM contexts, so a failure
+// only affects its own outputs.  Returns 0 if all of them succeed, or -1
+// after writing each failure to |err|.
+int CompileBatch(const char *programName,
+                 llvm::ArrayRef<std::string> commonArgs,
+                 const std::string &manifestFilename, unsigned jobs,
+                 llvm::raw_ostream &err) {
+  auto errorOrManifest = llvm::MemoryBuffer::getFile(manifestFilename);
+  if (!errorOrManifest) {
+    err << "Error: " << errorOrManifest.getError().message() << " '"
+        << manifestFilename << "'\n";
+    return -1;
+  }
+  const auto manifest = std::move(errorOrManifest.get());
+
+  // A compilation in the manifest.
+  struct Entry {
+    // The line of the manifest it came from, counting from 1.
+    unsigned line;
+    llvm::SmallVector<const char *, 16> argv;
+  };
+
+  llvm::BumpPtrAllocator allocator;
+  llvm::StringSaver saver(allocator);
+  std::vector<Entry> entries;
+
+  // Each line that is neither blank nor a '#' comment is a compilation.
+  llvm::SmallVector<llvm::StringRef, 64> lines;
+  manifest->getBuffer().split(lines, '\n');
+  for (unsigned i = 0; i < lines.size(); i++) {
+    const llvm::StringRef line = lines[i].trim();
+    if (line.empty() || line.startswith("#")) {
+      continue;
+    }
+
+    Entry entry;
+    entry.line = i + 1;
+    entry.argv.push_back(programName);
+    for (const std::string &arg : commonArgs) {
+      entry.argv.push_back(saver.save(arg).data());
+    }
+    llvm::cl::TokenizeGNUCommandLine(line, saver, entry.argv);
+    entries.push_back(std::move(entry));
+  }
+
+  std::vector<int> results(entries.size());
+  std::vector<std::string> logs(entries.size());
+  {
+    llvm::ThreadPool pool(jobs ? jobs
+                               : llvm::heavyweight_hardware_concurrency());
+    for (size_t i = 0; i < entries.size(); i++) {
+      pool.async([&entries, &results, &logs, i]() {
+        const Entry &entry = entries[i];
+        llvm::raw_string_ostream log(logs[i]);
+        results[i] = CompileCommandLine(static_cast<int>(entry.argv.size()),
+                                        entry.argv.data(), false, log);
+      });
+    }
+    pool.wait();
+  }
+
+  // Report failures in manifest order, whatever order they ran in.
+  size_t failures = 0;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (results[i]) {
+      err << manifestFilename << ":" << entries[i].line
+          << ": Error: compilation failed\n"
+          << logs[i];
+      failures++;
+    }
+  }
+
+  if (failures) {
+    err << "Error: " << failures << " of " << entries.size()
+        << " compilations in '" << manifestFilename << "' failed!\n";
+    return -1;
+  }
+
+  return 0;
+}
+
+} // namespace
+
+namespace clspv {
+
+int Compile(const int argc, const char *const argv[]) {
+  InitializeOnce(argv[0]);
+
+  return CompileCommandLine(argc, argv, true, llvm::errs());
+}
+
+int CompileFromSourceString(const std::string &program,
+                            const std::string &sampler_map,
+                            const std::string &options,
+                            std::vector<uint32_t> *output_binary,
+                            std::string *output_descriptor_map,
+                            std::string *output_log,
+                            std::string *output_time_report) {
+  std::string log;
+  llvm::raw_string_ostream err(log);
+  const int result = CompileSourceString(program, sampler_map, options,
+                                         output_binary, output_descriptor_map,
+                                         output_time_report, err);
+  if (output_log) {
+    *output_log = err.str();
+  }
+  return result;
+}
+
+} // namespace clspv
@@ -12,7 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <llvm/ADT/UniqueVector.h>
+#include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Module.h>
@@ -29,8 +29,21 @@ struct InlineFuncWithPointerBitCastArgPass : public ModulePass {
   static char ID;
   InlineFuncWithPointerBitCastArgPass() : ModulePass(ID) {}
 
-  bool InlineFunctions(Module &M);
   bool runOnModule(Module &M) override;
+
+  // Adds the calls among |Values|, and among the users of those of them that
+  // can pass a pointer on, that need to be inlined to WorkList.  Each value
+  // is only looked at once.
+  void FindCallsToInline(ArrayRef<Value *> Values);
+
+  // Returns true if |Call| takes a pointer bitcast, or a pointer derived from
+  // one, and so needs to be inlined.
+  bool UsesPointerBitCast(CallInst *Call) const;
+
+  // The calls to inline, in the order they are to be inlined, and those of
+  // them not inlined yet.
+  SmallVector<CallInst *, 16> WorkList;
+  SmallPtrSet<CallInst *, 16> Queued;
 };
 }
 
@@ -48,75 +61,132 @@ llvm::ModulePass *createInlineFuncWithPointerBitCastArgPass() {
 bool InlineFuncWithPointerBitCastArgPass::runOnModule(Module &M) {
   bool Changed = false;
 
-  // Loop through our inline pass until they stop changing thing.
-  for (bool localChanged = true; localChanged; Changed |= localChanged) {
-    localChanged = false;
-
-    localChanged |= InlineFunctions(M);
-  }
-
-  return Changed;
-}
-
-bool InlineFuncWithPointerBitCastArgPass::InlineFunctions(Module &M) {
-  bool Changed = false;
-
-  UniqueVector<CallInst *> WorkList;
+  // Look through the module for calls to inline once.  After that, only the
+  // calls each inlining creates or changes the arguments of are looked at.
+  SmallVector<Value *, 16> BitcastUsers;
   for (Function &F : M) {
     for (BasicBlock &BB : F) {
       for (Instruction &I : BB) {
-        // If we have a bitcast instruction...
-        if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
-          // ... which is a pointer bitcast...
-          if (Bitcast->getType()->isPointerTy()) {
-            // ... we need to recursively check all the users to find any call
-            // instructions.
-            SmallVector<Value *, 8> ToChecks(Bitcast->user_begin(),
-                                             Bitcast->user_end());
-            SmallSet<Instruction *, 8> CheckedPhis;
-
-            while (!ToChecks.empty()) {
-              auto ToCheck = ToChecks.back();
-              ToChecks.pop_back();
-
-              if (auto Inst = dyn_cast<Instruction>(ToCheck)) {
-                switch (Inst->getOpcode()) {
-                default:
-                  break;
-                case Instruction::Call:
-                  // We found a call instruction which needs to be inlined!
-                  WorkList.insert(cast<CallInst>(Inst));
-                case Instruction::PHI:
-                  // If we previously checked this phi...
-                  if (0 < CheckedPhis.count(Inst)) {
-                    // ... then we don't need to check it again!
-                    break;
-                  }
-
-                  CheckedPhis.insert(Inst);
-                case Instruction::GetElementPtr:
-                case Instruction::BitCast:
-                  // These pointer users could have a call user, and so we
-                  // must check them also.
-                  ToChecks.append(Inst->user_begin(), Inst->user_end());
-                }
-              }
-            }
-          }
+        // If we have a bitcast instruction which is a pointer bitcast, we
+        // need to recursively check all the users to find any call
+        // instructions.
+        if (isa<BitCastInst>(I) && I.getType()->isPointerTy()) {
+          BitcastUsers.append(I.user_begin(), I.user_end());
         }
       }
     }
   }
 
+  FindCallsToInline(BitcastUsers);
+
   // TODO: Need to check pointer bitcast, stored to an alloca, then loaded,
   // then passed into a function?
 
-  for (CallInst *Call : WorkList) {
+  for (size_t i = 0; i < WorkList.size(); i++) {
+    CallInst *Call = WorkList[i];
+    Queued.erase(Call);
+
+    // The users of the call will use what the callee returns instead.
+    SmallVector<Value *, 8> Users(Call->user_begin(), Call->user_end());
+
     InlineFunctionInfo IFI;
     CallSite CS(Call);
     // Disable generation of lifetime intrinsic.
-    Changed |= InlineFunction(CS, IFI, nullptr, false);
+    if (!InlineFunction(CS, IFI, nullptr, false)) {
+      continue;
+    }
+
+    Changed = true;
+
+    // The calls copied from the callee may now take a pointer bitcast that
+    // was passed to the call we inlined...
+    SmallVector<Value *, 8> InlinedCalls;
+    for (auto &V : IFI.InlinedCalls) {
+      if (V) {
+        InlinedCalls.push_back(V);
+      }
+    }
+    FindCallsToInline(InlinedCalls);
+
+    // ... and the users of the call may now use one the callee returned.
+    FindCallsToInline(Users);
   }
 
   return Changed;
 }
+
+void InlineFuncWithPointerBitCastArgPass::FindCallsToInline(
+    ArrayRef<Value *> Values) {
+  // Check the values in order, so that calls are inlined in the order they
+  // come in the module, and so callees tend to have their own calls inlined
+  // before they are inlined in turn.
+  SmallVector<Value *, 8> ToChecks(Values.rbegin(), Values.rend());
+  SmallPtrSet<Value *, 8> Checked;
+
+  while (!ToChecks.empty()) {
+    auto ToCheck = ToChecks.pop_back_val();
+
+    // If we previously checked this value then we don't need to check it
+    // again!
+    if (!Checked.insert(ToCheck).second) {
+      continue;
+    }
+
+    if (auto Inst = dyn_cast<Instruction>(ToCheck)) {
+      switch (Inst->getOpcode()) {
+      default:
+        break;
+      case Instruction::Call:
+        // We found a call instruction which may need to be inlined!
+        if (UsesPointerBitCast(cast<CallInst>(Inst)) &&
+            Queued.insert(cast<CallInst>(Inst)).second) {
+          WorkList.push_back(cast<CallInst>(Inst));
+        }
+      case Instruction::PHI:
+      case Instruction::GetElementPtr:
+      case Instruction::BitCast:
+        // These pointer users could have a call user, and so we must check
+        // them also.
+        ToChecks.append(Inst->user_begin(), Inst->user_end());
+      }
+    }
+  }
+}
+
+bool InlineFuncWithPointerBitCastArgPass::UsesPointerBitCast(
+    CallInst *Call) const {
+  SmallVector<Value *, 8> ToChecks(Call->arg_begin(), Call->arg_end());
+  SmallPtrSet<Value *, 8> Checked;
+
+  while (!ToChecks.empty()) {
+    auto ToCheck = ToChecks.pop_back_val();
+
+    if (!Checked.insert(ToCheck).second) {
+      continue;
+    }
+
+    if (auto Inst = dyn_cast<Instruction>(ToCheck)) {
+      switch (Inst->getOpcode()) {
+      default:
+        break;
+      case Instruction::BitCast:
+        if (Inst->getType()->isPointerTy()) {
+          return true;
+        }
+        ToChecks.push_back(Inst->getOperand(0));
+        break;
+      case Instruction::Call: {
+        auto OtherCall = cast<CallInst>(Inst);
+        ToChecks.append(OtherCall->arg_begin(), OtherCall->arg_end());
+        break;
+      }
+      case Instruction::PHI:
+      case Instruction::GetElementPtr:
+        ToChecks.append(Inst->op_begin(), Inst->op_end());
+        break;
+      }
+    }
+  }
+
+  return false;
+}
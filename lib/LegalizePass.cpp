@@ -0,0 +1,392 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <llvm/ADT/StringSwitch.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "Legalize"
+
+namespace {
+struct LegalizePass : public ModulePass {
+  static char ID;
+  LegalizePass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+  // Legalizes |I|, which may erase it.  Instructions created on the way that
+  // may need legalizing in turn are pushed onto WorkList.  Returns true if
+  // anything changed.
+  bool legalize(Instruction &I);
+
+  // Replaces the get element pointer constant expressions on global variables
+  // that |I| uses by instructions.
+  bool undoGetElementPtrConstantExprs(Instruction &I);
+
+  // Replaces a trunc of a bool that Clang zero extended to an i8 by the bool.
+  bool undoBool(TruncInst &TI);
+
+  // Makes a switch on a truncated integer of an odd width switch on the
+  // integer before the trunc instead.
+  bool undoTruncatedSwitchCondition(SwitchInst &SI);
+
+  // Splits a call to __translate_sampler_initializer on a select into a
+  // select of two calls.
+  bool undoTranslateSamplerFold(CallInst &CI);
+
+  // Splats the scalar arguments of a call to min, max, mix or clamp on
+  // vectors.
+  bool splatArg(CallInst &Call);
+
+  // Splats the bool condition of a select of vectors.
+  bool splatSelectCondition(SelectInst &Sel);
+
+  SmallVector<Instruction *, 16> WorkList;
+};
+} // namespace
+
+char LegalizePass::ID = 0;
+static RegisterPass<LegalizePass> X("Legalize", "Legalize Pass");
+
+namespace clspv {
+ModulePass *createLegalizePass() { return new LegalizePass(); }
+} // namespace clspv
+
+namespace {
+// Returns the name of the overload of min, max, mix or clamp that takes
+// vectors for all its arguments, if |Name| is one that takes scalars for some.
+const char *getSplatName(StringRef Name) {
+  return StringSwitch<const char *>(Name)
+      .Case("_Z5clampDv2_iii", "_Z5clampDv2_iS_S_")
+      .Case("_Z5clampDv3_iii", "_Z5clampDv3_iS_S_")
+      .Case("_Z5clampDv4_iii", "_Z5clampDv4_iS_S_")
+      .Case("_Z5clampDv2_jjj", "_Z5clampDv2_jS_S_")
+      .Case("_Z5clampDv3_jjj", "_Z5clampDv3_jS_S_")
+      .Case("_Z5clampDv4_jjj", "_Z5clampDv4_jS_S_")
+      .Case("_Z5clampDv2_fff", "_Z5clampDv2_fS_S_")
+      .Case("_Z5clampDv3_fff", "_Z5clampDv3_fS_S_")
+      .Case("_Z5clampDv4_fff", "_Z5clampDv4_fS_S_")
+      .Case("_Z5clampDv2_DhDhDh", "_Z5clampDv2_DhS_S_")
+      .Case("_Z5clampDv3_DhDhDh", "_Z5clampDv3_DhS_S_")
+      .Case("_Z5clampDv4_DhDhDh", "_Z5clampDv4_DhS_S_")
+      .Case("_Z3maxDv2_ii", "_Z3maxDv2_iS_")
+      .Case("_Z3maxDv3_ii", "_Z3maxDv3_iS_")
+      .Case("_Z3maxDv4_ii", "_Z3maxDv4_iS_")
+      .Case("_Z3maxDv2_jj", "_Z3maxDv2_jS_")
+      .Case("_Z3maxDv3_jj", "_Z3maxDv3_jS_")
+      .Case("_Z3maxDv4_jj", "_Z3maxDv4_jS_")
+      .Case("_Z3maxDv2_ff", "_Z3maxDv2_fS_")
+      .Case("_Z3maxDv3_ff", "_Z3maxDv3_fS_")
+      .Case("_Z3maxDv4_ff", "_Z3maxDv4_fS_")
+      .Case("_Z3maxDv2_DhDh", "_Z3maxDv2_DhS_")
+      .Case("_Z3maxDv3_DhDh", "_Z3maxDv3_DhS_")
+      .Case("_Z3maxDv4_DhDh", "_Z3maxDv4_DhS_")
+      .Case("_Z4fmaxDv2_ff", "_Z4fmaxDv2_fS_")
+      .Case("_Z4fmaxDv3_ff", "_Z4fmaxDv3_fS_")
+      .Case("_Z4fmaxDv4_ff", "_Z4fmaxDv4_fS_")
+      .Case("_Z4fmaxDv2_DhDh", "_Z4fmaxDv2_DhS_")
+      .Case("_Z4fmaxDv3_DhDh", "_Z4fmaxDv3_DhS_")
+      .Case("_Z4fmaxDv4_DhDh", "_Z4fmaxDv4_DhS_")
+      .Case("_Z3minDv2_ii", "_Z3minDv2_iS_")
+      .Case("_Z3minDv3_ii", "_Z3minDv3_iS_")
+      .Case("_Z3minDv4_ii", "_Z3minDv4_iS_")
+      .Case("_Z3minDv2_jj", "_Z3minDv2_jS_")
+      .Case("_Z3minDv3_jj", "_Z3minDv3_jS_")
+      .Case("_Z3minDv4_jj", "_Z3minDv4_jS_")
+      .Case("_Z3minDv2_ff", "_Z3minDv2_fS_")
+      .Case("_Z3minDv3_ff", "_Z3minDv3_fS_")
+      .Case("_Z3minDv4_ff", "_Z3minDv4_fS_")
+      .Case("_Z3minDv2_DhDh", "_Z3minDv2_DhS_")
+      .Case("_Z3minDv3_DhDh", "_Z3minDv3_DhS_")
+      .Case("_Z3minDv4_DhDh", "_Z3minDv4_DhS_")
+      .Case("_Z4fminDv2_ff", "_Z4fminDv2_fS_")
+      .Case("_Z4fminDv3_ff", "_Z4fminDv3_fS_")
+      .Case("_Z4fminDv4_ff", "_Z4fminDv4_fS_")
+      .Case("_Z4fminDv2_DhDh", "_Z4fminDv2_DhS_")
+      .Case("_Z4fminDv3_DhDh", "_Z4fminDv3_DhS_")
+      .Case("_Z4fminDv4_DhDh", "_Z4fminDv4_DhS_")
+      .Case("_Z3mixDv2_fS_f", "_Z3mixDv2_fS_S_")
+      .Case("_Z3mixDv3_fS_f", "_Z3mixDv3_fS_S_")
+      .Case("_Z3mixDv4_fS_f", "_Z3mixDv4_fS_S_")
+      .Case("_Z3mixDv2_DhS_Dh", "_Z3mixDv2_DhS_S_")
+      .Case("_Z3mixDv3_DhS_Dh", "_Z3mixDv3_DhS_S_")
+      .Case("_Z3mixDv4_DhS_Dh", "_Z3mixDv4_DhS_S_")
+      .Default(nullptr);
+}
+} // namespace
+
+bool LegalizePass::runOnModule(Module &M) {
+  bool Changed = false;
+
+  // Visit each instruction once, in order.  Legalizing an instruction may
+  // erase it, and may erase instructions that dominate it, but never one
+  // that comes after it in its block.
+  for (Function &F : M) {
+    for (BasicBlock &BB : F) {
+      for (auto I = BB.begin(); I != BB.end();) {
+        Instruction &Inst = *I++;
+        Changed |= legalize(Inst);
+
+        while (!WorkList.empty()) {
+          Changed |= legalize(*WorkList.pop_back_val());
+        }
+      }
+    }
+  }
+
+  return Changed;
+}
+
+bool LegalizePass::legalize(Instruction &I) {
+  bool Changed = undoGetElementPtrConstantExprs(I);
+
+  switch (I.getOpcode()) {
+  default:
+    break;
+  case Instruction::Trunc:
+    Changed |= undoBool(cast<TruncInst>(I));
+    break;
+  case Instruction::Switch:
+    Changed |= undoTruncatedSwitchCondition(cast<SwitchInst>(I));
+    break;
+  case Instruction::Call: {
+    auto &Call = cast<CallInst>(I);
+    if (auto Callee = Call.getCalledFunction()) {
+      if (Callee->getName() == "__translate_sampler_initializer") {
+        Changed |= undoTranslateSamplerFold(Call);
+      } else if (getSplatName(Callee->getName())) {
+        Changed |= splatArg(Call);
+      }
+    }
+    break;
+  }
+  case Instruction::Select:
+    Changed |= splatSelectCondition(cast<SelectInst>(I));
+    break;
+  }
+
+  return Changed;
+}
+
+bool LegalizePass::undoGetElementPtrConstantExprs(Instruction &I) {
+  bool Changed = false;
+
+  for (unsigned i = 0; i < I.getNumOperands(); i++) {
+    auto CE = dyn_cast<ConstantExpr>(I.getOperand(i));
+    if (!CE || Instruction::GetElementPtr != CE->getOpcode()) {
+      continue;
+    }
+
+    // Only a constant expression on a global variable, or on another such
+    // constant expression, needs replacing.
+    auto Ptr = CE->getOperand(0);
+    if (!isa<GlobalVariable>(Ptr)) {
+      auto PtrCE = dyn_cast<ConstantExpr>(Ptr);
+      if (!PtrCE || Instruction::GetElementPtr != PtrCE->getOpcode()) {
+        continue;
+      }
+    }
+
+    Instruction *InsertBefore = &I;
+    if (auto PHI = dyn_cast<PHINode>(&I)) {
+      // A phi takes the same value from each edge out of a block, so reuse
+      // the instruction made for an earlier edge out of the incoming block.
+      auto BB = PHI->getIncomingBlock(i);
+      const int Earlier = PHI->getBasicBlockIndex(BB);
+      if (Earlier < static_cast<int>(i)) {
+        PHI->setIncomingValue(i, PHI->getIncomingValue(Earlier));
+        continue;
+      }
+
+      // Otherwise the instruction goes at the end of the incoming block.
+      InsertBefore = BB->getTerminator();
+    }
+
+    // Create the instruction equivalent of the constant expression, which
+    // may use another constant expression in turn.
+    Instruction *NewI = CE->getAsInstruction();
+    NewI->insertBefore(InsertBefore);
+    I.setOperand(i, NewI);
+    WorkList.push_back(NewI);
+
+    if (CE->use_empty()) {
+      CE->destroyConstant();
+    }
+
+    Changed = true;
+  }
+
+  return Changed;
+}
+
+bool LegalizePass::undoBool(TruncInst &TI) {
+  // We are looking for a trunc instruction that produces an i1 from an i8
+  // that a zext produced from an i1.
+  auto ZI = dyn_cast<ZExtInst>(TI.getOperand(0));
+  if (!ZI || !TI.getType()->isIntegerTy(1) ||
+      !ZI->getType()->isIntegerTy(8)) {
+    return false;
+  }
+
+  TI.replaceAllUsesWith(ZI->getOperand(0));
+  TI.eraseFromParent();
+
+  if (ZI->use_empty()) {
+    ZI->eraseFromParent();
+  }
+
+  return true;
+}
+
+bool LegalizePass::undoTruncatedSwitchCondition(SwitchInst &SI) {
+  auto Cond = SI.getCondition();
+
+  // If the condition is a strangely sized integer type.
+  switch (Cond->getType()->getIntegerBitWidth()) {
+  case 8:
+  case 16:
+  case 32:
+  case 64:
+    return false;
+  default:
+    break;
+  }
+
+  auto TI = dyn_cast<TruncInst>(Cond);
+  if (!TI) {
+    Cond->print(errs());
+    llvm_unreachable("Unhandled switch instruction condition!");
+  }
+
+  auto Op = TI->getOperand(0);
+  SI.setCondition(Op);
+
+  auto OpTy = Op->getType();
+
+  for (auto Cases : SI.cases()) {
+    // The original value of the case.
+    auto V = Cases.getCaseValue()->getZExtValue();
+
+    // A new value for the case with the correct type.
+    auto CI = dyn_cast<ConstantInt>(ConstantInt::get(OpTy, V));
+
+    // And we replace the old value.
+    Cases.setValue(CI);
+  }
+
+  if (TI->use_empty()) {
+    TI->eraseFromParent();
+  }
+
+  return true;
+}
+
+bool LegalizePass::undoTranslateSamplerFold(CallInst &CI) {
+  // Get the single argument to the translate sampler function.
+  auto Arg = CI.getArgOperand(0);
+
+  if (isa<ConstantInt>(Arg)) {
+    return false;
+  }
+
+  auto Sel = dyn_cast<SelectInst>(Arg);
+  if (!Sel) {
+    Arg->print(errs());
+    llvm_unreachable("Unhandled argument to __translate_sampler_initializer!");
+  }
+
+  auto NewTrue = CallInst::Create(CI.getCalledFunction(), Sel->getTrueValue(),
+                                  "", &CI);
+  auto NewFalse = CallInst::Create(CI.getCalledFunction(),
+                                   Sel->getFalseValue(), "", &CI);
+  auto NewSel =
+      SelectInst::Create(Sel->getCondition(), NewTrue, NewFalse, "", &CI);
+
+  CI.replaceAllUsesWith(NewSel);
+  CI.eraseFromParent();
+
+  if (Sel->use_empty()) {
+    Sel->eraseFromParent();
+  }
+
+  // The arguments of the new calls may be selects in turn.
+  WorkList.push_back(NewTrue);
+  WorkList.push_back(NewFalse);
+
+  return true;
+}
+
+bool LegalizePass::splatArg(CallInst &Call) {
+  Module &M = *Call.getModule();
+  Function *Callee = Call.getCalledFunction();
+  FunctionType *CalleeTy = Callee->getFunctionType();
+
+  // Create new callee function type with vector type.
+  SmallVector<Type *, 4> NewCalleeParamTys;
+  for (const auto &Arg : Callee->args()) {
+    if (Arg.getType()->isVectorTy()) {
+      NewCalleeParamTys.push_back(Arg.getType());
+    } else {
+      NewCalleeParamTys.push_back(Call.getType());
+    }
+  }
+
+  FunctionType *NewCalleeTy =
+      FunctionType::get(Call.getType(), NewCalleeParamTys, false);
+
+  // Create new callee function declaration with new function type.
+  StringRef NewCallName(getSplatName(Callee->getName()));
+  Function *NewCallee =
+      cast<Function>(M.getOrInsertFunction(NewCallName, NewCalleeTy));
+  NewCallee->setCallingConv(CallingConv::SPIR_FUNC);
+
+  // Change target of call instruction.
+  Call.setCalledFunction(NewCalleeTy, NewCallee);
+
+  // Change operands of call instruction.
+  IRBuilder<> Builder(&Call);
+  for (unsigned i = 0; i < CalleeTy->getNumParams(); i++) {
+    if (!CalleeTy->getParamType(i)->isVectorTy()) {
+      VectorType *VTy = cast<VectorType>(Call.getType());
+      Value *NewArg = Builder.CreateVectorSplat(
+          VTy->getNumElements(), Call.getArgOperand(i), "arg_splat");
+      Call.setArgOperand(i, NewArg);
+    }
+  }
+
+  Call.setCallingConv(CallingConv::SPIR_FUNC);
+
+  return true;
+}
+
+bool LegalizePass::splatSelectCondition(SelectInst &Sel) {
+  auto Cond = Sel.getCondition();
+  if (!Cond->getType()->isIntegerTy(1) ||
+      !Sel.getTrueValue()->getType()->isVectorTy()) {
+    return false;
+  }
+
+  auto NumElems = Sel.getTrueValue()->getType()->getVectorNumElements();
+  IRBuilder<> Builder(&Sel);
+  auto Splat = Builder.CreateVectorSplat(NumElems, Cond);
+  Sel.setCondition(Splat);
+
+  return true;
+}
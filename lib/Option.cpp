@@ -16,6 +16,10 @@
 
 #include <llvm/Support/CommandLine.h>
 
+#include "clspv/Option.h"
+
+#include "ResetOption.h"
+
 namespace {
 // By default, reuse the same descriptor set number for all arguments.
 // To turn that off, use -distinct-kernel-descriptor-sets
@@ -34,6 +38,19 @@ llvm::cl::opt<bool> f16bit_storage(
     "f16bit_storage", llvm::cl::init(false),
     llvm::cl::desc("Assume the target supports SPV_KHR_16bit_storage"));
 
+// Without 8-bit storage, char and uchar values are widened to 32 bits, and
+// char4 and uchar4 values are packed into a 32-bit integer.
+llvm::cl::opt<bool> f8bit_storage(
+    "f8bit_storage", llvm::cl::init(false),
+    llvm::cl::desc("Assume the target supports SPV_KHR_8bit_storage and the "
+                   "Int8 capability"));
+
+llvm::cl::opt<bool> fp16(
+    "fp16", llvm::cl::init(false),
+    llvm::cl::desc("Enable the cl_khr_fp16 extension in kernels, and assume "
+                   "the target supports the Float16 capability for half "
+                   "arithmetic"));
+
 llvm::cl::opt<bool> hack_initializers(
     "hack-initializers", llvm::cl::init(false),
     llvm::cl::desc(
@@ -74,19 +91,146 @@ llvm::cl::opt<bool> module_constants_in_storage_buffer(
 llvm::cl::opt<bool> show_ids("show-ids", llvm::cl::init(false),
                              llvm::cl::desc("Show SPIR-V IDs for functions"));
 
+llvm::cl::opt<bool>
+    no_zero_allocas("no-zero-allocas", llvm::cl::init(false),
+                    llvm::cl::desc("Don't zero-initialize stack variables"));
+
+llvm::cl::opt<bool> zero_allocas_as_needed(
+    "zero-allocas-as-needed", llvm::cl::init(false),
+    llvm::cl::desc("Only zero-initialize the parts of stack variables that "
+                   "may be read before they are written"));
+
+llvm::cl::opt<bool> zero_allocas_report(
+    "zero-allocas-report", llvm::cl::init(false),
+    llvm::cl::desc("Report how many bytes of stack variables each function "
+                   "zero-initializes, and how many it leaves alone, on "
+                   "stderr"));
+
+llvm::cl::opt<unsigned> spirv_threads(
+    "spirv-threads", llvm::cl::init(1),
+    llvm::cl::desc("The number of threads to generate SPIR-V function bodies "
+                   "on at once.  0 means one per hardware thread.  The "
+                   "module produced is the same for any number"),
+    llvm::cl::value_desc("count"));
+
 } // namespace
 
 namespace clspv {
 namespace Option {
 
-bool DistinctKernelDescriptorSets() { return distinct_kernel_descriptor_sets; }
-bool F16BitStorage() { return f16bit_storage; }
-bool HackInitializers() { return hack_initializers; }
-bool HackInserts() { return hack_inserts; }
-bool HackUndef() { return hack_undef; }
-bool ModuleConstantsInStorageBuffer() { return module_constants_in_storage_buffer; }
-bool PodArgsInUniformBuffer() { return pod_ubo; }
-bool ShowIDs() { return show_ids; }
+struct ScopedValues::Values {
+  bool distinct_kernel_descriptor_sets;
+  bool f8bit_storage;
+  bool f16bit_storage;
+  bool fp16;
+  bool hack_initializers;
+  bool hack_inserts;
+  bool hack_undef;
+  bool pod_ubo;
+  bool module_constants_in_storage_buffer;
+  bool show_ids;
+  bool no_zero_allocas;
+  bool zero_allocas_as_needed;
+  bool zero_allocas_report;
+  unsigned spirv_threads;
+};
+
+} // namespace Option
+} // namespace clspv
+
+namespace {
+// The option values captured for the calling thread, or null to use the
+// command line options directly.
+thread_local const clspv::Option::ScopedValues::Values *captured = nullptr;
+} // namespace
+
+namespace clspv {
+namespace Option {
+
+bool DistinctKernelDescriptorSets() {
+  return captured ? captured->distinct_kernel_descriptor_sets
+                  : distinct_kernel_descriptor_sets;
+}
+bool F8BitStorage() {
+  return captured ? captured->f8bit_storage : f8bit_storage;
+}
+bool F16BitStorage() {
+  return captured ? captured->f16bit_storage : f16bit_storage;
+}
+bool FP16() { return captured ? captured->fp16 : fp16; }
+bool HackInitializers() {
+  return captured ? captured->hack_initializers : hack_initializers;
+}
+bool HackInserts() { return captured ? captured->hack_inserts : hack_inserts; }
+bool HackUndef() { return captured ? captured->hack_undef : hack_undef; }
+bool ModuleConstantsInStorageBuffer() {
+  return captured ? captured->module_constants_in_storage_buffer
+                  : module_constants_in_storage_buffer;
+}
+bool PodArgsInUniformBuffer() { return captured ? captured->pod_ubo : pod_ubo; }
+bool ShowIDs() { return captured ? captured->show_ids : show_ids; }
+bool ZeroInitializeAllocas() {
+  return !(captured ? captured->no_zero_allocas : no_zero_allocas);
+}
+bool ZeroInitializeAllocasAsNeeded() {
+  return captured ? captured->zero_allocas_as_needed : zero_allocas_as_needed;
+}
+bool ZeroInitializeAllocasReport() {
+  return captured ? captured->zero_allocas_report : zero_allocas_report;
+}
+unsigned SPIRVThreads() {
+  return captured ? captured->spirv_threads : spirv_threads;
+}
+
+std::string ValuesString() {
+  std::string values;
+  for (bool value :
+       {DistinctKernelDescriptorSets(), F8BitStorage(), F16BitStorage(),
+        FP16(), HackInitializers(), HackInserts(), HackUndef(),
+        ModuleConstantsInStorageBuffer(), PodArgsInUniformBuffer(), ShowIDs(),
+        ZeroInitializeAllocas(), ZeroInitializeAllocasAsNeeded(),
+        ZeroInitializeAllocasReport()}) {
+    values += value ? '1' : '0';
+  }
+  return values;
+}
+
+ScopedValues::ScopedValues()
+    : Captured(new Values{distinct_kernel_descriptor_sets, f8bit_storage,
+                          f16bit_storage, fp16, hack_initializers,
+                          hack_inserts, hack_undef, pod_ubo,
+                          module_constants_in_storage_buffer, show_ids,
+                          no_zero_allocas, zero_allocas_as_needed,
+                          zero_allocas_report, spirv_threads}),
+      Previous(captured) {
+  captured = Captured.get();
+}
+
+ScopedValues::ScopedValues(const Values *values)
+    : Captured(values ? new Values(*values) : nullptr), Previous(captured) {
+  captured = Captured.get();
+}
+
+const ScopedValues::Values *ScopedValues::Current() { return captured; }
+
+ScopedValues::~ScopedValues() { captured = Previous; }
+
+void ResetToDefaults() {
+  ResetOption(distinct_kernel_descriptor_sets);
+  ResetOption(f8bit_storage);
+  ResetOption(f16bit_storage);
+  ResetOption(fp16);
+  ResetOption(hack_initializers);
+  ResetOption(hack_inserts);
+  ResetOption(hack_undef);
+  ResetOption(pod_ubo);
+  ResetOption(module_constants_in_storage_buffer);
+  ResetOption(show_ids);
+  ResetOption(no_zero_allocas);
+  ResetOption(zero_allocas_as_needed);
+  ResetOption(zero_allocas_report);
+  ResetOption(spirv_threads);
+}
 
 } // namespace Option
 } // namespace clspv
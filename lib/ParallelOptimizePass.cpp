@@ -0,0 +1,386 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/EquivalenceClasses.h>
+#include <llvm/ADT/SetVector.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+#include "clspv/Passes.h"
+
+#include "TimeTrace.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "paralleloptimize"
+
+namespace {
+
+struct ParallelOptimizePass : public ModulePass {
+  static char ID;
+  ParallelOptimizePass(unsigned Threads, unsigned OptLevel, unsigned SizeLevel)
+      : ModulePass(ID), Threads(Threads), OptLevel(OptLevel),
+        SizeLevel(SizeLevel) {}
+
+  StringRef getPassName() const override { return "Parallel optimizer"; }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // A part of the module that is optimized on its own.
+  struct Piece {
+    // The functions the piece is built from, and everything they refer to.
+    SetVector<GlobalValue *> Contents;
+    // The piece in its own context, as bitcode.
+    SmallString<0> Bitcode;
+  };
+
+  // Runs the optimization pipeline on |M|.
+  void Optimize(Module &M) const;
+
+  // Optimizes the module in |P|'s bitcode in a context of its own, and
+  // replaces the bitcode with the result.
+  void OptimizeInOwnContext(Piece &P) const;
+
+  const unsigned Threads;
+  const unsigned OptLevel;
+  const unsigned SizeLevel;
+};
+
+char ParallelOptimizePass::ID = 0;
+
+// Adds |Root| and the functions and global variables it refers to, directly
+// or through each other, to |Reached|.  Declarations are left out.
+void AddReached(GlobalValue *Root, SetVector<GlobalValue *> &Reached) {
+  SmallVector<const User *, 16> Worklist;
+  SmallPtrSet<const User *, 16> Visited;
+  auto Visit = [&](GlobalValue *GV) {
+    if (!GV->isDeclaration() && Reached.insert(GV)) {
+      if (auto *F = dyn_cast<Function>(GV)) {
+        for (const BasicBlock &BB : *F) {
+          for (const Instruction &I : BB) {
+            Worklist.push_back(&I);
+          }
+        }
+      } else if (auto *Var = dyn_cast<GlobalVariable>(GV)) {
+        Worklist.push_back(Var->getInitializer());
+      }
+    }
+  };
+
+  Visit(Root);
+  while (!Worklist.empty()) {
+    const User *U = Worklist.pop_back_val();
+    for (const Value *Op : U->operands()) {
+      if (auto *GV = dyn_cast<GlobalValue>(Op)) {
+        Visit(const_cast<GlobalValue *>(GV));
+      } else if (isa<Constant>(Op) && Visited.insert(cast<User>(Op)).second) {
+        // Look through constant expressions and aggregates.
+        Worklist.push_back(cast<User>(Op));
+      }
+    }
+  }
+}
+
+// Erases the declarations in |M| that nothing uses any more.
+void EraseUnusedDeclarations(Module &M) {
+  for (auto I = M.begin(); I != M.end();) {
+    Function &F = *I++;
+    F.removeDeadConstantUsers();
+    if (F.isDeclaration() && F.use_empty()) {
+      F.eraseFromParent();
+    }
+  }
+  for (auto I = M.global_begin(); I != M.global_end();) {
+    GlobalVariable &Var = *I++;
+    Var.removeDeadConstantUsers();
+    if (Var.isDeclaration() && Var.use_empty()) {
+      Var.eraseFromParent();
+    }
+  }
+}
+
+} // namespace
+
+namespace clspv {
+ModulePass *createParallelOptimizePass(unsigned Threads, unsigned OptLevel,
+                                       unsigned SizeLevel) {
+  return new ParallelOptimizePass(Threads, OptLevel, SizeLevel);
+}
+} // namespace clspv
+
+void ParallelOptimizePass::Optimize(Module &M) const {
+  PassManagerBuilder Builder;
+  Builder.OptLevel = OptLevel;
+  Builder.SizeLevel = SizeLevel;
+
+  legacy::PassManager PM;
+  Builder.populateModulePassManager(PM);
+  PM.run(M);
+}
+
+void ParallelOptimizePass::OptimizeInOwnContext(Piece &P) const {
+  LLVMContext Context;
+  auto Parsed = parseBitcodeFile(
+      MemoryBufferRef(StringRef(P.Bitcode.data(), P.Bitcode.size()), "piece"),
+      Context);
+  if (!Parsed) {
+    report_fatal_error("Unable to read back a piece of the module: " +
+                       toString(Parsed.takeError()));
+  }
+  std::unique_ptr<Module> M = std::move(*Parsed);
+
+  Optimize(*M);
+  EraseUnusedDeclarations(*M);
+
+  P.Bitcode.clear();
+  raw_svector_ostream Out(P.Bitcode);
+  WriteBitcodeToFile(M.get(), Out);
+}
+
+bool ParallelOptimizePass::runOnModule(Module &M) {
+  if (!M.alias_empty() || !M.ifunc_empty()) {
+    // Aliases could tie pieces together in ways that are not worth following.
+    Optimize(M);
+    return true;
+  }
+  for (GlobalVariable &Var : M.globals()) {
+    if (!Var.hasLocalLinkage() && !Var.isDeclaration()) {
+      // Variables that stay in the module must not refer to what is taken
+      // out of it.
+      SetVector<GlobalValue *> Reached;
+      AddReached(&Var, Reached);
+      if (Reached.size() > 1) {
+        Optimize(M);
+        return true;
+      }
+    }
+  }
+
+  // Each kernel is the root of a piece, along with each function that no
+  // kernel calls.  Roots that share something with local linkage, which has
+  // to stay unique, are put in the same piece.  Other functions are copied
+  // into each piece that calls them.  Global variables without local linkage
+  // stay in the module, and each piece refers to them.  Constant ones are
+  // copied as available_externally so that loads from them still fold.
+  std::vector<GlobalValue *> Roots;
+  for (Function &F : M) {
+    if (!F.isDeclaration() && F.getCallingConv() == CallingConv::SPIR_KERNEL) {
+      Roots.push_back(&F);
+    }
+  }
+  SetVector<GlobalValue *> ReachedFromKernels;
+  for (GlobalValue *Root : Roots) {
+    AddReached(Root, ReachedFromKernels);
+  }
+  for (Function &F : M) {
+    if (!F.isDeclaration() && !ReachedFromKernels.count(&F)) {
+      Roots.push_back(&F);
+    }
+  }
+
+  DenseMap<GlobalValue *, SetVector<GlobalValue *>> ReachedFromRoot;
+  EquivalenceClasses<GlobalValue *> Classes;
+  DenseMap<GlobalValue *, GlobalValue *> LocalOwner;
+  for (GlobalValue *Root : Roots) {
+    SetVector<GlobalValue *> &Reached = ReachedFromRoot[Root];
+    AddReached(Root, Reached);
+    Classes.insert(Root);
+    for (GlobalValue *GV : Reached) {
+      if (GV->hasLocalLinkage()) {
+        auto Owner = LocalOwner.insert(std::make_pair(GV, Root));
+        Classes.unionSets(Root, Owner.first->second);
+      }
+    }
+  }
+
+  // The pieces, in the order of their first roots.
+  std::vector<std::unique_ptr<Piece>> Pieces;
+  DenseMap<GlobalValue *, Piece *> PieceOfLeader;
+  for (GlobalValue *Root : Roots) {
+    Piece *&P = PieceOfLeader[Classes.getLeaderValue(Root)];
+    if (!P) {
+      Pieces.emplace_back(new Piece);
+      P = Pieces.back().get();
+    }
+    P->Contents.insert(ReachedFromRoot[Root].begin(),
+                       ReachedFromRoot[Root].end());
+  }
+
+  if (Pieces.size() <= 1) {
+    Optimize(M);
+    return true;
+  }
+
+  // Functions copied into several pieces may be defined by any of them once
+  // linked back together, and are restored to their own linkage then.
+  DenseMap<GlobalValue *, unsigned> PieceCount;
+  for (auto &P : Pieces) {
+    for (GlobalValue *GV : P->Contents) {
+      PieceCount[GV]++;
+    }
+  }
+  std::vector<std::pair<std::string, GlobalValue::LinkageTypes>> Shared;
+  for (Function &F : M) {
+    if (PieceCount.lookup(&F) > 1) {
+      Shared.push_back(std::make_pair(F.getName().str(), F.getLinkage()));
+    }
+  }
+
+  std::vector<std::string> FunctionOrder;
+  for (Function &F : M) {
+    FunctionOrder.push_back(F.getName().str());
+  }
+  std::vector<std::string> GlobalOrder;
+  for (GlobalVariable &Var : M.globals()) {
+    GlobalOrder.push_back(Var.getName().str());
+  }
+
+  {
+    clspv::TimeTraceScope scope("Split module");
+    for (auto &P : Pieces) {
+      ValueToValueMapTy VMap;
+      std::unique_ptr<Module> Clone =
+          CloneModule(&M, VMap, [&P](const GlobalValue *GV) {
+            return P->Contents.count(const_cast<GlobalValue *>(GV));
+          });
+      for (GlobalValue *GV : P->Contents) {
+        auto *Var = dyn_cast<GlobalVariable>(GV);
+        if (Var && !Var->hasLocalLinkage()) {
+          // The piece may still fold loads from constants it does not own.
+          auto *Copy = cast<GlobalVariable>(VMap[Var]);
+          if (Var->isConstant()) {
+            Copy->setLinkage(GlobalValue::AvailableExternallyLinkage);
+          } else {
+            Copy->setInitializer(nullptr);
+            Copy->setLinkage(GlobalValue::ExternalLinkage);
+          }
+        } else if (!Var && PieceCount.lookup(GV) > 1) {
+          cast<Function>(VMap[GV])->setLinkage(GlobalValue::LinkOnceODRLinkage);
+        }
+      }
+      // The module keeps its named metadata, such as the OpenCL version.
+      while (!Clone->named_metadata_empty()) {
+        Clone->eraseNamedMetadata(&*Clone->named_metadata_begin());
+      }
+      EraseUnusedDeclarations(*Clone);
+
+      raw_svector_ostream Out(P->Bitcode);
+      WriteBitcodeToFile(Clone.get(), Out);
+    }
+  }
+
+  // Take what went into the pieces out of the module.
+  SmallVector<GlobalValue *, 16> Moved;
+  for (Function &F : M) {
+    if (!F.isDeclaration()) {
+      Moved.push_back(&F);
+    }
+  }
+  for (GlobalVariable &Var : M.globals()) {
+    if (LocalOwner.count(&Var)) {
+      Moved.push_back(&Var);
+    }
+  }
+  for (GlobalValue *GV : Moved) {
+    if (auto *F = dyn_cast<Function>(GV)) {
+      F->dropAllReferences();
+    } else {
+      cast<GlobalVariable>(GV)->dropAllReferences();
+    }
+  }
+  for (GlobalValue *GV : Moved) {
+    GV->removeDeadConstantUsers();
+    GV->eraseFromParent();
+  }
+
+  {
+    clspv::TimeTraceScope scope("Optimize pieces");
+    const unsigned NumThreads =
+        Threads ? Threads : heavyweight_hardware_concurrency();
+    if (NumThreads <= 1) {
+      for (auto &P : Pieces) {
+        OptimizeInOwnContext(*P);
+      }
+    } else {
+      ThreadPool Pool(std::min<size_t>(NumThreads, Pieces.size()));
+      for (auto &P : Pieces) {
+        Piece *ToOptimize = P.get();
+        Pool.async([this, ToOptimize]() { OptimizeInOwnContext(*ToOptimize); });
+      }
+      Pool.wait();
+    }
+  }
+
+  {
+    clspv::TimeTraceScope scope("Link pieces");
+    for (auto &P : Pieces) {
+      auto Parsed = parseBitcodeFile(
+          MemoryBufferRef(StringRef(P->Bitcode.data(), P->Bitcode.size()),
+                          "piece"),
+          M.getContext());
+      if (!Parsed) {
+        report_fatal_error("Unable to read back a piece of the module: " +
+                           toString(Parsed.takeError()));
+      }
+      if (Linker::linkModules(M, std::move(*Parsed))) {
+        report_fatal_error("Unable to link a piece back into the module");
+      }
+      P->Bitcode.clear();
+    }
+
+    for (const auto &NameAndLinkage : Shared) {
+      if (Function *F = M.getFunction(NameAndLinkage.first)) {
+        F->setLinkage(NameAndLinkage.second);
+      }
+    }
+
+    // Put the functions and variables back in their original order, so the
+    // kernels keep theirs.
+    for (const std::string &Name : FunctionOrder) {
+      if (Function *F = M.getFunction(Name)) {
+        M.getFunctionList().splice(M.end(), M.getFunctionList(),
+                                   F->getIterator());
+      }
+    }
+    for (const std::string &Name : GlobalOrder) {
+      if (GlobalVariable *Var = M.getGlobalVariable(Name, true)) {
+        M.getGlobalList().splice(M.global_end(), M.getGlobalList(),
+                                 Var->getIterator());
+      }
+    }
+  }
+
+  return true;
+}
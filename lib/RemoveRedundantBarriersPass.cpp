@@ -0,0 +1,213 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <clspv/AddressSpace.h>
+
+using namespace llvm;
+
+#define DEBUG_TYPE "removeredundantbarriers"
+
+namespace {
+
+struct RemoveRedundantBarriersPass : public ModulePass {
+  static char ID;
+  RemoveRedundantBarriersPass() : ModulePass(ID) {}
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // Removes the barriers of the kernel |F| that order no accesses to memory
+  // shared with other invocations.  Returns true if any was removed.
+  bool runOnKernel(Function &F);
+};
+
+// Returns true if |I| is a call to a control or memory barrier.
+bool IsBarrier(const Instruction &I) {
+  if (auto *Call = dyn_cast<CallInst>(&I)) {
+    if (Function *Callee = Call->getCalledFunction()) {
+      return Callee->getName() == "__spirv_control_barrier" ||
+             Callee->getName() == "__spirv_memory_barrier";
+    }
+  }
+  return false;
+}
+
+// Returns true if memory in |AddressSpace| may be written by one invocation
+// and read by another.
+bool IsSharedAddressSpace(unsigned AddressSpace) {
+  switch (AddressSpace) {
+  case clspv::AddressSpace::Private:
+  case clspv::AddressSpace::Constant:
+  case clspv::AddressSpace::Input:
+  case clspv::AddressSpace::UniformConstant:
+  case clspv::AddressSpace::ModuleScopePrivate:
+    return false;
+  default:
+    return true;
+  }
+}
+
+// Returns true if |I| may access memory that other invocations may access
+// too.  Barriers are not counted, and any other call that may access memory
+// is.
+bool IsSharedMemoryAccess(const Instruction &I) {
+  if (!I.mayReadOrWriteMemory() || IsBarrier(I)) {
+    return false;
+  }
+  if (auto *Load = dyn_cast<LoadInst>(&I)) {
+    return IsSharedAddressSpace(Load->getPointerAddressSpace());
+  }
+  if (auto *Store = dyn_cast<StoreInst>(&I)) {
+    return IsSharedAddressSpace(Store->getPointerAddressSpace());
+  }
+  return true;
+}
+
+// Returns true if the barriers |A| and |B| are the same.
+bool AreSameBarriers(const CallInst *A, const CallInst *B) {
+  if (A->getCalledFunction() != B->getCalledFunction()) {
+    return false;
+  }
+  for (unsigned i = 0; i < A->getNumArgOperands(); i++) {
+    if (A->getArgOperand(i) != B->getArgOperand(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+char RemoveRedundantBarriersPass::ID = 0;
+static RegisterPass<RemoveRedundantBarriersPass>
+    X("RemoveRedundantBarriers", "Remove barriers that order nothing");
+
+namespace clspv {
+ModulePass *createRemoveRedundantBarriersPass() {
+  return new RemoveRedundantBarriersPass();
+}
+} // namespace clspv
+
+bool RemoveRedundantBarriersPass::runOnModule(Module &M) {
+  bool Changed = false;
+
+  for (Function &F : M) {
+    if (!F.isDeclaration() &&
+        F.getCallingConv() == CallingConv::SPIR_KERNEL) {
+      Changed |= runOnKernel(F);
+    }
+  }
+
+  return Changed;
+}
+
+bool RemoveRedundantBarriersPass::runOnKernel(Function &F) {
+  // Find the blocks with a shared memory access, and the barriers.
+  DenseMap<BasicBlock *, bool> HasAccess;
+  SmallVector<CallInst *, 8> Barriers;
+  for (BasicBlock &BB : F) {
+    bool Access = false;
+    for (Instruction &I : BB) {
+      if (IsBarrier(I)) {
+        Barriers.push_back(cast<CallInst>(&I));
+      } else {
+        Access |= IsSharedMemoryAccess(I);
+      }
+    }
+    HasAccess[&BB] = Access;
+  }
+
+  if (Barriers.empty()) {
+    return false;
+  }
+
+  // Find the blocks that a shared memory access may be executed before, and
+  // the blocks that one may be executed after.  Loops carry accesses around
+  // to the start of their blocks.
+  DenseMap<BasicBlock *, bool> AccessBefore;
+  DenseMap<BasicBlock *, bool> AccessAfter;
+  SmallVector<BasicBlock *, 16> WorkList;
+  for (BasicBlock &BB : F) {
+    if (HasAccess[&BB]) {
+      WorkList.push_back(&BB);
+    }
+  }
+  while (!WorkList.empty()) {
+    BasicBlock *BB = WorkList.pop_back_val();
+    for (BasicBlock *Succ : successors(BB)) {
+      if (!AccessBefore[Succ]) {
+        AccessBefore[Succ] = true;
+        WorkList.push_back(Succ);
+      }
+    }
+  }
+  for (BasicBlock &BB : F) {
+    if (HasAccess[&BB]) {
+      WorkList.push_back(&BB);
+    }
+  }
+  while (!WorkList.empty()) {
+    BasicBlock *BB = WorkList.pop_back_val();
+    for (BasicBlock *Pred : predecessors(BB)) {
+      if (!AccessAfter[Pred]) {
+        AccessAfter[Pred] = true;
+        WorkList.push_back(Pred);
+      }
+    }
+  }
+
+  // A barrier orders the shared memory accesses before it with those after
+  // it, so it orders nothing if there are none on one side of it.  Nor does
+  // a barrier that follows the same barrier with no access in between.
+  SmallVector<CallInst *, 8> ToRemoves;
+  for (CallInst *Barrier : Barriers) {
+    BasicBlock *BB = Barrier->getParent();
+
+    bool Before = AccessBefore[BB];
+    CallInst *Previous = nullptr;
+    for (auto I = BB->begin(); &*I != Barrier; ++I) {
+      if (IsSharedMemoryAccess(*I)) {
+        Before = true;
+        Previous = nullptr;
+      } else if (IsBarrier(*I)) {
+        Previous = cast<CallInst>(&*I);
+      }
+    }
+
+    bool After = AccessAfter[BB];
+    for (auto I = ++Barrier->getIterator(); !After && I != BB->end(); ++I) {
+      After = IsSharedMemoryAccess(*I);
+    }
+
+    if (!Before || !After ||
+        (Previous && AreSameBarriers(Previous, Barrier))) {
+      ToRemoves.push_back(Barrier);
+    }
+  }
+
+  for (CallInst *Barrier : ToRemoves) {
+    Barrier->eraseFromParent();
+  }
+
+  return !ToRemoves.empty();
+}
@@ -12,6 +12,10 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <iterator>
+
+#include <llvm/ADT/DepthFirstIterator.h>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/IR/Dominators.h>
 #include <llvm/Pass.h>
 #include <llvm/Support/raw_ostream.h>
@@ -27,6 +31,8 @@ struct ReorderBasicBlocksPass : public FunctionPass {
 
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequired<DominatorTreeWrapperPass>();
+    // Moving blocks around changes neither the CFG nor what depends on it.
+    AU.setPreservesCFG();
   }
 
   bool runOnFunction(Function &F) override;
@@ -44,19 +50,34 @@ FunctionPass *createReorderBasicBlocksPass() {
 }
 
 bool ReorderBasicBlocksPass::runOnFunction(Function &F) {
-  bool Changed = false;
-
   // spirv-val wants the order of basic blocks to follow dominance relation.
   // Reorder basic blocks according to dominance relation.
   DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
 
-  // Traverse dominator tree using depth first order. Reorder basic blocks
-  // according to dominance relation.
-  for (auto II = df_begin(DT.getRootNode()), IE = df_end(DT.getRootNode());
-       II != IE; ++II) {
-    BasicBlock *BB = (*II)->getBlock();
+  // Traverse dominator tree using depth first order, which is the order the
+  // blocks it reaches should end up in, after any others.
+  SmallVector<BasicBlock *, 32> Order;
+  for (DomTreeNode *Node : depth_first(DT.getRootNode())) {
+    Order.push_back(Node->getBlock());
+  }
+
+  // Leave the function alone if its blocks are in that order already.
+  auto BBI = F.begin();
+  std::advance(BBI, F.size() - Order.size());
+  bool InOrder = true;
+  for (BasicBlock *BB : Order) {
+    if (&*BBI++ != BB) {
+      InOrder = false;
+      break;
+    }
+  }
+  if (InOrder) {
+    return false;
+  }
+
+  for (BasicBlock *BB : Order) {
     BB->moveAfter(&F.back());
   }
 
-  return Changed;
+  return true;
 }
@@ -20,7 +20,7 @@
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Transforms/Utils/Cloning.h>
 
-#include <spirv/1.0/spirv.hpp>
+#include <spirv/unified1/spirv.hpp>
 
 using namespace llvm;
 
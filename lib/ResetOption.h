@@ -0,0 +1,46 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_RESETOPTION_H_
+#define CLSPV_LIB_RESETOPTION_H_
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/CommandLine.h"
+
+namespace clspv {
+
+// Returns clspv's own options, as opposed to those LLVM defines.  Each option
+// is added the first time ResetOption resets it.
+inline llvm::SmallPtrSetImpl<const llvm::cl::Option *> &OwnOptions() {
+  static llvm::SmallPtrSet<const llvm::cl::Option *, 64> options;
+  return options;
+}
+
+// Restores |option| to the value it was initialized with, discarding any
+// value parsed from a command line since.
+template <typename T> void ResetOption(llvm::cl::opt<T> &option) {
+  OwnOptions().insert(&option);
+  const auto &initial = option.getDefault();
+  option.setValue(initial.hasValue() ? initial.getValue() : T());
+}
+
+// Empties |option|, discarding any values parsed from a command line.
+template <typename T> void ResetOption(llvm::cl::list<T> &option) {
+  OwnOptions().insert(&option);
+  option.clear();
+}
+
+} // namespace clspv
+
+#endif
@@ -18,11 +18,13 @@
 
 #include <cassert>
 #include <cstring>
+#include <memory>
 
 #include <unordered_set>
 #include <clspv/Option.h>
 #include <clspv/Passes.h>
 
+#include <llvm/ADT/STLExtras.h>
 #include <llvm/ADT/StringSwitch.h>
 #include <llvm/ADT/UniqueVector.h>
 #include <llvm/Analysis/LoopInfo.h>
@@ -32,22 +34,28 @@
 #include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Pass.h>
+#include <llvm/Support/Allocator.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/ErrorHandling.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Transforms/Utils/Cloning.h>
 
-#include "spirv/1.0/spirv.hpp"
+#include "spirv/unified1/spirv.hpp"
 #include "clspv/AddressSpace.h"
-#include "clspv/spirv_c_strings.hpp"
 #include "clspv/spirv_glsl.hpp"
+#include "clspv/spirv_grammar.hpp"
 
 #include "ArgKind.h"
 #include "ConstantEmitter.h"
+#include "StructuredControlFlow.h"
+#include "TimeTrace.h"
 
-#include <list>
+#include <algorithm>
 #include <iomanip>
+#include <memory>
 #include <set>
-#include <sstream>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -67,48 +75,45 @@ namespace {
 const double kOneOverPi = 0.318309886183790671538;
 const glsl::ExtInst kGlslExtInstBad = static_cast<glsl::ExtInst>(0);
 
+// The version of SPIR-V that is produced.  The unified headers define
+// spv::Version as the newest version they describe, so it is not used.
+const uint32_t kSPIRVVersion = 0x00010000;
+
 const char* kCompositeConstructFunctionPrefix = "clspv.composite_construct.";
 
-enum SPIRVOperandType {
+enum SPIRVOperandType : uint8_t {
   NUMBERID,
   LITERAL_INTEGER,
   LITERAL_STRING,
-  LITERAL_FLOAT
+  LITERAL_FLOAT,
+  LITERAL_HALF
 };
 
+// An operand of a SPIR-V instruction, as the words that encode it.  Strings
+// are encoded once, when the operand is made, including their terminating
+// null character.
 struct SPIRVOperand {
   explicit SPIRVOperand(SPIRVOperandType Ty, uint32_t Num)
-      : Type(Ty), LiteralNum(1, Num) {}
-  explicit SPIRVOperand(SPIRVOperandType Ty, const char *Str)
-      : Type(Ty), LiteralStr(Str) {}
+      : Type(Ty), Words(1, Num) {}
   explicit SPIRVOperand(SPIRVOperandType Ty, StringRef Str)
-      : Type(Ty), LiteralStr(Str) {}
+      : Type(Ty), Words((Str.size() + 4) / 4, 0) {
+    std::memcpy(Words.data(), Str.data(), Str.size());
+  }
   explicit SPIRVOperand(SPIRVOperandType Ty, ArrayRef<uint32_t> NumVec)
-      : Type(Ty), LiteralNum(NumVec.begin(), NumVec.end()) {}
+      : Type(Ty), Words(NumVec.begin(), NumVec.end()) {}
 
-  SPIRVOperandType getType() { return Type; };
-  uint32_t getNumID() { return LiteralNum[0]; };
-  std::string getLiteralStr() { return LiteralStr; };
-  ArrayRef<uint32_t> getLiteralNum() { return LiteralNum; };
-
-  uint32_t GetNumWords() const {
-    switch (Type) {
-    case NUMBERID:
-      return 1;
-    case LITERAL_INTEGER:
-    case LITERAL_FLOAT:
-      return LiteralNum.size();
-    case LITERAL_STRING:
-      // Account for the terminating null character.
-      return (LiteralStr.size() + 4) / 4;
-    }
-    llvm_unreachable("Unhandled case in SPIRVOperand::GetNumWords()");
-  }
+  SPIRVOperandType getType() const { return Type; };
+  uint32_t getNumID() const { return Words[0]; };
+  StringRef getLiteralStr() const {
+    return reinterpret_cast<const char *>(Words.data());
+  };
+  ArrayRef<uint32_t> getLiteralNum() const { return Words; };
+  ArrayRef<uint32_t> getWords() const { return Words; }
+  uint32_t GetNumWords() const { return Words.size(); }
 
 private:
   SPIRVOperandType Type;
-  std::string LiteralStr;
-  SmallVector<uint32_t, 4> LiteralNum;
+  SmallVector<uint32_t, 2> Words;
 };
 
 class SPIRVOperandList {
@@ -119,92 +124,272 @@ public:
     contents_ = std::move(other.contents_);
     other.contents_.clear();
   }
-  SPIRVOperandList(ArrayRef<SPIRVOperand *> init)
+  SPIRVOperandList(ArrayRef<SPIRVOperand> init)
       : contents_(init.begin(), init.end()) {}
-  operator ArrayRef<SPIRVOperand *>() { return contents_; }
-  void push_back(SPIRVOperand *op) { contents_.push_back(op); }
+  operator ArrayRef<SPIRVOperand>() { return contents_; }
+  void push_back(SPIRVOperand &&op) { contents_.push_back(std::move(op)); }
   void clear() { contents_.clear();}
   size_t size() const { return contents_.size(); }
-  SPIRVOperand *&operator[](size_t i) { return contents_[i]; }
+  SPIRVOperand *operator[](size_t i) { return &contents_[i]; }
 
-  const SmallVector<SPIRVOperand *, 8> &getOperands() const {
+  const SmallVector<SPIRVOperand, 8> &getOperands() const {
     return contents_;
   }
 
 private:
-  SmallVector<SPIRVOperand *,8> contents_;
+  SmallVector<SPIRVOperand, 8> contents_;
 };
 
-SPIRVOperandList &operator<<(SPIRVOperandList &list, SPIRVOperand *elem) {
-  list.push_back(elem);
+SPIRVOperandList &operator<<(SPIRVOperandList &list, SPIRVOperand &&elem) {
+  list.push_back(std::move(elem));
   return list;
 }
 
-SPIRVOperand* MkNum(uint32_t num) {
-  return new SPIRVOperand(LITERAL_INTEGER, num);
+SPIRVOperand MkNum(uint32_t num) {
+  return SPIRVOperand(LITERAL_INTEGER, num);
+}
+SPIRVOperand MkInteger(ArrayRef<uint32_t> num_vec) {
+  return SPIRVOperand(LITERAL_INTEGER, num_vec);
 }
-SPIRVOperand* MkInteger(ArrayRef<uint32_t> num_vec) {
-  return new SPIRVOperand(LITERAL_INTEGER, num_vec);
+SPIRVOperand MkFloat(ArrayRef<uint32_t> num_vec) {
+  return SPIRVOperand(LITERAL_FLOAT, num_vec);
 }
-SPIRVOperand* MkFloat(ArrayRef<uint32_t> num_vec) {
-  return new SPIRVOperand(LITERAL_FLOAT, num_vec);
+SPIRVOperand MkHalf(uint32_t num) {
+  return SPIRVOperand(LITERAL_HALF, num);
 }
-SPIRVOperand* MkId(uint32_t id) {
-  return new SPIRVOperand(NUMBERID, id);
+SPIRVOperand MkId(uint32_t id) {
+  return SPIRVOperand(NUMBERID, id);
 }
-SPIRVOperand* MkString(StringRef str) {
-  return new SPIRVOperand(LITERAL_STRING, str);
+SPIRVOperand MkString(StringRef str) {
+  return SPIRVOperand(LITERAL_STRING, str);
+}
+
+// Returns the grammar of the given opcode, which must be in the SPIR-V core
+// grammar.
+const grammar::Instruction &GetGrammar(uint16_t Opcode) {
+  const grammar::Instruction *Grammar = grammar::getInstruction(Opcode);
+  if (!Grammar) {
+    errs() << "Unsupported SPIR-V instruction opcode " << Opcode << "\n";
+    llvm_unreachable("Unsupported SPIRV instruction");
+  }
+  return *Grammar;
+}
+
+// Returns true if a value of type Ty holds a scalar of the given bit width,
+// directly or in a vector, array or struct.
+bool ContainsScalarOfWidth(Type *Ty, unsigned Width) {
+  if (auto *STy = dyn_cast<StructType>(Ty)) {
+    return any_of(STy->elements(), [Width](Type *ElemTy) {
+      return ContainsScalarOfWidth(ElemTy, Width);
+    });
+  }
+  if (isa<ArrayType>(Ty) || isa<VectorType>(Ty)) {
+    return ContainsScalarOfWidth(Ty->getSequentialElementType(), Width);
+  }
+  return (Ty->isIntegerTy() || Ty->isFloatingPointTy()) &&
+         Ty->getPrimitiveSizeInBits() == Width;
 }
 
 struct SPIRVInstruction {
   // Create an instruction with an opcode and no result ID, and with the given
   // operands.  This computes its own word count.
-  explicit SPIRVInstruction(spv::Op Opc, ArrayRef<SPIRVOperand *> Ops)
-      : WordCount(1), Opcode(static_cast<uint16_t>(Opc)), ResultID(0),
-        Operands(Ops.begin(), Ops.end()) {
-    for (auto *operand : Ops) {
-      WordCount += operand->GetNumWords();
-    }
+  explicit SPIRVInstruction(spv::Op Opc, ArrayRef<SPIRVOperand> Ops)
+      : WordCount(1), Opcode(static_cast<uint16_t>(Opc)), ResultID(0) {
+    Encode(Ops);
   }
   // Create an instruction with an opcode and a no-zero result ID, and
   // with the given operands.  This computes its own word count.
   explicit SPIRVInstruction(spv::Op Opc, uint32_t ResID,
-                            ArrayRef<SPIRVOperand *> Ops)
-      : WordCount(2), Opcode(static_cast<uint16_t>(Opc)), ResultID(ResID),
-        Operands(Ops.begin(), Ops.end()) {
+                            ArrayRef<SPIRVOperand> Ops)
+      : WordCount(2), Opcode(static_cast<uint16_t>(Opc)), ResultID(ResID) {
     if (ResID == 0) {
       llvm_unreachable("Result ID of 0 was provided");
     }
-    for (auto *operand : Ops) {
-      WordCount += operand->GetNumWords();
-    }
+    Encode(Ops);
   }
 
   uint16_t getWordCount() const { return WordCount; }
   uint16_t getOpcode() const { return Opcode; }
   uint32_t getResultID() const { return ResultID; }
-  ArrayRef<SPIRVOperand *> getOperands() const { return Operands; }
+  // Returns the binary encoding of the whole instruction.
+  ArrayRef<uint32_t> getWords() const { return {Words, WordCount}; }
+  // Returns the operands of the instruction, decoded from its words.
+  SPIRVOperandList getOperands() const;
+  // Replaces the result ID and each ID operand of the instruction with what
+  // |Renumber| maps it to.
+  void RenumberIDs(function_ref<uint32_t(uint32_t)> Renumber);
+
+  // Instructions are allocated from the arena of the running producer pass.
+  static void *operator new(size_t Size);
+  static void operator delete(void *) {}
 
 private:
+  // Allocates and fills in Words and Tags.  WordCount must only account for
+  // the opcode and result ID at this point.
+  void Encode(ArrayRef<SPIRVOperand> Ops);
+
+  // The type and size of one operand within Words.
+  struct OperandTag {
+    SPIRVOperandType Type;
+    uint16_t NumWords;
+  };
+
   uint16_t WordCount;
   uint16_t Opcode;
   uint32_t ResultID;
-  SmallVector<SPIRVOperand *, 4> Operands;
+  // The index of the result ID within Words, or 0 if there is none.
+  uint16_t ResultIDIndex;
+  uint16_t NumOperands;
+  uint32_t *Words;
+  OperandTag *Tags;
+};
+
+// Storage for all the instructions generated for a module.  It is released
+// in one go once the module has been written out.
+struct SPIRVArena {
+  SpecificBumpPtrAllocator<SPIRVInstruction> Instructions;
+  // The words and operand tags of the instructions.
+  BumpPtrAllocator Words;
+};
+
+// The arena of the producer pass running on this thread, if any.  Several
+// modules may be compiled concurrently, each on its own thread.
+thread_local SPIRVArena *CurrentArena = nullptr;
+
+void *SPIRVInstruction::operator new(size_t Size) {
+  assert(CurrentArena && Size == sizeof(SPIRVInstruction));
+  (void)Size;
+  return CurrentArena->Instructions.Allocate();
+}
+
+void SPIRVInstruction::Encode(ArrayRef<SPIRVOperand> Ops) {
+  for (const auto &operand : Ops) {
+    WordCount += operand.GetNumWords();
+  }
+  NumOperands = static_cast<uint16_t>(Ops.size());
+  Words = CurrentArena->Words.Allocate<uint32_t>(WordCount);
+  Tags = CurrentArena->Words.Allocate<OperandTag>(NumOperands);
+
+  // This also rejects opcodes we would not know how to write.
+  const grammar::Instruction &Grammar = GetGrammar(Opcode);
+  ResultIDIndex = 0;
+  if (ResultID) {
+    ResultIDIndex = Grammar.HasResultType && !Ops.empty() ? 2 : 1;
+  }
+
+  Words[0] = (uint32_t(WordCount) << 16) | Opcode;
+  uint32_t *Next = Words + 1;
+  for (unsigned i = 0; i < NumOperands; i++) {
+    if (Next == Words + ResultIDIndex) {
+      *Next++ = ResultID;
+    }
+    ArrayRef<uint32_t> OperandWords = Ops[i].getWords();
+    Next = std::copy(OperandWords.begin(), OperandWords.end(), Next);
+    Tags[i] = {Ops[i].getType(), static_cast<uint16_t>(OperandWords.size())};
+  }
+  if (Next == Words + ResultIDIndex) {
+    *Next++ = ResultID;
+  }
+  assert(Next == Words + WordCount);
+}
+
+SPIRVOperandList SPIRVInstruction::getOperands() const {
+  SPIRVOperandList Ops;
+  const uint32_t *Next = Words + 1;
+  for (unsigned i = 0; i < NumOperands; i++) {
+    if (Next == Words + ResultIDIndex) {
+      ++Next;
+    }
+    Ops << SPIRVOperand(Tags[i].Type, makeArrayRef(Next, Tags[i].NumWords));
+    Next += Tags[i].NumWords;
+  }
+  return Ops;
+}
+
+void SPIRVInstruction::RenumberIDs(function_ref<uint32_t(uint32_t)> Renumber) {
+  uint32_t *Next = Words + 1;
+  for (unsigned i = 0; i < NumOperands; i++) {
+    if (Next == Words + ResultIDIndex) {
+      ++Next;
+    }
+    if (Tags[i].Type == NUMBERID) {
+      *Next = Renumber(*Next);
+    }
+    Next += Tags[i].NumWords;
+  }
+  if (ResultID) {
+    ResultID = Renumber(ResultID);
+    Words[ResultIDIndex] = ResultID;
+  }
+}
+
+// IDs allocated while generating a function body are numbered from here, and
+// renumbered after those of the functions before it once it is merged into
+// the module.
+const uint32_t kFirstLocalID = 0x80000000;
+
+// The sections of a SPIR-V module, in the order of its logical layout.
+enum SPIRVSection {
+  kCapabilities,
+  kExtensions,
+  kImports,
+  kMemoryModel,
+  kEntryPoints,
+  kExecutionModes,
+  kDebug,
+  kAnnotations,
+  // Types, constants and global variables.
+  kTypes,
+  kFunctions,
+
+  kSectionCount
 };
 
 struct SPIRVProducerPass final : public ModulePass {
   typedef DenseMap<Type *, uint32_t> TypeMapType;
   typedef UniqueVector<Type *> TypeList;
   typedef DenseMap<Value *, uint32_t> ValueMapType;
+  // Maps an LLVM value to its SPIR-V ID.  A function body's map is layered
+  // over the module's: lookups that miss fall through to the module's map,
+  // which is only read, and everything else stays in the function's map.
+  class LayeredValueMap {
+  public:
+    explicit LayeredValueMap(const LayeredValueMap *Parent = nullptr)
+        : Parent(Parent) {}
+
+    uint32_t &operator[](Value *V) {
+      auto Found = Map.find(V);
+      if (Found != Map.end()) {
+        return Found->second;
+      }
+      return Map[V] = Parent ? Parent->lookup(V) : 0;
+    }
+    uint32_t lookup(Value *V) const {
+      auto Found = Map.find(V);
+      if (Found != Map.end()) {
+        return Found->second;
+      }
+      return Parent ? Parent->lookup(V) : 0;
+    }
+    size_t count(Value *V) const {
+      return Map.count(V) || (Parent && Parent->count(V));
+    }
+    // The entries of this map itself, without those of its parent.
+    const ValueMapType &local() const { return Map; }
+
+  private:
+    const LayeredValueMap *Parent;
+    ValueMapType Map;
+  };
   typedef UniqueVector<Value *> ValueList;
   typedef std::vector<std::pair<Value *, uint32_t>> EntryPointVecType;
-  typedef std::list<SPIRVInstruction *> SPIRVInstructionList;
+  typedef std::vector<SPIRVInstruction *> SPIRVInstructionList;
   // A vector of tuples, each of which is:
   // - the LLVM instruction that we will later generate SPIR-V code for
-  // - where the SPIR-V instruction should be inserted
+  // - the index in the function section before which the SPIR-V instruction
+  //   should be inserted
   // - the result ID of the SPIR-V instruction
-  typedef std::vector<
-      std::tuple<Value *, SPIRVInstructionList::iterator, uint32_t>>
+  typedef std::vector<std::tuple<Value *, size_t, uint32_t>>
       DeferredInstVecType;
   typedef DenseMap<FunctionType *, std::pair<FunctionType *, uint32_t>>
       GlobalConstFuncMapType;
@@ -214,13 +399,14 @@ struct SPIRVProducerPass final : public ModulePass {
       ArrayRef<std::pair<unsigned, std::string>> samplerMap, bool outputAsm,
       bool outputCInitList)
       : ModulePass(ID), samplerMap(samplerMap), out(out),
-        binaryTempOut(binaryTempUnderlyingVector), binaryOut(&out),
         descriptorMapOut(descriptor_map_out), outputAsm(outputAsm),
-        outputCInitList(outputCInitList), patchBoundOffset(0), nextID(1),
+        outputCInitList(outputCInitList), nextID(1),
         OpExtInstImportID(0), HasVariablePointers(false), SamplerTy(nullptr),
         WorkgroupSizeValueID(0), WorkgroupSizeVarID(0),
         NextDescriptorSetIndex(0), constant_i32_zero_id_(0) {}
 
+  StringRef getPassName() const override { return "SPIR-V Producer"; }
+
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequired<DominatorTreeWrapperPass>();
     AU.addRequired<LoopInfoWrapperPass>();
@@ -228,12 +414,9 @@ struct SPIRVProducerPass final : public ModulePass {
 
   virtual bool runOnModule(Module &module) override;
 
-  // output the SPIR-V header block
+  // output the SPIR-V header block, once all IDs have been allocated
   void outputHeader();
 
-  // patch the SPIR-V header block
-  void patchHeader();
-
   uint32_t lookupType(Type *Ty) {
     if (Ty->isPointerTy() &&
         (Ty->getPointerAddressSpace() != AddressSpace::UniformConstant)) {
@@ -244,28 +427,61 @@ struct SPIRVProducerPass final : public ModulePass {
       }
     }
 
-    if (0 == TypeMap.count(Ty)) {
+    auto Found = TypeMap.find(Ty);
+    if (Found == TypeMap.end()) {
       Ty->print(errs());
-      llvm_unreachable("\nUnhandled type!");
+      report_fatal_error("\nUnhandled type!");
     }
 
-    return TypeMap[Ty];
+    return Found->second;
+  }
+  // Function bodies may be generated concurrently, so they must not add
+  // types or constants to the LLVM context.  Getting one that already exists
+  // only reads the context, and the types and constants that were generated
+  // beforehand exist.  So a function body looks up the ID of a constant it
+  // gets with this, which checks that it was generated beforehand, and that
+  // of a type with lookupType, which does the same.
+  uint32_t lookupConstant(Constant *C) {
+    const uint32_t ID = ValueMap.lookup(C);
+    if (!ID) {
+      report_fatal_error("Constant was not generated before the function "
+                         "bodies");
+    }
+    return ID;
   }
   TypeMapType &getImageTypeMap() { return ImageTypeMap; }
   TypeList &getTypeList() { return Types; };
   ValueList &getConstantList() { return Constants; };
-  ValueMapType &getValueMap() { return ValueMap; }
+  LayeredValueMap &getValueMap() {
+    return CurrentFunction ? CurrentFunction->ValueMap : ValueMap;
+  }
   ValueMapType &getAllocatedValueMap() { return AllocatedValueMap; }
-  SPIRVInstructionList &getSPIRVInstList() { return SPIRVInsts; };
+  SPIRVInstructionList &getSPIRVInstList(SPIRVSection Section) {
+    if (CurrentFunction) {
+      // Other threads may be generating function bodies too, so a body must
+      // not add to the module sections.
+      if (Section != kFunctions) {
+        report_fatal_error("A function body added an instruction outside the "
+                           "function section");
+      }
+      return CurrentFunction->Instructions;
+    }
+    return SPIRVSections[Section];
+  };
   ValueToValueMapTy &getArgumentGVMap() { return ArgumentGVMap; };
   ValueMapType &getArgumentGVIDMap() { return ArgumentGVIDMap; };
   EntryPointVecType &getEntryPointVec() { return EntryPointVec; };
-  DeferredInstVecType &getDeferredInstVec() { return DeferredInstVec; };
+  DeferredInstVecType &getDeferredInstVec() {
+    return CurrentFunction ? CurrentFunction->DeferredInsts : DeferredInstVec;
+  };
   ValueList &getEntryPointInterfacesVec() { return EntryPointInterfacesVec; };
   uint32_t &getOpExtInstImportID() { return OpExtInstImportID; };
   std::vector<uint32_t> &getBuiltinDimVec() { return BuiltinDimensionVec; };
   bool hasVariablePointers() { return true; /* We use StorageBuffer everywhere */ };
-  void setVariablePointers(bool Val) { HasVariablePointers = Val; };
+  void setVariablePointers(bool Val) {
+    (CurrentFunction ? CurrentFunction->HasVariablePointers
+                     : HasVariablePointers) = Val;
+  };
   ArrayRef<std::pair<unsigned, std::string>> &getSamplerMap() { return samplerMap; }
   GlobalConstFuncMapType &getGlobalConstFuncTypeMap() {
     return GlobalConstFuncTypeMap;
@@ -274,7 +490,13 @@ struct SPIRVProducerPass final : public ModulePass {
     return GlobalConstArgumentSet;
   }
   TypeList &getTypesNeedingArrayStride() {
-    return TypesNeedingArrayStride;
+    return CurrentFunction ? CurrentFunction->TypesNeedingArrayStride
+                           : TypesNeedingArrayStride;
+  }
+  // Returns the next ID to allocate.  Within a function body this is a local
+  // ID.
+  uint32_t &NextID() {
+    return CurrentFunction ? CurrentFunction->NextID : nextID;
   }
 
   void GenerateLLVMIRInfo(Module &M, const DataLayout &DL);
@@ -299,6 +521,17 @@ struct SPIRVProducerPass final : public ModulePass {
   void GenerateGlobalVar(GlobalVariable &GV);
   void GenerateWorkgroupVars();
   void GenerateSamplers(Module &M);
+  // Generates what the rest of the module needs from |F| before function
+  // bodies are generated: the descriptor map entries and decorations of
+  // kernel arguments, and the parameters that point to global constants.
+  void GenerateFuncInterface(Function &F);
+  // Generates the instructions of |F| into |State|, which may happen on any
+  // thread, concurrently with other functions.
+  struct FunctionState;
+  void GenerateFunction(Function &F, FunctionState &State);
+  // Adds the instructions of |F| generated into |State| to the module,
+  // renumbering its local IDs after those allocated so far.
+  void MergeFunction(Function &F, FunctionState &State);
   void GenerateFuncPrologue(Function &F);
   void GenerateFuncBody(Function &F);
   void GenerateInstForArg(Function &F);
@@ -309,6 +542,9 @@ struct SPIRVProducerPass final : public ModulePass {
   void GenerateInstruction(Instruction &I);
   void GenerateFuncEpilogue();
   void HandleDeferredInstruction();
+  // Returns the structured control flow of |F|, which is computed the first
+  // time it is asked for.
+  const StructuredControlFlow &getStructuredControlFlow(Function &F);
   void HandleDeferredDecorations(const DataLayout& DL);
   bool is4xi8vec(Type *Ty) const;
   // Return the SPIR-V Id for 32-bit constant zero.  The constant must already
@@ -327,54 +563,23 @@ struct SPIRVProducerPass final : public ModulePass {
   // Returns the single GLSL extended instruction used directly or
   // indirectly by the given function call.
   glsl::ExtInst getDirectOrIndirectExtInstEnum(StringRef Name);
-  void PrintResID(SPIRVInstruction *Inst);
-  void PrintOpcode(SPIRVInstruction *Inst);
-  void PrintOperand(SPIRVOperand *Op);
-  void PrintCapability(SPIRVOperand *Op);
-  void PrintExtInst(SPIRVOperand *Op);
-  void PrintAddrModel(SPIRVOperand *Op);
-  void PrintMemModel(SPIRVOperand *Op);
-  void PrintExecModel(SPIRVOperand *Op);
-  void PrintExecMode(SPIRVOperand *Op);
-  void PrintSourceLanguage(SPIRVOperand *Op);
-  void PrintFuncCtrl(SPIRVOperand *Op);
-  void PrintStorageClass(SPIRVOperand *Op);
-  void PrintDecoration(SPIRVOperand *Op);
-  void PrintBuiltIn(SPIRVOperand *Op);
-  void PrintSelectionControl(SPIRVOperand *Op);
-  void PrintLoopControl(SPIRVOperand *Op);
-  void PrintDimensionality(SPIRVOperand *Op);
-  void PrintImageFormat(SPIRVOperand *Op);
-  void PrintMemoryAccess(SPIRVOperand *Op);
-  void PrintImageOperandsType(SPIRVOperand *Op);
+  // Prints an operand the grammar says is of the given kind, or of no
+  // particular kind if it is OperandKindNone.
+  void PrintOperand(grammar::OperandKind Kind, const SPIRVOperand &Op);
+  void PrintEnumerant(grammar::OperandKind Kind, uint32_t Value);
   void WriteSPIRVAssembly();
-  void WriteOneWord(uint32_t Word);
-  void WriteResultID(SPIRVInstruction *Inst);
-  void WriteWordCountAndOpcode(SPIRVInstruction *Inst);
-  void WriteOperand(SPIRVOperand *Op);
   void WriteSPIRVBinary();
+  // Writes |Words| in binary, or as more of the C initializer list.
+  void WriteWords(ArrayRef<uint32_t> Words);
 
 private:
   static char ID;
   ArrayRef<std::pair<unsigned, std::string>> samplerMap;
+  // The module is written straight to this stream, which buffers it.
   raw_pwrite_stream &out;
-
-  // TODO(dneto): Wouldn't it be better to always just emit a binary, and then
-  // convert to other formats on demand?
-
-  // When emitting a C initialization list, the WriteSPIRVBinary method
-  // will actually write its words to this vector via binaryTempOut.
-  SmallVector<char, 100> binaryTempUnderlyingVector;
-  raw_svector_ostream binaryTempOut;
-
-  // Binary output writes to this stream, which might be |out| or
-  // |binaryTempOut|.  It's the latter when we really want to write a C
-  // initializer list.
-  raw_pwrite_stream* binaryOut;
   raw_ostream &descriptorMapOut;
   const bool outputAsm;
   const bool outputCInitList; // If true, output look like {0x7023, ... , 5}
-  uint64_t patchBoundOffset;
   uint32_t nextID;
 
   // Maps an LLVM Value pointer to the corresponding SPIR-V Id.
@@ -385,15 +590,22 @@ private:
   TypeList Types;
   ValueList Constants;
   // Maps an LLVM Value pointer to the corresponding SPIR-V Id.
-  ValueMapType ValueMap;
+  LayeredValueMap ValueMap;
   ValueMapType AllocatedValueMap;
-  SPIRVInstructionList SPIRVInsts;
+  // Owns everything in SPIRVSections while runOnModule is running.
+  SPIRVArena Arena;
+  // The instructions of each section of the module.  They are written out
+  // one section after the other.
+  SPIRVInstructionList SPIRVSections[kSectionCount];
   // Maps a kernel argument value to a global value.  OpenCL kernel arguments
   // have to map to resources: buffers, samplers, images, or sampled images.
   ValueToValueMapTy ArgumentGVMap;
   ValueMapType ArgumentGVIDMap;
   EntryPointVecType EntryPointVec;
   DeferredInstVecType DeferredInstVec;
+  // The structured control flow of each function with a deferred branch.
+  DenseMap<Function *, std::unique_ptr<StructuredControlFlow>>
+      StructuredControlFlows;
   ValueList EntryPointInterfacesVec;
   uint32_t OpExtInstImportID;
   std::vector<uint32_t> BuiltinDimensionVec;
@@ -464,8 +676,35 @@ private:
   // The ID of 32-bit integer zero constant.  This is only valid after
   // GenerateSPIRVConstants has run.
   uint32_t constant_i32_zero_id_;
+
+public:
+  // What generating one function body changes, kept apart from the module
+  // so that function bodies can be generated concurrently.  The types and
+  // constants are all generated beforehand, so a function body only looks
+  // them up, and neither the module nor the LLVM context are modified.
+  struct FunctionState {
+    // The next local ID to allocate.
+    uint32_t NextID = kFirstLocalID;
+    // Layered over the module's value map.  The function's values are
+    // added to it with local IDs.
+    LayeredValueMap ValueMap;
+    SPIRVInstructionList Instructions;
+    // Indices are within Instructions.
+    DeferredInstVecType DeferredInsts;
+    TypeList TypesNeedingArrayStride;
+    bool HasVariablePointers = false;
+    // Owns Instructions until the module has been written.
+    SPIRVArena Arena;
+  };
+
+private:
+  // The state of the function body being generated on this thread, if any.
+  static thread_local FunctionState *CurrentFunction;
 };
 
+thread_local SPIRVProducerPass::FunctionState
+    *SPIRVProducerPass::CurrentFunction = nullptr;
+
 char SPIRVProducerPass::ID;
 
 }
@@ -481,19 +720,20 @@ createSPIRVProducerPass(raw_pwrite_stream &out, raw_ostream &descriptor_map_out,
 } // namespace clspv
 
 bool SPIRVProducerPass::runOnModule(Module &module) {
-  binaryOut = outputCInitList ? &binaryTempOut : &out;
+  // Instructions created below are allocated from our arena.
+  CurrentArena = &Arena;
 
   constant_i32_zero_id_ = 0; // Reset, for the benefit of validity checks.
 
   ArgSpecIdMap = AllocateArgSpecIds(module);
 
-  // SPIR-V always begins with its header information
-  outputHeader();
-
   const DataLayout &DL = module.getDataLayout();
 
   // Gather information from the LLVM IR that we require.
-  GenerateLLVMIRInfo(module, DL);
+  {
+    TimeTraceScope scope("GenerateLLVMIRInfo");
+    GenerateLLVMIRInfo(module, DL);
+  }
 
   // If we are using a sampler map, find the type of the sampler.
   if (0 < getSamplerMap().size()) {
@@ -542,10 +782,16 @@ bool SPIRVProducerPass::runOnModule(Module &module) {
   }
 
   // Generate SPIRV instructions for types.
-  GenerateSPIRVTypes(module.getContext(), DL);
+  {
+    TimeTraceScope scope("GenerateSPIRVTypes");
+    GenerateSPIRVTypes(module.getContext(), DL);
+  }
 
   // Generate SPIRV constants.
-  GenerateSPIRVConstants();
+  {
+    TimeTraceScope scope("GenerateSPIRVConstants");
+    GenerateSPIRVConstants();
+  }
 
   // If we have a sampler map, we might have literal samplers to generate.
   if (0 < getSamplerMap().size()) {
@@ -558,61 +804,87 @@ bool SPIRVProducerPass::runOnModule(Module &module) {
   }
   GenerateWorkgroupVars();
 
-  // Generate SPIRV instructions for each function.
+  // Generate SPIRV instructions for each function.  Each is generated with
+  // its own local IDs, possibly on several threads, and then merged in
+  // order, so the module is the same however many threads are used.
+  std::vector<Function *> Functions;
   for (Function &F : module) {
     if (F.isDeclaration()) {
       continue;
     }
+    GenerateFuncInterface(F);
+    Functions.push_back(&F);
+  }
 
-    // Generate Function Prologue.
-    GenerateFuncPrologue(F);
+  std::vector<std::unique_ptr<FunctionState>> States;
+  for (size_t i = 0; i < Functions.size(); i++) {
+    States.emplace_back(new FunctionState);
+  }
 
-    // Generate SPIRV instructions for function body.
-    GenerateFuncBody(F);
+  const unsigned Threads = clspv::Option::SPIRVThreads()
+                               ? clspv::Option::SPIRVThreads()
+                               : heavyweight_hardware_concurrency();
+  if (Threads <= 1 || Functions.size() <= 1) {
+    for (size_t i = 0; i < Functions.size(); i++) {
+      GenerateFunction(*Functions[i], *States[i]);
+    }
+  } else {
+    TimeTraceScope scope("GenerateFunctions");
+    // The worker threads compile with the options of this thread, and record
+    // their spans to its trace.
+    const auto *Options = clspv::Option::ScopedValues::Current();
+    TimeTrace *Trace = TimeTrace::Current();
+    ThreadPool Pool(std::min<size_t>(Threads, Functions.size()));
+    for (size_t i = 0; i < Functions.size(); i++) {
+      Function *F = Functions[i];
+      FunctionState *State = States[i].get();
+      Pool.async([this, Options, Trace, F, State]() {
+        clspv::Option::ScopedValues ScopedOptions(Options);
+        TimeTrace::ScopedCurrent ScopedTrace(Trace);
+        GenerateFunction(*F, *State);
+      });
+    }
+    Pool.wait();
+  }
 
-    // Generate Function Epilogue.
-    GenerateFuncEpilogue();
+  for (size_t i = 0; i < Functions.size(); i++) {
+    MergeFunction(*Functions[i], *States[i]);
   }
 
-  HandleDeferredInstruction();
+  {
+    TimeTraceScope scope("HandleDeferredInstruction");
+    HandleDeferredInstruction();
+  }
   HandleDeferredDecorations(DL);
 
   // Generate SPIRV module information.
   GenerateModuleInfo(module);
 
-  if (outputAsm) {
-    WriteSPIRVAssembly();
-  } else {
-    WriteSPIRVBinary();
-  }
+  {
+    TimeTraceScope scope("WriteSPIRV");
 
-  // We need to patch the SPIR-V header to set bound correctly.
-  patchHeader();
+    // SPIR-V always begins with its header information.  Every ID has been
+    // allocated by now, so the bound is final.
+    outputHeader();
 
-  if (outputCInitList) {
-    bool first = true;
-    std::ostringstream os;
-
-    auto emit_word = [&os, &first](uint32_t word) {
-      if (!first)
-        os << ",\n";
-      os << word;
-      first = false;
-    };
-
-    os << "{";
-    const std::string str(binaryTempOut.str());
-    for (unsigned i = 0; i < str.size(); i += 4) {
-      const uint32_t a = static_cast<unsigned char>(str[i]);
-      const uint32_t b = static_cast<unsigned char>(str[i + 1]);
-      const uint32_t c = static_cast<unsigned char>(str[i + 2]);
-      const uint32_t d = static_cast<unsigned char>(str[i + 3]);
-      emit_word(a | (b << 8) | (c << 16) | (d << 24));
+    if (outputAsm) {
+      WriteSPIRVAssembly();
+    } else {
+      WriteSPIRVBinary();
     }
-    os << "}\n";
-    out << os.str();
   }
 
+  // The module has been written, so release all its instructions at once.
+  DeferredInstVec.clear();
+  StructuredControlFlows.clear();
+  for (auto &Section : SPIRVSections) {
+    Section.clear();
+  }
+  States.clear();
+  Arena.Instructions.DestroyAll();
+  Arena.Words.Reset();
+  CurrentArena = nullptr;
+
   return false;
 }
 
@@ -623,61 +895,33 @@ void SPIRVProducerPass::outputHeader() {
     out << "; SPIR-V\n";
 
     // the major version number is in the 2nd highest byte
-    const uint32_t major = (spv::Version >> 16) & 0xFF;
+    const uint32_t major = (kSPIRVVersion >> 16) & 0xFF;
 
     // the minor version number is in the 2nd lowest byte
-    const uint32_t minor = (spv::Version >> 8) & 0xFF;
+    const uint32_t minor = (kSPIRVVersion >> 8) & 0xFF;
     out << "; Version: " << major << "." << minor << "\n";
 
     // use Codeplay's vendor ID
     out << "; Generator: Codeplay; 0\n";
 
-    out << "; Bound: ";
-
-    // we record where we need to come back to and patch in the bound value
-    patchBoundOffset = out.tell();
-
-    // output one space per digit for the max size of a 32 bit unsigned integer
-    // (which is the maximum ID we could possibly be using)
-    for (uint32_t i = std::numeric_limits<uint32_t>::max(); 0 != i; i /= 10) {
-      out << " ";
-    }
-
-    out << "\n";
+    // nextID is one more than the largest ID used
+    out << "; Bound: " << nextID << "\n";
 
     out << "; Schema: 0\n";
   } else {
-    binaryOut->write(reinterpret_cast<const char *>(&spv::MagicNumber),
-              sizeof(spv::MagicNumber));
-    binaryOut->write(reinterpret_cast<const char *>(&spv::Version),
-              sizeof(spv::Version));
-
     // use Codeplay's vendor ID
     const uint32_t vendor = 3 << 16;
-    binaryOut->write(reinterpret_cast<const char *>(&vendor), sizeof(vendor));
 
-    // we record where we need to come back to and patch in the bound value
-    patchBoundOffset = binaryOut->tell();
+    // the schema is reserved for use and must be 0
+    const uint32_t header[] = {spv::MagicNumber, kSPIRVVersion, vendor, nextID,
+                               0};
 
-    // output a bad bound for now
-    binaryOut->write(reinterpret_cast<const char *>(&nextID), sizeof(nextID));
-
-    // output the schema (reserved for use and must be 0)
-    const uint32_t schema = 0;
-    binaryOut->write(reinterpret_cast<const char *>(&schema), sizeof(schema));
-  }
-}
-
-void SPIRVProducerPass::patchHeader() {
-  if (outputAsm) {
-    // get the string representation of the max bound used (nextID will be the
-    // max ID used)
-    auto asString = std::to_string(nextID);
-    out.pwrite(asString.c_str(), asString.size(), patchBoundOffset);
-  } else {
-    // for a binary we just write the value of nextID over bound
-    binaryOut->pwrite(reinterpret_cast<char *>(&nextID), sizeof(nextID),
-                      patchBoundOffset);
+    if (outputCInitList) {
+      out << "{" << header[0];
+      WriteWords(makeArrayRef(header).drop_front());
+    } else {
+      WriteWords(header);
+    }
   }
 }
 
@@ -1186,7 +1430,7 @@ bool SPIRVProducerPass::FindExtInst(Module &M) {
             case glsl::ExtInstAtan2:
               // We need 1/pi for acospi, asinpi, atan2pi.
               register_constant(
-                  ConstantFP::get(Type::getFloatTy(Context), kOneOverPi));
+                  ConstantFP::get(I.getType()->getScalarType(), kOneOverPi));
               break;
             default:
               assert(false && "internally inconsistent");
@@ -1583,7 +1827,7 @@ spv::BuiltIn SPIRVProducerPass::GetBuiltin(StringRef Name) const {
 }
 
 void SPIRVProducerPass::GenerateExtInstImport() {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kImports);
   uint32_t &ExtInstImportID = getOpExtInstImportID();
 
   //
@@ -1596,8 +1840,8 @@ void SPIRVProducerPass::GenerateExtInstImport() {
 }
 
 void SPIRVProducerPass::GenerateSPIRVTypes(LLVMContext& Context, const DataLayout &DL) {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-  ValueMapType &VMap = getValueMap();
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kTypes);
+  LayeredValueMap &VMap = getValueMap();
   ValueMapType &AllocatedVMap = getAllocatedValueMap();
   ValueToValueMapTy &ArgGVMap = getArgumentGVMap();
 
@@ -1711,14 +1955,7 @@ void SPIRVProducerPass::GenerateSPIRVTypes(LLVMContext& Context, const DataLayou
         SPIRVInstList.push_back(Inst);
 
         // Generate OpDecorate.
-        auto DecoInsertPoint =
-            std::find_if(SPIRVInstList.begin(), SPIRVInstList.end(),
-                         [](SPIRVInstruction *Inst) -> bool {
-                           return Inst->getOpcode() != spv::OpDecorate &&
-                                  Inst->getOpcode() != spv::OpMemberDecorate &&
-                                  Inst->getOpcode() != spv::OpExtInstImport;
-                         });
-
+        //
         // Ops[0] = Target ID
         // Ops[1] = Decoration (ArrayStride)
         // Ops[2] = Stride Number(Literal Number)
@@ -1728,7 +1965,7 @@ void SPIRVProducerPass::GenerateSPIRVTypes(LLVMContext& Context, const DataLayou
             << MkNum(static_cast<uint32_t>(DL.getTypeAllocSize(EleTy)));
 
         auto *DecoInst = new SPIRVInstruction(spv::OpDecorate, Ops);
-        SPIRVInstList.insert(DecoInsertPoint, DecoInst);
+        getSPIRVInstList(kAnnotations).push_back(DecoInst);
       }
       break;
     }
@@ -1840,14 +2077,6 @@ void SPIRVProducerPass::GenerateSPIRVTypes(LLVMContext& Context, const DataLayou
       SPIRVInstList.push_back(Inst);
 
       // Generate OpMemberDecorate.
-      auto DecoInsertPoint =
-          std::find_if(SPIRVInstList.begin(), SPIRVInstList.end(),
-                       [](SPIRVInstruction *Inst) -> bool {
-                         return Inst->getOpcode() != spv::OpDecorate &&
-                                Inst->getOpcode() != spv::OpMemberDecorate &&
-                                Inst->getOpcode() != spv::OpExtInstImport;
-                       });
-
       const auto StructLayout = DL.getStructLayout(STy);
 
       for (unsigned MemberIdx = 0; MemberIdx < STy->getNumElements();
@@ -1865,7 +2094,7 @@ void SPIRVProducerPass::GenerateSPIRVTypes(LLVMContext& Context, const DataLayou
         Ops << MkNum(ByteOffset);
 
         auto *DecoInst = new SPIRVInstruction(spv::OpMemberDecorate, Ops);
-        SPIRVInstList.insert(DecoInsertPoint, DecoInst);
+        getSPIRVInstList(kAnnotations).push_back(DecoInst);
       }
 
       // Generate OpDecorate.
@@ -1887,7 +2116,7 @@ void SPIRVProducerPass::GenerateSPIRVTypes(LLVMContext& Context, const DataLayou
           Ops << MkId(STyID) << MkNum(spv::DecorationBlock);
 
           auto *DecoInst = new SPIRVInstruction(spv::OpDecorate, Ops);
-          SPIRVInstList.insert(DecoInsertPoint, DecoInst);
+          getSPIRVInstList(kAnnotations).push_back(DecoInst);
           break;
         }
       }
@@ -1900,12 +2129,14 @@ void SPIRVProducerPass::GenerateSPIRVTypes(LLVMContext& Context, const DataLayou
         auto *Inst = new SPIRVInstruction(spv::OpTypeBool, nextID++, {});
         SPIRVInstList.push_back(Inst);
       } else {
-        // i8 is added to TypeMap as i32.
+        // Without 8-bit storage, i8 is added to TypeMap as i32.
         // No matter what LLVM type is requested first, always alias the
         // second one's SPIR-V type to be the same as the one we generated
         // first.
         unsigned aliasToWidth = 0;
-        if (BitWidth == 8) {
+        if (clspv::Option::F8BitStorage()) {
+          // i8 is a type of its own.
+        } else if (BitWidth == 8) {
           aliasToWidth = 32;
           BitWidth = 32;
         } else if (BitWidth == 32) {
@@ -1935,8 +2166,8 @@ void SPIRVProducerPass::GenerateSPIRVTypes(LLVMContext& Context, const DataLayou
     case Type::HalfTyID:
     case Type::FloatTyID:
     case Type::DoubleTyID: {
-      SPIRVOperand *WidthOp = new SPIRVOperand(
-          SPIRVOperandType::LITERAL_INTEGER, Ty->getPrimitiveSizeInBits());
+      SPIRVOperand WidthOp(SPIRVOperandType::LITERAL_INTEGER,
+                           Ty->getPrimitiveSizeInBits());
 
       SPIRVInstList.push_back(
           new SPIRVInstruction(spv::OpTypeFloat, nextID++, WidthOp));
@@ -1994,9 +2225,10 @@ void SPIRVProducerPass::GenerateSPIRVTypes(LLVMContext& Context, const DataLayou
       break;
     }
     case Type::VectorTyID: {
-      // <4 x i8> is changed to i32.
+      // Without 8-bit storage, <4 x i8> is changed to i32.
       LLVMContext &Context = Ty->getContext();
-      if (Ty->getVectorElementType() == Type::getInt8Ty(Context)) {
+      if (!clspv::Option::F8BitStorage() &&
+          Ty->getVectorElementType() == Type::getInt8Ty(Context)) {
         if (Ty->getVectorNumElements() == 4) {
           TypeMap[Ty] = lookupType(Ty->getVectorElementType());
           break;
@@ -2103,8 +2335,8 @@ void SPIRVProducerPass::GenerateSPIRVTypes(LLVMContext& Context, const DataLayou
 }
 
 void SPIRVProducerPass::GenerateSPIRVConstants() {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-  ValueMapType &VMap = getValueMap();
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kTypes);
+  LayeredValueMap &VMap = getValueMap();
   ValueMapType &AllocatedVMap = getAllocatedValueMap();
   ValueList &CstList = getConstantList();
   const bool hack_undef = clspv::Option::HackUndef();
@@ -2176,14 +2408,16 @@ void SPIRVProducerPass::GenerateSPIRVConstants() {
       Type *CFPTy = CFP->getType();
       if (CFPTy->isFloatTy()) {
         LiteralNum.push_back(FPVal & 0xFFFFFFFF);
+        Ops << MkFloat(LiteralNum);
+      } else if (CFPTy->isHalfTy()) {
+        // A 16-bit literal is in the low-order bits of its word.
+        Ops << MkHalf(FPVal & 0xFFFF);
       } else {
         CFPTy->print(errs());
         llvm_unreachable("Implement this ConstantFP Type");
       }
 
       Opcode = spv::OpConstant;
-
-      Ops << MkFloat(LiteralNum);
     } else if (isa<ConstantDataSequential>(Cst) &&
                cast<ConstantDataSequential>(Cst)->isString()) {
       Cst->print(errs());
@@ -2295,8 +2529,8 @@ void SPIRVProducerPass::GenerateSPIRVConstants() {
 }
 
 void SPIRVProducerPass::GenerateSamplers(Module &M) {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-  ValueMapType &VMap = getValueMap();
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kTypes);
+  LayeredValueMap &VMap = getValueMap();
 
   DenseMap<unsigned, unsigned> SamplerLiteralToIDMap;
 
@@ -2318,15 +2552,6 @@ void SPIRVProducerPass::GenerateSamplers(Module &M) {
 
     SamplerLiteralToIDMap[SamplerLiteral.first] = nextID++;
 
-    // Find Insert Point for OpDecorate.
-    auto DecoInsertPoint =
-        std::find_if(SPIRVInstList.begin(), SPIRVInstList.end(),
-                     [](SPIRVInstruction *Inst) -> bool {
-                       return Inst->getOpcode() != spv::OpDecorate &&
-                              Inst->getOpcode() != spv::OpMemberDecorate &&
-                              Inst->getOpcode() != spv::OpExtInstImport;
-                     });
-
     // Ops[0] = Target ID
     // Ops[1] = Decoration (DescriptorSet)
     // Ops[2] = LiteralNumber according to Decoration
@@ -2342,7 +2567,7 @@ void SPIRVProducerPass::GenerateSamplers(Module &M) {
                      << "\n";
 
     auto *DescDecoInst = new SPIRVInstruction(spv::OpDecorate, Ops);
-    SPIRVInstList.insert(DecoInsertPoint, DescDecoInst);
+    getSPIRVInstList(kAnnotations).push_back(DescDecoInst);
 
     // Ops[0] = Target ID
     // Ops[1] = Decoration (Binding)
@@ -2352,7 +2577,7 @@ void SPIRVProducerPass::GenerateSamplers(Module &M) {
     BindingIdx++;
 
     auto *BindDecoInst = new SPIRVInstruction(spv::OpDecorate, Ops);
-    SPIRVInstList.insert(DecoInsertPoint, BindDecoInst);
+    getSPIRVInstList(kAnnotations).push_back(BindDecoInst);
   }
   if (BindingIdx > 0) {
     // We generated something.
@@ -2394,8 +2619,8 @@ void SPIRVProducerPass::GenerateSamplers(Module &M) {
 }
 
 void SPIRVProducerPass::GenerateGlobalVar(GlobalVariable &GV) {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-  ValueMapType &VMap = getValueMap();
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kTypes);
+  LayeredValueMap &VMap = getValueMap();
   std::vector<uint32_t> &BuiltinDimVec = getBuiltinDimVec();
   const DataLayout &DL = GV.getParent()->getDataLayout();
 
@@ -2580,14 +2805,6 @@ void SPIRVProducerPass::GenerateGlobalVar(GlobalVariable &GV) {
 
   // If we have a builtin.
   if (spv::BuiltInMax != BuiltinType) {
-    // Find Insert Point for OpDecorate.
-    auto DecoInsertPoint =
-        std::find_if(SPIRVInstList.begin(), SPIRVInstList.end(),
-                     [](SPIRVInstruction *Inst) -> bool {
-                       return Inst->getOpcode() != spv::OpDecorate &&
-                              Inst->getOpcode() != spv::OpMemberDecorate &&
-                              Inst->getOpcode() != spv::OpExtInstImport;
-                     });
     //
     // Generate OpDecorate.
     //
@@ -2612,7 +2829,7 @@ void SPIRVProducerPass::GenerateGlobalVar(GlobalVariable &GV) {
          << MkNum(BuiltinType);
 
     auto *DescDecoInst = new SPIRVInstruction(spv::OpDecorate, DOps);
-    SPIRVInstList.insert(DecoInsertPoint, DescDecoInst);
+    getSPIRVInstList(kAnnotations).push_back(DescDecoInst);
   } else if (module_scope_constant_external_init) {
     // This module scope constant is initialized from a storage buffer with data
     // provided by the host at binding 0 of the next descriptor set.
@@ -2626,32 +2843,23 @@ void SPIRVProducerPass::GenerateGlobalVar(GlobalVariable &GV) {
     clspv::ConstantEmitter(DL, descriptorMapOut).Emit(GV.getInitializer());
     descriptorMapOut << "\n";
 
-    // Find Insert Point for OpDecorate.
-    auto DecoInsertPoint =
-        std::find_if(SPIRVInstList.begin(), SPIRVInstList.end(),
-                     [](SPIRVInstruction *Inst) -> bool {
-                       return Inst->getOpcode() != spv::OpDecorate &&
-                              Inst->getOpcode() != spv::OpMemberDecorate &&
-                              Inst->getOpcode() != spv::OpExtInstImport;
-                     });
-
-    // OpDecorate %var Binding <binding>
-    SPIRVOperandList DOps;
-    DOps << MkId(var_id) << MkNum(spv::DecorationBinding) << MkNum(0);
-    DecoInsertPoint = SPIRVInstList.insert(
-        DecoInsertPoint, new SPIRVInstruction(spv::OpDecorate, DOps));
-
     // OpDecorate %var DescriptorSet <descriptor_set>
-    DOps.clear();
+    SPIRVOperandList DOps;
     DOps << MkId(var_id) << MkNum(spv::DecorationDescriptorSet)
          << MkNum(descriptor_set);
-    SPIRVInstList.insert(DecoInsertPoint,
-                         new SPIRVInstruction(spv::OpDecorate, DOps));
+    getSPIRVInstList(kAnnotations)
+        .push_back(new SPIRVInstruction(spv::OpDecorate, DOps));
+
+    // OpDecorate %var Binding <binding>
+    DOps.clear();
+    DOps << MkId(var_id) << MkNum(spv::DecorationBinding) << MkNum(0);
+    getSPIRVInstList(kAnnotations)
+        .push_back(new SPIRVInstruction(spv::OpDecorate, DOps));
   }
 }
 
 void SPIRVProducerPass::GenerateWorkgroupVars() {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kTypes);
   for (auto* arg : LocalArgs) {
     const auto& info = LocalArgMap[arg];
 
@@ -2667,11 +2875,9 @@ void SPIRVProducerPass::GenerateWorkgroupVars() {
   }
 }
 
-void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
+void SPIRVProducerPass::GenerateFuncInterface(Function &F) {
   const DataLayout &DL = F.getParent()->getDataLayout();
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-  ValueMapType &VMap = getValueMap();
-  EntryPointVecType &EntryPoints = getEntryPointVec();
+  LayeredValueMap &VMap = getValueMap();
   ValueToValueMapTy &ArgGVMap = getArgumentGVMap();
   ValueMapType &ArgGVIDMap = getArgumentGVIDMap();
   auto &GlobalConstFuncTyMap = getGlobalConstFuncTypeMap();
@@ -2683,16 +2889,6 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
   // Generate OpVariable and OpDecorate for kernel function with arguments.
   //
   if (F.getCallingConv() == CallingConv::SPIR_KERNEL) {
-
-    // Find Insert Point for OpDecorate.
-    auto DecoInsertPoint =
-        std::find_if(SPIRVInstList.begin(), SPIRVInstList.end(),
-                     [](SPIRVInstruction *Inst) -> bool {
-                       return Inst->getOpcode() != spv::OpDecorate &&
-                              Inst->getOpcode() != spv::OpMemberDecorate &&
-                              Inst->getOpcode() != spv::OpExtInstImport;
-                     });
-
     const uint32_t DescriptorSetIdx = NextDescriptorSetIndex;
     if (clspv::Option::DistinctKernelDescriptorSets()) {
       ++NextDescriptorSetIndex;
@@ -2798,7 +2994,7 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
                 << MkNum(DescriptorSetIdx);
 
             auto *DescDecoInst = new SPIRVInstruction(spv::OpDecorate, Ops);
-            SPIRVInstList.insert(DecoInsertPoint, DescDecoInst);
+            getSPIRVInstList(kAnnotations).push_back(DescDecoInst);
 
             // Ops[0] = Target ID
             // Ops[1] = Decoration (Binding)
@@ -2808,7 +3004,7 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
                 << MkNum(BindingIdx);
 
             auto *BindDecoInst = new SPIRVInstruction(spv::OpDecorate, Ops);
-            SPIRVInstList.insert(DecoInsertPoint, BindDecoInst);
+            getSPIRVInstList(kAnnotations).push_back(BindDecoInst);
           }
 
           // Handle image type argument.
@@ -2842,7 +3038,7 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
                                               : spv::DecorationNonReadable);
 
             auto *DescDecoInst = new SPIRVInstruction(spv::OpDecorate, Ops);
-            SPIRVInstList.insert(DecoInsertPoint, DescDecoInst);
+            getSPIRVInstList(kAnnotations).push_back(DescDecoInst);
           }
 
           // Handle const address space.
@@ -2855,14 +3051,106 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
             Ops << MkId(ArgID) << MkNum(spv::DecorationNonWritable);
 
             auto *BindDecoInst = new SPIRVInstruction(spv::OpDecorate, Ops);
-            SPIRVInstList.insert(DecoInsertPoint, BindDecoInst);
+            getSPIRVInstList(kAnnotations).push_back(BindDecoInst);
           }
         }
         BindingIdx++;
       }
       arg_index++;
     }
+  } else if (GlobalConstFuncTyMap.count(FTy)) {
+    // Note the parameter that points to global constants.  It has the
+    // pointer-to-ModuleScopePrivate type of the function.
+    const unsigned ArgIdx = GlobalConstFuncTyMap[FTy].second;
+    for (Argument &Arg : F.args()) {
+      if (Arg.getArgNo() == ArgIdx && isa<PointerType>(Arg.getType())) {
+        GlobalConstArgSet.insert(&Arg);
+      }
+    }
   }
+}
+
+void SPIRVProducerPass::GenerateFunction(Function &F, FunctionState &State) {
+  TimeTraceScope scope("GenerateFuncBody", F.getName());
+
+  FunctionState *const PreviousFunction = CurrentFunction;
+  SPIRVArena *const PreviousArena = CurrentArena;
+  CurrentFunction = &State;
+  CurrentArena = &State.Arena;
+
+  State.ValueMap = LayeredValueMap(&ValueMap);
+
+  // Generate Function Prologue.
+  GenerateFuncPrologue(F);
+
+  // Generate SPIRV instructions for function body.
+  GenerateFuncBody(F);
+
+  // Generate Function Epilogue.
+  GenerateFuncEpilogue();
+
+  CurrentFunction = PreviousFunction;
+  CurrentArena = PreviousArena;
+}
+
+void SPIRVProducerPass::MergeFunction(Function &F, FunctionState &State) {
+  const uint32_t Base = nextID;
+  nextID += State.NextID - kFirstLocalID;
+  auto Renumber = [Base](uint32_t ID) {
+    return ID < kFirstLocalID ? ID : Base + (ID - kFirstLocalID);
+  };
+
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kFunctions);
+  const size_t Offset = SPIRVInstList.size();
+  for (auto *Inst : State.Instructions) {
+    Inst->RenumberIDs(Renumber);
+    SPIRVInstList.push_back(Inst);
+  }
+
+  for (auto &DeferredInst : State.DeferredInsts) {
+    DeferredInstVec.push_back(std::make_tuple(
+        std::get<0>(DeferredInst), Offset + std::get<1>(DeferredInst),
+        Renumber(std::get<2>(DeferredInst))));
+  }
+
+  // Only the function's own values were given IDs.
+  auto MergeValue = [&](Value *V) {
+    auto Found = State.ValueMap.local().find(V);
+    if (Found != State.ValueMap.local().end()) {
+      ValueMap[V] = Renumber(Found->second);
+    }
+  };
+  MergeValue(&F);
+  for (Argument &Arg : F.args()) {
+    MergeValue(&Arg);
+  }
+  for (BasicBlock &BB : F) {
+    MergeValue(&BB);
+    for (Instruction &I : BB) {
+      MergeValue(&I);
+    }
+  }
+
+  for (Type *Ty : State.TypesNeedingArrayStride) {
+    TypesNeedingArrayStride.insert(Ty);
+  }
+  HasVariablePointers |= State.HasVariablePointers;
+
+  if (F.getCallingConv() == CallingConv::SPIR_KERNEL) {
+    getEntryPointVec().push_back(std::make_pair(&F, ValueMap[&F]));
+  }
+
+  if (clspv::Option::ShowIDs()) {
+    errs() << "Function " << F.getName() << " is " << ValueMap[&F] << "\n";
+  }
+}
+
+void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kFunctions);
+  LayeredValueMap &VMap = getValueMap();
+  auto &GlobalConstFuncTyMap = getGlobalConstFuncTypeMap();
+
+  FunctionType *FTy = F.getFunctionType();
 
   //
   // Generate OPFunction.
@@ -2912,17 +3200,10 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
 
   FOps << MkId(FTyID);
 
-  if (F.getCallingConv() == CallingConv::SPIR_KERNEL) {
-    EntryPoints.push_back(std::make_pair(&F, nextID));
-  }
-
-  VMap[&F] = nextID;
+  VMap[&F] = NextID();
 
-  if (clspv::Option::ShowIDs()) {
-    errs() << "Function " << F.getName() << " is " << nextID << "\n";
-  }
   // Generate SPIRV instruction for function.
-  auto *FuncInst = new SPIRVInstruction(spv::OpFunction, nextID++, FOps);
+  auto *FuncInst = new SPIRVInstruction(spv::OpFunction, NextID()++, FOps);
   SPIRVInstList.push_back(FuncInst);
 
   //
@@ -2933,7 +3214,7 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
     // Iterate Argument for name instead of param type from function type.
     unsigned ArgIdx = 0;
     for (Argument &Arg : F.args()) {
-      VMap[&Arg] = nextID;
+      VMap[&Arg] = NextID();
 
       // ParamOps[0] : Result Type ID
       SPIRVOperandList ParamOps;
@@ -2947,7 +3228,6 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
             Type *ArgTy =
                 PointerType::get(EleTy, AddressSpace::ModuleScopePrivate);
             ParamTyID = lookupType(ArgTy);
-            GlobalConstArgSet.insert(&Arg);
           }
         }
       }
@@ -2955,7 +3235,7 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
 
       // Generate SPIRV instruction for parameter.
       auto *ParamInst =
-          new SPIRVInstruction(spv::OpFunctionParameter, nextID++, ParamOps);
+          new SPIRVInstruction(spv::OpFunctionParameter, NextID()++, ParamOps);
       SPIRVInstList.push_back(ParamInst);
 
       ArgIdx++;
@@ -2964,15 +3244,11 @@ void SPIRVProducerPass::GenerateFuncPrologue(Function &F) {
 }
 
 void SPIRVProducerPass::GenerateModuleInfo(Module& module) {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
   EntryPointVecType &EntryPoints = getEntryPointVec();
-  ValueMapType &VMap = getValueMap();
+  LayeredValueMap &VMap = getValueMap();
   ValueList &EntryPointInterfaces = getEntryPointInterfacesVec();
-  uint32_t &ExtInstImportID = getOpExtInstImportID();
   std::vector<uint32_t> &BuiltinDimVec = getBuiltinDimVec();
-
-  // Set up insert point.
-  auto InsertPoint = SPIRVInstList.begin();
+  SPIRVInstructionList &Capabilities = getSPIRVInstList(kCapabilities);
 
   //
   // Generate OpCapability
@@ -2984,45 +3260,96 @@ void SPIRVProducerPass::GenerateModuleInfo(Module& module) {
 
   auto *CapInst =
       new SPIRVInstruction(spv::OpCapability, {MkNum(spv::CapabilityShader)});
-  SPIRVInstList.insert(InsertPoint, CapInst);
+  Capabilities.push_back(CapInst);
+
+  // The storage classes of the buffers that 8-bit and 16-bit values are
+  // loaded from and stored to.  Each needs a capability of its own.
+  std::set<spv::StorageClass> StorageClassesOf8Bit;
+  std::set<spv::StorageClass> StorageClassesOf16Bit;
 
   for (Type *Ty : getTypeList()) {
-    // Find the i16 type.
-    if (Ty->isIntegerTy(16)) {
+    // Find the i8 type, which is only emitted with 8-bit storage.
+    if (Ty->isIntegerTy(8)) {
+      if (clspv::Option::F8BitStorage()) {
+        // Generate OpCapability for i8 type.
+        Capabilities.push_back(new SPIRVInstruction(
+            spv::OpCapability, {MkNum(spv::CapabilityInt8)}));
+      }
+    } else if (Ty->isIntegerTy(16)) {
       // Generate OpCapability for i16 type.
-      SPIRVInstList.insert(InsertPoint,
-                           new SPIRVInstruction(spv::OpCapability,
-                                                {MkNum(spv::CapabilityInt16)}));
+      Capabilities.push_back(new SPIRVInstruction(
+          spv::OpCapability, {MkNum(spv::CapabilityInt16)}));
     } else if (Ty->isIntegerTy(64)) {
       // Generate OpCapability for i64 type.
-      SPIRVInstList.insert(InsertPoint,
-                           new SPIRVInstruction(spv::OpCapability,
-                                                {MkNum(spv::CapabilityInt64)}));
+      Capabilities.push_back(new SPIRVInstruction(
+          spv::OpCapability, {MkNum(spv::CapabilityInt64)}));
     } else if (Ty->isHalfTy()) {
       // Generate OpCapability for half type.
-      SPIRVInstList.insert(
-          InsertPoint, new SPIRVInstruction(spv::OpCapability,
-                                            {MkNum(spv::CapabilityFloat16)}));
+      Capabilities.push_back(new SPIRVInstruction(
+          spv::OpCapability, {MkNum(spv::CapabilityFloat16)}));
     } else if (Ty->isDoubleTy()) {
       // Generate OpCapability for double type.
-      SPIRVInstList.insert(
-          InsertPoint, new SPIRVInstruction(spv::OpCapability,
-                                            {MkNum(spv::CapabilityFloat64)}));
+      Capabilities.push_back(new SPIRVInstruction(
+          spv::OpCapability, {MkNum(spv::CapabilityFloat64)}));
     } else if (auto *STy = dyn_cast<StructType>(Ty)) {
       if (STy->isOpaque()) {
         if (STy->getName().equals("opencl.image2d_wo_t") ||
             STy->getName().equals("opencl.image3d_wo_t")) {
           // Generate OpCapability for write only image type.
-          SPIRVInstList.insert(
-              InsertPoint,
-              new SPIRVInstruction(
-                  spv::OpCapability,
-                  {MkNum(spv::CapabilityStorageImageWriteWithoutFormat)}));
+          Capabilities.push_back(new SPIRVInstruction(
+              spv::OpCapability,
+              {MkNum(spv::CapabilityStorageImageWriteWithoutFormat)}));
         }
       }
+    } else if (auto *PTy = dyn_cast<PointerType>(Ty)) {
+      const spv::StorageClass StorageClass =
+          GetStorageClass(PTy->getAddressSpace());
+      if (StorageClass != spv::StorageClassStorageBuffer &&
+          StorageClass != spv::StorageClassUniform) {
+        continue;
+      }
+      if (clspv::Option::F8BitStorage() &&
+          ContainsScalarOfWidth(PTy->getElementType(), 8)) {
+        StorageClassesOf8Bit.insert(StorageClass);
+      }
+      if (clspv::Option::F16BitStorage() &&
+          ContainsScalarOfWidth(PTy->getElementType(), 16)) {
+        StorageClassesOf16Bit.insert(StorageClass);
+      }
     }
   }
 
+  // Generate OpCapability and OpExtension for loading and storing 8-bit and
+  // 16-bit types in buffers directly, rather than through 32-bit words.
+  // Storage buffers and uniform buffers each have their own capability.
+  if (!StorageClassesOf8Bit.empty()) {
+    if (StorageClassesOf8Bit.count(spv::StorageClassStorageBuffer)) {
+      Capabilities.push_back(new SPIRVInstruction(
+          spv::OpCapability,
+          {MkNum(spv::CapabilityStorageBuffer8BitAccess)}));
+    }
+    if (StorageClassesOf8Bit.count(spv::StorageClassUniform)) {
+      Capabilities.push_back(new SPIRVInstruction(
+          spv::OpCapability,
+          {MkNum(spv::CapabilityUniformAndStorageBuffer8BitAccess)}));
+    }
+    getSPIRVInstList(kExtensions).push_back(new SPIRVInstruction(
+        spv::OpExtension, {MkString("SPV_KHR_8bit_storage")}));
+  }
+  if (!StorageClassesOf16Bit.empty()) {
+    if (StorageClassesOf16Bit.count(spv::StorageClassStorageBuffer)) {
+      Capabilities.push_back(new SPIRVInstruction(
+          spv::OpCapability,
+          {MkNum(spv::CapabilityStorageBuffer16BitAccess)}));
+    }
+    if (StorageClassesOf16Bit.count(spv::StorageClassUniform)) {
+      Capabilities.push_back(new SPIRVInstruction(
+          spv::OpCapability, {MkNum(spv::CapabilityStorageUniform16)}));
+    }
+    getSPIRVInstList(kExtensions).push_back(new SPIRVInstruction(
+        spv::OpExtension, {MkString("SPV_KHR_16bit_storage")}));
+  }
+
   { // OpCapability ImageQuery
     bool hasImageQuery = false;
     for (const char *imageQuery : {
@@ -3039,7 +3366,7 @@ void SPIRVProducerPass::GenerateModuleInfo(Module& module) {
     if (hasImageQuery) {
       auto *ImageQueryCapInst = new SPIRVInstruction(
           spv::OpCapability, {MkNum(spv::CapabilityImageQuery)});
-      SPIRVInstList.insert(InsertPoint, ImageQueryCapInst);
+      Capabilities.push_back(ImageQueryCapInst);
     }
   }
 
@@ -3056,8 +3383,7 @@ void SPIRVProducerPass::GenerateModuleInfo(Module& module) {
     Ops.clear();
     Ops << MkNum(spv::CapabilityVariablePointers);
 
-    SPIRVInstList.insert(InsertPoint,
-                         new SPIRVInstruction(spv::OpCapability, Ops));
+    Capabilities.push_back(new SPIRVInstruction(spv::OpCapability, Ops));
 
     //
     // Generate OpExtension.
@@ -3069,14 +3395,10 @@ void SPIRVProducerPass::GenerateModuleInfo(Module& module) {
 
       auto *ExtensionInst =
           new SPIRVInstruction(spv::OpExtension, {MkString(extension)});
-      SPIRVInstList.insert(InsertPoint, ExtensionInst);
+      getSPIRVInstList(kExtensions).push_back(ExtensionInst);
     }
   }
 
-  if (ExtInstImportID) {
-    ++InsertPoint;
-  }
-
   //
   // Generate OpMemoryModel
   //
@@ -3088,7 +3410,7 @@ void SPIRVProducerPass::GenerateModuleInfo(Module& module) {
   Ops << MkNum(spv::AddressingModelLogical) << MkNum(spv::MemoryModelGLSL450);
 
   auto *MemModelInst = new SPIRVInstruction(spv::OpMemoryModel, Ops);
-  SPIRVInstList.insert(InsertPoint, MemModelInst);
+  getSPIRVInstList(kMemoryModel).push_back(MemModelInst);
 
   //
   // Generate OpEntryPoint
@@ -3110,7 +3432,7 @@ void SPIRVProducerPass::GenerateModuleInfo(Module& module) {
     }
 
     auto *EntryPointInst = new SPIRVInstruction(spv::OpEntryPoint, Ops);
-    SPIRVInstList.insert(InsertPoint, EntryPointInst);
+    getSPIRVInstList(kEntryPoints).push_back(EntryPointInst);
   }
 
   for (auto EntryPoint : EntryPoints) {
@@ -3143,7 +3465,7 @@ void SPIRVProducerPass::GenerateModuleInfo(Module& module) {
       Ops << MkNum(XDim) << MkNum(YDim) << MkNum(ZDim);
 
       auto *ExecModeInst = new SPIRVInstruction(spv::OpExecutionMode, Ops);
-      SPIRVInstList.insert(InsertPoint, ExecModeInst);
+      getSPIRVInstList(kExecutionModes).push_back(ExecModeInst);
     }
   }
 
@@ -3157,7 +3479,7 @@ void SPIRVProducerPass::GenerateModuleInfo(Module& module) {
   Ops << MkNum(spv::SourceLanguageOpenCL_C) << MkNum(120);
 
   auto *OpenSourceInst = new SPIRVInstruction(spv::OpSource, Ops);
-  SPIRVInstList.insert(InsertPoint, OpenSourceInst);
+  getSPIRVInstList(kDebug).push_back(OpenSourceInst);
 
   if (!BuiltinDimVec.empty()) {
     //
@@ -3166,32 +3488,34 @@ void SPIRVProducerPass::GenerateModuleInfo(Module& module) {
     // Ops[0] = Target ID
     // Ops[1] = Decoration (SpecId)
     // Ops[2] = Specialization Constant ID (Literal Number)
+    //
+    // These go ahead of all the other decorations.
+    SPIRVInstructionList DimDecorations;
 
     // X Dimension
     Ops.clear();
     Ops << MkId(BuiltinDimVec[0]) << MkNum(spv::DecorationSpecId) << MkNum(0);
-    SPIRVInstList.insert(InsertPoint,
-                         new SPIRVInstruction(spv::OpDecorate, Ops));
+    DimDecorations.push_back(new SPIRVInstruction(spv::OpDecorate, Ops));
 
     // Y Dimension
     Ops.clear();
     Ops << MkId(BuiltinDimVec[1]) << MkNum(spv::DecorationSpecId) << MkNum(1);
-    SPIRVInstList.insert(InsertPoint,
-                         new SPIRVInstruction(spv::OpDecorate, Ops));
+    DimDecorations.push_back(new SPIRVInstruction(spv::OpDecorate, Ops));
 
     // Z Dimension
     Ops.clear();
     Ops << MkId(BuiltinDimVec[2]) << MkNum(spv::DecorationSpecId) << MkNum(2);
-    SPIRVInstList.insert(InsertPoint,
-                         new SPIRVInstruction(spv::OpDecorate, Ops));
+    DimDecorations.push_back(new SPIRVInstruction(spv::OpDecorate, Ops));
+
+    SPIRVInstructionList &Annotations = getSPIRVInstList(kAnnotations);
+    Annotations.insert(Annotations.begin(), DimDecorations.begin(),
+                       DimDecorations.end());
   }
 }
 
 void SPIRVProducerPass::GenerateInstForArg(Function &F) {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-  ValueMapType &VMap = getValueMap();
-  Module *Module = F.getParent();
-  LLVMContext &Context = Module->getContext();
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kFunctions);
+  LayeredValueMap &VMap = getValueMap();
   ValueToValueMapTy &ArgGVMap = getArgumentGVMap();
 
   for (Argument &Arg : F.args()) {
@@ -3202,11 +3526,11 @@ void SPIRVProducerPass::GenerateInstForArg(Function &F) {
     Type *ArgTy = Arg.getType();
     if (IsLocalPtr(ArgTy)) {
       // Generate OpAccessChain to point to the first element of the array.
-      const LocalArgInfo &info = LocalArgMap[&Arg];
+      const LocalArgInfo &info = LocalArgMap.find(&Arg)->second;
       VMap[&Arg] = info.first_elem_ptr_id;
 
       SPIRVOperandList Ops;
-      uint32_t zeroId = VMap[ConstantInt::get(Type::getInt32Ty(Context), 0)];
+      uint32_t zeroId = GetI32Zero();
       Ops << MkId(lookupType(ArgTy)) << MkId(info.variable_id) << MkId(zeroId);
       SPIRVInstList.push_back(new SPIRVInstruction(
           spv::OpAccessChain, info.first_elem_ptr_id, Ops));
@@ -3242,16 +3566,18 @@ void SPIRVProducerPass::GenerateInstForArg(Function &F) {
             // TODO: Do we need to implement Optional Memory Access???
             SPIRVOperandList Ops;
 
-            // Use type with address space modified.
-            ArgTy = ArgGVMap[&Arg]->getType()->getPointerElementType();
+            // Use type with address space modified.  Look the variable up
+            // without making a value handle, which would modify the context.
+            Value *ArgGV = ArgGVMap.find(&Arg)->second;
+            ArgTy = ArgGV->getType()->getPointerElementType();
 
             Ops << MkId(lookupType(ArgTy));
 
             uint32_t PointerID = VMap[&Arg];
             Ops << MkId(PointerID);
 
-            VMap[&Arg] = nextID;
-            auto *Inst = new SPIRVInstruction(spv::OpLoad, nextID++, Ops);
+            VMap[&Arg] = NextID();
+            auto *Inst = new SPIRVInstruction(spv::OpLoad, NextID()++, Ops);
             SPIRVInstList.push_back(Inst);
             continue;
           }
@@ -3278,8 +3604,8 @@ void SPIRVProducerPass::GenerateInstForArg(Function &F) {
             << MkId(GetI32Zero());
 
         // Generate SPIRV instruction for argument.
-        VMap[&Arg] = nextID;
-        auto *ArgInst = new SPIRVInstruction(spv::OpAccessChain, nextID++, Ops);
+        VMap[&Arg] = NextID();
+        auto *ArgInst = new SPIRVInstruction(spv::OpAccessChain, NextID()++, Ops);
         SPIRVInstList.push_back(ArgInst);
       } else {
         // For GEP uses, generate OpAccessChain with folding GEP ahead of GEP.
@@ -3311,9 +3637,9 @@ void SPIRVProducerPass::GenerateInstForArg(Function &F) {
       Ops << MkId(BaseID) << MkId(GetI32Zero());
 
       // Generate SPIRV instruction for argument.
-      uint32_t PointerID = nextID;
-      VMap[&Arg] = nextID;
-      auto *ArgInst = new SPIRVInstruction(spv::OpAccessChain, nextID++, Ops);
+      uint32_t PointerID = NextID();
+      VMap[&Arg] = NextID();
+      auto *ArgInst = new SPIRVInstruction(spv::OpAccessChain, NextID()++, Ops);
       SPIRVInstList.push_back(ArgInst);
 
       //
@@ -3328,8 +3654,8 @@ void SPIRVProducerPass::GenerateInstForArg(Function &F) {
       Ops.clear();
       Ops << MkId(lookupType(ArgTy)) << MkId(PointerID);
 
-      VMap[&Arg] = nextID;
-      auto *Inst = new SPIRVInstruction(spv::OpLoad, nextID++, Ops);
+      VMap[&Arg] = NextID();
+      auto *Inst = new SPIRVInstruction(spv::OpLoad, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
     }
   }
@@ -3349,25 +3675,25 @@ void SPIRVProducerPass::GenerateEntryPointInitialStores() {
     Ops << MkId(WorkgroupSizeVarID) << MkId(WorkgroupSizeValueID);
 
     auto *Inst = new SPIRVInstruction(spv::OpStore, Ops);
-    getSPIRVInstList().push_back(Inst);
+    getSPIRVInstList(kFunctions).push_back(Inst);
   }
 }
 
 void SPIRVProducerPass::GenerateFuncBody(Function &F) {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-  ValueMapType &VMap = getValueMap();
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kFunctions);
+  LayeredValueMap &VMap = getValueMap();
 
   const bool IsKernel = F.getCallingConv() == CallingConv::SPIR_KERNEL;
 
   for (BasicBlock &BB : F) {
     // Register BasicBlock to ValueMap.
-    VMap[&BB] = nextID;
+    VMap[&BB] = NextID();
 
     //
     // Generate OpLabel for Basic Block.
     //
     SPIRVOperandList Ops;
-    auto *Inst = new SPIRVInstruction(spv::OpLabel, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(spv::OpLabel, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
 
     // OpVariable instructions must come first.
@@ -3480,8 +3806,8 @@ spv::Op SPIRVProducerPass::GetSPIRVBinaryOpcode(Instruction &I) {
 }
 
 void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-  ValueMapType &VMap = getValueMap();
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kFunctions);
+  LayeredValueMap &VMap = getValueMap();
   ValueToValueMapTy &ArgGVMap = getArgumentGVMap();
   ValueMapType &ArgGVIDMap = getArgumentGVIDMap();
   DeferredInstVecType &DeferredInsts = getDeferredInstVec();
@@ -3489,7 +3815,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
 
   // Register Instruction to ValueMap.
   if (0 == VMap[&I]) {
-    VMap[&I] = nextID;
+    VMap[&I] = NextID();
   }
 
   switch (I.getOpcode()) {
@@ -3502,7 +3828,8 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
 
       auto Ty = I.getType();
       auto OpTy = I.getOperand(0)->getType();
-      auto toI8 = Ty == Type::getInt8Ty(Context);
+      auto toI8 = Ty == Type::getInt8Ty(Context) &&
+                  !clspv::Option::F8BitStorage();
       auto fromI32 = OpTy == Type::getInt32Ty(Context);
       // Handle zext, sext and uitofp with i1 type specially.
       if ((I.getOpcode() == Instruction::ZExt ||
@@ -3529,26 +3856,26 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
         uint32_t TrueID = 0;
         if (I.getOpcode() == Instruction::ZExt) {
           APInt One(32, 1);
-          TrueID = VMap[Constant::getIntegerValue(I.getType(), One)];
+          TrueID = lookupConstant(Constant::getIntegerValue(I.getType(), One));
         } else if (I.getOpcode() == Instruction::SExt) {
           APInt MinusOne(32, UINT64_MAX, true);
-          TrueID = VMap[Constant::getIntegerValue(I.getType(), MinusOne)];
+          TrueID = lookupConstant(Constant::getIntegerValue(I.getType(), MinusOne));
         } else {
-          TrueID = VMap[ConstantFP::get(Context, APFloat(1.0f))];
+          TrueID = lookupConstant(ConstantFP::get(Context, APFloat(1.0f)));
         }
         Ops << MkId(TrueID);
 
         uint32_t FalseID = 0;
         if (I.getOpcode() == Instruction::ZExt) {
-          FalseID = VMap[Constant::getNullValue(I.getType())];
+          FalseID = lookupConstant(Constant::getNullValue(I.getType()));
         } else if (I.getOpcode() == Instruction::SExt) {
-          FalseID = VMap[Constant::getNullValue(I.getType())];
+          FalseID = lookupConstant(Constant::getNullValue(I.getType()));
         } else {
-          FalseID = VMap[ConstantFP::get(Context, APFloat(0.0f))];
+          FalseID = lookupConstant(ConstantFP::get(Context, APFloat(0.0f)));
         }
         Ops << MkId(FalseID);
 
-        auto *Inst = new SPIRVInstruction(spv::OpSelect, nextID++, Ops);
+        auto *Inst = new SPIRVInstruction(spv::OpSelect, NextID()++, Ops);
         SPIRVInstList.push_back(Inst);
       } else if (I.getOpcode() == Instruction::Trunc && fromI32 && toI8) {
         // The SPIR-V target type is a 32-bit int.  Keep only the bottom
@@ -3563,10 +3890,10 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
         Ops << MkId(lookupType(OpTy)) << MkId(VMap[I.getOperand(0)]);
 
         Type *UintTy = Type::getInt32Ty(Context);
-        uint32_t MaskID = VMap[ConstantInt::get(UintTy, 255)];
+        uint32_t MaskID = lookupConstant(ConstantInt::get(UintTy, 255));
         Ops << MkId(MaskID);
 
-        auto *Inst = new SPIRVInstruction(spv::OpBitwiseAnd, nextID++, Ops);
+        auto *Inst = new SPIRVInstruction(spv::OpBitwiseAnd, NextID()++, Ops);
         SPIRVInstList.push_back(Inst);
       } else {
         // Ops[0] = Result Type ID
@@ -3575,7 +3902,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
 
         Ops << MkId(lookupType(I.getType())) << MkId(VMap[I.getOperand(0)]);
 
-        auto *Inst = new SPIRVInstruction(GetSPIRVCastOpcode(I), nextID++, Ops);
+        auto *Inst = new SPIRVInstruction(GetSPIRVCastOpcode(I), NextID()++, Ops);
         SPIRVInstList.push_back(Inst);
       }
     } else if (isa<BinaryOperator>(I)) {
@@ -3602,7 +3929,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
         }
         Ops << MkId(VMap[CondV]);
 
-        auto *Inst = new SPIRVInstruction(spv::OpLogicalNot, nextID++, Ops);
+        auto *Inst = new SPIRVInstruction(spv::OpLogicalNot, NextID()++, Ops);
         SPIRVInstList.push_back(Inst);
       } else {
         // Ops[0] = Result Type ID
@@ -3614,7 +3941,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
             << MkId(VMap[I.getOperand(1)]);
 
         auto *Inst =
-            new SPIRVInstruction(GetSPIRVBinaryOpcode(I), nextID++, Ops);
+            new SPIRVInstruction(GetSPIRVBinaryOpcode(I), NextID()++, Ops);
         SPIRVInstList.push_back(Inst);
       }
     } else {
@@ -3666,7 +3993,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     uint32_t BaseID;
     if (HasArgBasePointer) {
       // Point to global variable for argument directly.
-      BaseID = ArgGVIDMap[GEP->getPointerOperand()];
+      BaseID = ArgGVIDMap.lookup(GEP->getPointerOperand());
     } else {
       BaseID = VMap[GEP->getPointerOperand()];
     }
@@ -3676,8 +4003,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     if (HasArgBasePointer) {
       // If GEP's pointer operand is argument, add one more index for struct
       // type to wrap up argument type.
-      Type *IdxTy = Type::getInt32Ty(Context);
-      Ops << MkId(VMap[ConstantInt::get(IdxTy, 0)]);
+      Ops << MkId(GetI32Zero());
     }
 
     //
@@ -3723,7 +4049,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Ops << MkId(VMap[*II]);
     }
 
-    auto *Inst = new SPIRVInstruction(Opcode, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(Opcode, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -3743,7 +4069,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Ops << MkNum(Index);
     }
 
-    auto *Inst = new SPIRVInstruction(spv::OpCompositeExtract, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(spv::OpCompositeExtract, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -3768,7 +4094,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Ops << MkNum(Index);
     }
 
-    auto *Inst = new SPIRVInstruction(spv::OpCompositeInsert, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(spv::OpCompositeInsert, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -3796,7 +4122,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     Ops << MkId(lookupType(Ty)) << MkId(VMap[I.getOperand(0)])
         << MkId(VMap[I.getOperand(1)]) << MkId(VMap[I.getOperand(2)]);
 
-    auto *Inst = new SPIRVInstruction(spv::OpSelect, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(spv::OpSelect, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -3827,9 +4153,9 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       if (ConstantInt *CI = dyn_cast<ConstantInt>(I.getOperand(1))) {
         // Handle constant index.
         uint64_t Idx = CI->getZExtValue();
-        Value *ShiftAmount =
+        Constant *ShiftAmount =
             ConstantInt::get(Type::getInt32Ty(Context), Idx * 8);
-        Op1ID = VMap[ShiftAmount];
+        Op1ID = lookupConstant(ShiftAmount);
       } else {
         // Handle variable index.
         SPIRVOperandList TmpOps;
@@ -3838,19 +4164,19 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
                << MkId(VMap[I.getOperand(1)]);
 
         ConstantInt *Cst8 = ConstantInt::get(Type::getInt32Ty(Context), 8);
-        TmpOps << MkId(VMap[Cst8]);
+        TmpOps << MkId(lookupConstant(Cst8));
 
-        Op1ID = nextID;
+        Op1ID = NextID();
 
-        auto *TmpInst = new SPIRVInstruction(spv::OpIMul, nextID++, TmpOps);
+        auto *TmpInst = new SPIRVInstruction(spv::OpIMul, NextID()++, TmpOps);
         SPIRVInstList.push_back(TmpInst);
       }
       Ops << MkId(Op1ID);
 
-      uint32_t ShiftID = nextID;
+      uint32_t ShiftID = NextID();
 
       auto *Inst =
-          new SPIRVInstruction(spv::OpShiftRightLogical, nextID++, Ops);
+          new SPIRVInstruction(spv::OpShiftRightLogical, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
 
       //
@@ -3865,12 +4191,12 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Ops << MkId(lookupType(CompositeTy)) << MkId(ShiftID);
 
       Constant *CstFF = ConstantInt::get(Type::getInt32Ty(Context), 0xFF);
-      Ops << MkId(VMap[CstFF]);
+      Ops << MkId(lookupConstant(CstFF));
 
       // Reset mapping for this value to the result of the bitwise and.
-      VMap[&I] = nextID;
+      VMap[&I] = NextID();
 
-      Inst = new SPIRVInstruction(spv::OpBitwiseAnd, nextID++, Ops);
+      Inst = new SPIRVInstruction(spv::OpBitwiseAnd, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
       break;
     }
@@ -3890,7 +4216,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Opcode = spv::OpVectorExtractDynamic;
     }
 
-    auto *Inst = new SPIRVInstruction(Opcode, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(Opcode, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -3899,15 +4225,15 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     Type *CompositeTy = I.getOperand(0)->getType();
     if (is4xi8vec(CompositeTy)) {
       Constant *CstFF = ConstantInt::get(Type::getInt32Ty(Context), 0xFF);
-      uint32_t CstFFID = VMap[CstFF];
+      uint32_t CstFFID = lookupConstant(CstFF);
 
       uint32_t ShiftAmountID = 0;
       if (ConstantInt *CI = dyn_cast<ConstantInt>(I.getOperand(2))) {
         // Handle constant index.
         uint64_t Idx = CI->getZExtValue();
-        Value *ShiftAmount =
+        Constant *ShiftAmount =
             ConstantInt::get(Type::getInt32Ty(Context), Idx * 8);
-        ShiftAmountID = VMap[ShiftAmount];
+        ShiftAmountID = lookupConstant(ShiftAmount);
       } else {
         // Handle variable index.
         SPIRVOperandList TmpOps;
@@ -3916,11 +4242,11 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
                << MkId(VMap[I.getOperand(2)]);
 
         ConstantInt *Cst8 = ConstantInt::get(Type::getInt32Ty(Context), 8);
-        TmpOps << MkId(VMap[Cst8]);
+        TmpOps << MkId(lookupConstant(Cst8));
 
-        ShiftAmountID = nextID;
+        ShiftAmountID = NextID();
 
-        auto *TmpInst = new SPIRVInstruction(spv::OpIMul, nextID++, TmpOps);
+        auto *TmpInst = new SPIRVInstruction(spv::OpIMul, NextID()++, TmpOps);
         SPIRVInstList.push_back(TmpInst);
       }
 
@@ -3934,45 +4260,45 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       const uint32_t ResTyID = lookupType(CompositeTy);
       Ops << MkId(ResTyID) << MkId(CstFFID) << MkId(ShiftAmountID);
 
-      uint32_t MaskID = nextID;
+      uint32_t MaskID = NextID();
 
-      auto *Inst = new SPIRVInstruction(spv::OpShiftLeftLogical, nextID++, Ops);
+      auto *Inst = new SPIRVInstruction(spv::OpShiftLeftLogical, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
 
       // Inverse mask.
       Ops.clear();
       Ops << MkId(ResTyID) << MkId(MaskID);
 
-      uint32_t InvMaskID = nextID;
+      uint32_t InvMaskID = NextID();
 
-      Inst = new SPIRVInstruction(spv::OpNot, nextID++, Ops);
+      Inst = new SPIRVInstruction(spv::OpNot, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
 
       // Apply mask.
       Ops.clear();
       Ops << MkId(ResTyID) << MkId(VMap[I.getOperand(0)]) << MkId(InvMaskID);
 
-      uint32_t OrgValID = nextID;
+      uint32_t OrgValID = NextID();
 
-      Inst = new SPIRVInstruction(spv::OpBitwiseAnd, nextID++, Ops);
+      Inst = new SPIRVInstruction(spv::OpBitwiseAnd, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
 
       // Create correct value according to index of insertelement.
       Ops.clear();
       Ops << MkId(ResTyID) << MkId(VMap[I.getOperand(1)]) << MkId(ShiftAmountID);
 
-      uint32_t InsertValID = nextID;
+      uint32_t InsertValID = NextID();
 
-      Inst = new SPIRVInstruction(spv::OpShiftLeftLogical, nextID++, Ops);
+      Inst = new SPIRVInstruction(spv::OpShiftLeftLogical, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
 
       // Insert value to original value.
       Ops.clear();
       Ops << MkId(ResTyID) << MkId(OrgValID) << MkId(InsertValID);
 
-      VMap[&I] = nextID;
+      VMap[&I] = NextID();
 
-      Inst = new SPIRVInstruction(spv::OpBitwiseOr, nextID++, Ops);
+      Inst = new SPIRVInstruction(spv::OpBitwiseOr, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
 
       break;
@@ -3997,7 +4323,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Opcode = spv::OpVectorInsertDynamic;
     }
 
-    auto *Inst = new SPIRVInstruction(Opcode, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(Opcode, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -4050,7 +4376,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       }
     }
 
-    auto *Inst = new SPIRVInstruction(spv::OpVectorShuffle, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(spv::OpVectorShuffle, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -4079,7 +4405,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
         << MkId(VMap[CmpI->getOperand(1)]);
 
     spv::Op Opcode = GetSPIRVCmpOpcode(CmpI);
-    auto *Inst = new SPIRVInstruction(Opcode, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(Opcode, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -4087,7 +4413,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     // Branch instrucion is deferred because it needs label's ID. Record slot's
     // location on SPIRVInstructionList.
     DeferredInsts.push_back(
-        std::make_tuple(&I, --SPIRVInstList.end(), 0 /* No id */));
+        std::make_tuple(&I, SPIRVInstList.size(), 0 /* No id */));
     break;
   }
   case Instruction::Switch: {
@@ -4104,7 +4430,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     // Branch instrucion is deferred because it needs label's ID. Record slot's
     // location on SPIRVInstructionList.
     DeferredInsts.push_back(
-        std::make_tuple(&I, --SPIRVInstList.end(), nextID++));
+        std::make_tuple(&I, SPIRVInstList.size(), NextID()++));
     break;
   }
   case Instruction::Alloca: {
@@ -4117,7 +4443,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
 
     Ops << MkId(lookupType(I.getType())) << MkNum(spv::StorageClassFunction);
 
-    auto *Inst = new SPIRVInstruction(spv::OpVariable, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(spv::OpVariable, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -4146,7 +4472,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Ops << MkId(ResTyID) << MkId(WorkgroupSizeValueID)
           << MkId(WorkgroupSizeValueID);
 
-      auto *Inst = new SPIRVInstruction(spv::OpBitwiseAnd, nextID++, Ops);
+      auto *Inst = new SPIRVInstruction(spv::OpBitwiseAnd, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
       break;
     }
@@ -4162,7 +4488,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     SPIRVOperandList Ops;
     Ops << MkId(ResTyID) << MkId(PointerID);
 
-    auto *Inst = new SPIRVInstruction(spv::OpLoad, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(spv::OpLoad, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -4241,18 +4567,18 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
 
     auto IntTy = Type::getInt32Ty(I.getContext());
     const auto ConstantScopeDevice = ConstantInt::get(IntTy, spv::ScopeDevice);
-    Ops << MkId(VMap[ConstantScopeDevice]);
+    Ops << MkId(lookupConstant(ConstantScopeDevice));
 
     const auto ConstantMemorySemantics = ConstantInt::get(
         IntTy, spv::MemorySemanticsUniformMemoryMask |
                    spv::MemorySemanticsSequentiallyConsistentMask);
-    Ops << MkId(VMap[ConstantMemorySemantics]);
+    Ops << MkId(lookupConstant(ConstantMemorySemantics));
 
     Ops << MkId(VMap[AtomicRMW->getValOperand()]);
 
-    VMap[&I] = nextID;
+    VMap[&I] = NextID();
 
-    auto *Inst = new SPIRVInstruction(opcode, nextID++, Ops);
+    auto *Inst = new SPIRVInstruction(opcode, NextID()++, Ops);
     SPIRVInstList.push_back(Inst);
     break;
   }
@@ -4279,8 +4605,8 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Ops << MkId(lookupType(SamplerTy->getPointerElementType()))
           << MkId(VMap[Call]);
 
-      VMap[Call] = nextID;
-      auto *Inst = new SPIRVInstruction(spv::OpLoad, nextID++, Ops);
+      VMap[Call] = NextID();
+      auto *Inst = new SPIRVInstruction(spv::OpLoad, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
 
       break;
@@ -4315,9 +4641,9 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
         Ops << MkId(VMap[Call->getArgOperand(i)]);
       }
 
-      VMap[&I] = nextID;
+      VMap[&I] = NextID();
 
-      auto *Inst = new SPIRVInstruction(opcode, nextID++, Ops);
+      auto *Inst = new SPIRVInstruction(opcode, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
       break;
     }
@@ -4336,9 +4662,9 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
           Ops << MkId(VMap[Call->getArgOperand(i)]);
         }
 
-        VMap[&I] = nextID;
+        VMap[&I] = NextID();
 
-        auto *Inst = new SPIRVInstruction(spv::OpDot, nextID++, Ops);
+        auto *Inst = new SPIRVInstruction(spv::OpDot, NextID()++, Ops);
         SPIRVInstList.push_back(Inst);
       } else {
         //
@@ -4352,9 +4678,9 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
           Ops << MkId(VMap[Call->getArgOperand(i)]);
         }
 
-        VMap[&I] = nextID;
+        VMap[&I] = NextID();
 
-        auto *Inst = new SPIRVInstruction(spv::OpFMul, nextID++, Ops);
+        auto *Inst = new SPIRVInstruction(spv::OpFMul, NextID()++, Ops);
         SPIRVInstList.push_back(Inst);
       }
       break;
@@ -4374,9 +4700,9 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
         Ops << MkId(VMap[Call->getArgOperand(i)]);
       }
 
-      VMap[&I] = nextID;
+      VMap[&I] = NextID();
 
-      auto *Inst = new SPIRVInstruction(spv::OpFRem, nextID++, Ops);
+      auto *Inst = new SPIRVInstruction(spv::OpFRem, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
       break;
     }
@@ -4502,9 +4828,9 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Ops << MkId(lookupType(I.getType()))
           << MkId(VMap[Call->getArgOperand(0)]);
 
-      VMap[&I] = nextID;
+      VMap[&I] = NextID();
 
-      auto *Inst = new SPIRVInstruction(spv::OpIsInf, nextID++, Ops);
+      auto *Inst = new SPIRVInstruction(spv::OpIsInf, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
       break;
     }
@@ -4525,9 +4851,9 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Ops << MkId(lookupType(I.getType()))
           << MkId(VMap[Call->getArgOperand(0)]);
 
-      VMap[&I] = nextID;
+      VMap[&I] = NextID();
 
-      auto *Inst = new SPIRVInstruction(spv::OpIsNan, nextID++, Ops);
+      auto *Inst = new SPIRVInstruction(spv::OpIsNan, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
       break;
     }
@@ -4547,9 +4873,9 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Ops << MkId(lookupType(I.getType()))
           << MkId(VMap[Call->getArgOperand(0)]);
 
-      VMap[&I] = nextID;
+      VMap[&I] = NextID();
 
-      auto *Inst = new SPIRVInstruction(spv::OpAll, nextID++, Ops);
+      auto *Inst = new SPIRVInstruction(spv::OpAll, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
       break;
     }
@@ -4569,9 +4895,9 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       Ops << MkId(lookupType(I.getType()))
           << MkId(VMap[Call->getArgOperand(0)]);
 
-      VMap[&I] = nextID;
+      VMap[&I] = NextID();
 
-      auto *Inst = new SPIRVInstruction(spv::OpAny, nextID++, Ops);
+      auto *Inst = new SPIRVInstruction(spv::OpAny, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
       break;
     }
@@ -4597,15 +4923,15 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
 
       TypeMapType &OpImageTypeMap = getImageTypeMap();
       Type *ImageTy = Image->getType()->getPointerElementType();
-      uint32_t ImageTyID = OpImageTypeMap[ImageTy];
+      uint32_t ImageTyID = OpImageTypeMap.lookup(ImageTy);
       uint32_t ImageID = VMap[Image];
       uint32_t SamplerID = VMap[Sampler];
 
       Ops << MkId(ImageTyID) << MkId(ImageID) << MkId(SamplerID);
 
-      uint32_t SampledImageID = nextID;
+      uint32_t SampledImageID = NextID();
 
-      auto *Inst = new SPIRVInstruction(spv::OpSampledImage, nextID++, Ops);
+      auto *Inst = new SPIRVInstruction(spv::OpSampledImage, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
 
       //
@@ -4623,11 +4949,11 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
           << MkId(VMap[Coordinate]) << MkNum(spv::ImageOperandsLodMask);
 
       Constant *CstFP0 = ConstantFP::get(Context, APFloat(0.0f));
-      Ops << MkId(VMap[CstFP0]);
+      Ops << MkId(lookupConstant(CstFP0));
 
-      VMap[&I] = nextID;
+      VMap[&I] = NextID();
 
-      Inst = new SPIRVInstruction(spv::OpImageSampleExplicitLod, nextID++, Ops);
+      Inst = new SPIRVInstruction(spv::OpImageSampleExplicitLod, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
       break;
     }
@@ -4680,28 +5006,28 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
       // Implement:
       //     %sizes = OpImageQuerySizes %uint2 %im
       uint32_t SizesTypeID =
-          TypeMap[VectorType::get(Type::getInt32Ty(Context), 2)];
+          lookupType(VectorType::get(Type::getInt32Ty(Context), 2));
       Value *Image = Call->getArgOperand(0);
       uint32_t ImageID = VMap[Image];
       Ops << MkId(SizesTypeID) << MkId(ImageID);
 
-      uint32_t SizesID = nextID++;
+      uint32_t SizesID = NextID()++;
       auto *QueryInst =
           new SPIRVInstruction(spv::OpImageQuerySize, SizesID, Ops);
       SPIRVInstList.push_back(QueryInst);
 
       // Reset value map entry since we generated an intermediate instruction.
-      VMap[&I] = nextID;
+      VMap[&I] = NextID();
 
       // Implement:
       //     %result = OpCompositeExtract %uint %sizes 0-or-1
       Ops.clear();
-      Ops << MkId(TypeMap[I.getType()]) << MkId(SizesID);
+      Ops << MkId(TypeMap.lookup(I.getType())) << MkId(SizesID);
 
       uint32_t component = Callee->getName().contains("height") ? 1 : 0;
       Ops << MkNum(component);
 
-      auto *Inst = new SPIRVInstruction(spv::OpCompositeExtract, nextID++, Ops);
+      auto *Inst = new SPIRVInstruction(spv::OpCompositeExtract, NextID()++, Ops);
       SPIRVInstList.push_back(Inst);
       break;
     }
@@ -4709,7 +5035,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     // Call instrucion is deferred because it needs function's ID. Record
     // slot's location on SPIRVInstructionList.
     DeferredInsts.push_back(
-        std::make_tuple(&I, --SPIRVInstList.end(), nextID++));
+        std::make_tuple(&I, SPIRVInstList.size(), NextID()++));
 
     // Check whether the implementation of this call uses an extended
     // instruction plus one more value-producing instruction.  If so, then
@@ -4717,9 +5043,9 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
     glsl::ExtInst EInst = getIndirectExtInstEnum(Callee->getName());
     if (EInst != kGlslExtInstBad) {
       // Reserve a spot for the extra value.
-      // Increase nextID.
-      VMap[&I] = nextID;
-      nextID++;
+      // Increase NextID().
+      VMap[&I] = NextID();
+      NextID()++;
     }
     break;
   }
@@ -4750,7 +5076,7 @@ void SPIRVProducerPass::GenerateInstruction(Instruction &I) {
 }
 
 void SPIRVProducerPass::GenerateFuncEpilogue() {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kFunctions);
 
   //
   // Generate OpFunctionEnd
@@ -4761,6 +5087,11 @@ void SPIRVProducerPass::GenerateFuncEpilogue() {
 }
 
 bool SPIRVProducerPass::is4xi8vec(Type *Ty) const {
+  // With 8-bit storage, <4 x i8> is a vector of its own.
+  if (clspv::Option::F8BitStorage()) {
+    return false;
+  }
+
   LLVMContext &Context = Ty->getContext();
   if (Ty->isVectorTy()) {
     if (Ty->getVectorElementType() == Type::getInt8Ty(Context) &&
@@ -4780,68 +5111,48 @@ uint32_t SPIRVProducerPass::GetI32Zero() {
   return constant_i32_zero_id_;
 }
 
+const StructuredControlFlow &
+SPIRVProducerPass::getStructuredControlFlow(Function &F) {
+  auto &CF = StructuredControlFlows[&F];
+  if (!CF) {
+    // Getting an analysis of a function from a module pass computes it from
+    // scratch, so do it once per function.
+    DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>(F).getDomTree();
+    const LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>(F).getLoopInfo();
+    CF.reset(new StructuredControlFlow(F, DT, LI));
+  }
+  return *CF;
+}
+
 void SPIRVProducerPass::HandleDeferredInstruction() {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-  ValueMapType &VMap = getValueMap();
+  LayeredValueMap &VMap = getValueMap();
   DeferredInstVecType &DeferredInsts = getDeferredInstVec();
 
-  for (auto DeferredInst = DeferredInsts.rbegin();
-       DeferredInst != DeferredInsts.rend(); ++DeferredInst) {
+  // Rebuild the function section in a single pass, splicing each deferred
+  // instruction in at the index recorded for it.  Deferred instructions were
+  // recorded in order, so their indices never decrease.
+  SPIRVInstructionList Generated;
+  Generated.swap(getSPIRVInstList(kFunctions));
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kFunctions);
+  SPIRVInstList.reserve(Generated.size() + DeferredInsts.size());
+  auto Copied = Generated.begin();
+
+  for (auto DeferredInst = DeferredInsts.begin();
+       DeferredInst != DeferredInsts.end(); ++DeferredInst) {
     Value *Inst = std::get<0>(*DeferredInst);
-    SPIRVInstructionList::iterator InsertPoint = ++std::get<1>(*DeferredInst);
-    if (InsertPoint != SPIRVInstList.end()) {
-      while ((*InsertPoint)->getOpcode() == spv::OpPhi) {
-        ++InsertPoint;
-      }
-    }
+    auto InsertPoint = Generated.begin() + std::get<1>(*DeferredInst);
+    SPIRVInstList.insert(SPIRVInstList.end(), Copied, InsertPoint);
+    Copied = InsertPoint;
 
     if (BranchInst *Br = dyn_cast<BranchInst>(Inst)) {
       // Check whether basic block, which has this branch instruction, is loop
       // header or not. If it is loop header, generate OpLoopMerge and
       // OpBranchConditional.
-      Function *Func = Br->getParent()->getParent();
-      DominatorTree &DT =
-          getAnalysis<DominatorTreeWrapperPass>(*Func).getDomTree();
-      const LoopInfo &LI =
-          getAnalysis<LoopInfoWrapperPass>(*Func).getLoopInfo();
-
       BasicBlock *BrBB = Br->getParent();
-      if (LI.isLoopHeader(BrBB)) {
-        Value *ContinueBB = nullptr;
-        Value *MergeBB = nullptr;
-
-        Loop *L = LI.getLoopFor(BrBB);
-        MergeBB = L->getExitBlock();
-        if (!MergeBB) {
-          // StructurizeCFG pass converts CFG into triangle shape and the cfg
-          // has regions with single entry/exit. As a result, loop should not
-          // have multiple exits.
-          llvm_unreachable("Loop has multiple exits???");
-        }
-
-        if (L->isLoopLatch(BrBB)) {
-          ContinueBB = BrBB;
-        } else {
-          // From SPIR-V spec 2.11, Continue Target must dominate that back-edge
-          // block.
-          BasicBlock *Header = L->getHeader();
-          BasicBlock *Latch = L->getLoopLatch();
-          for (BasicBlock *BB : L->blocks()) {
-            if (BB == Header) {
-              continue;
-            }
-
-            // Check whether block dominates block with back-edge.
-            if (DT.dominates(BB, Latch)) {
-              ContinueBB = BB;
-            }
-          }
-
-          if (!ContinueBB) {
-            llvm_unreachable("Wrong continue block from loop");
-          }
-        }
+      const StructuredControlFlow &CF =
+          getStructuredControlFlow(*BrBB->getParent());
 
+      if (BasicBlock *MergeBB = CF.getLoopMerge(BrBB)) {
         //
         // Generate OpLoopMerge.
         //
@@ -4850,40 +5161,27 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
         // Ops[2] = Selection Control
         SPIRVOperandList Ops;
 
-        // StructurizeCFG pass already manipulated CFG. Just use false block of
-        // branch instruction as merge block.
         uint32_t MergeBBID = VMap[MergeBB];
-        uint32_t ContinueBBID = VMap[ContinueBB];
+        uint32_t ContinueBBID = VMap[CF.getContinueTarget(BrBB)];
         Ops << MkId(MergeBBID) << MkId(ContinueBBID)
             << MkNum(spv::SelectionControlMaskNone);
 
         auto *MergeInst = new SPIRVInstruction(spv::OpLoopMerge, Ops);
-        SPIRVInstList.insert(InsertPoint, MergeInst);
-
-      } else if (Br->isConditional()) {
-        bool HasBackEdge = false;
+        SPIRVInstList.push_back(MergeInst);
 
-        for (unsigned i = 0; i < Br->getNumSuccessors(); i++) {
-          if (LI.isLoopHeader(Br->getSuccessor(i))) {
-            HasBackEdge = true;
-          }
-        }
-        if (!HasBackEdge) {
-          //
-          // Generate OpSelectionMerge.
-          //
-          // Ops[0] = Merge Block ID
-          // Ops[1] = Selection Control
-          SPIRVOperandList Ops;
+      } else if (BasicBlock *MergeBB = CF.getSelectionMerge(BrBB)) {
+        //
+        // Generate OpSelectionMerge.
+        //
+        // Ops[0] = Merge Block ID
+        // Ops[1] = Selection Control
+        SPIRVOperandList Ops;
 
-          // StructurizeCFG pass already manipulated CFG. Just use false block
-          // of branch instruction as merge block.
-          uint32_t MergeBBID = VMap[Br->getSuccessor(1)];
-          Ops << MkId(MergeBBID) << MkNum(spv::SelectionControlMaskNone);
+        uint32_t MergeBBID = VMap[MergeBB];
+        Ops << MkId(MergeBBID) << MkNum(spv::SelectionControlMaskNone);
 
-          auto *MergeInst = new SPIRVInstruction(spv::OpSelectionMerge, Ops);
-          SPIRVInstList.insert(InsertPoint, MergeInst);
-        }
+        auto *MergeInst = new SPIRVInstruction(spv::OpSelectionMerge, Ops);
+        SPIRVInstList.push_back(MergeInst);
       }
 
       if (Br->isConditional()) {
@@ -4903,7 +5201,7 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
         Ops << MkId(CondID) << MkId(TrueBBID) << MkId(FalseBBID);
 
         auto *BrInst = new SPIRVInstruction(spv::OpBranchConditional, Ops);
-        SPIRVInstList.insert(InsertPoint, BrInst);
+        SPIRVInstList.push_back(BrInst);
       } else {
         //
         // Generate OpBranch.
@@ -4914,8 +5212,7 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
         uint32_t TargetID = VMap[Br->getSuccessor(0)];
         Ops << MkId(TargetID);
 
-        SPIRVInstList.insert(InsertPoint,
-                             new SPIRVInstruction(spv::OpBranch, Ops));
+        SPIRVInstList.push_back(new SPIRVInstruction(spv::OpBranch, Ops));
       }
     } else if (PHINode *PHI = dyn_cast<PHINode>(Inst)) {
       //
@@ -4933,8 +5230,7 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
         Ops << MkId(VarID) << MkId(ParentID);
       }
 
-      SPIRVInstList.insert(
-          InsertPoint,
+      SPIRVInstList.push_back(
           new SPIRVInstruction(spv::OpPhi, std::get<2>(*DeferredInst), Ops));
     } else if (CallInst *Call = dyn_cast<CallInst>(Inst)) {
       Function *Callee = Call->getCalledFunction();
@@ -4963,7 +5259,7 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
 
         auto *ExtInst = new SPIRVInstruction(spv::OpExtInst,
                                              std::get<2>(*DeferredInst), Ops);
-        SPIRVInstList.insert(InsertPoint, ExtInst);
+        SPIRVInstList.push_back(ExtInst);
 
         const auto IndirectExtInst = getIndirectExtInstEnum(callee_name);
         if (IndirectExtInst != kGlslExtInstBad) {
@@ -4974,7 +5270,7 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
               Call->getParent()->getParent()->getParent()->getContext();
 
           auto generate_extra_inst = [this, &Context, &Call, &DeferredInst,
-                                      &VMap, &SPIRVInstList, &InsertPoint](
+                                      &VMap, &SPIRVInstList](
                                          spv::Op opcode, Constant *constant) {
             //
             // Generate instruction like:
@@ -4994,9 +5290,8 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
             }
             Ops << MkId(VMap[constant]) << MkId(std::get<2>(*DeferredInst));
 
-            SPIRVInstList.insert(
-                InsertPoint, new SPIRVInstruction(
-                                 opcode, std::get<2>(*DeferredInst) + 1, Ops));
+            SPIRVInstList.push_back(new SPIRVInstruction(
+                opcode, std::get<2>(*DeferredInst) + 1, Ops));
           };
 
           switch (IndirectExtInst) {
@@ -5009,7 +5304,7 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
           case glsl::ExtInstAtan2: // Implementing atan2pi
             generate_extra_inst(
                 spv::OpFMul,
-                ConstantFP::get(Type::getFloatTy(Context), kOneOverPi));
+                ConstantFP::get(Call->getType()->getScalarType(), kOneOverPi));
             break;
 
           default:
@@ -5034,9 +5329,8 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
         Ops << MkId(lookupType(Call->getType()))
             << MkId(VMap[Call->getOperand(0)]);
 
-        SPIRVInstList.insert(
-            InsertPoint, new SPIRVInstruction(spv::OpBitCount,
-                                              std::get<2>(*DeferredInst), Ops));
+        SPIRVInstList.push_back(new SPIRVInstruction(
+            spv::OpBitCount, std::get<2>(*DeferredInst), Ops));
 
       } else if (Callee->getName().startswith(kCompositeConstructFunctionPrefix)) {
 
@@ -5051,9 +5345,8 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
           Ops << MkId(VMap[use.get()]);
         }
 
-        SPIRVInstList.insert(
-            InsertPoint, new SPIRVInstruction(spv::OpCompositeConstruct,
-                                              std::get<2>(*DeferredInst), Ops));
+        SPIRVInstList.push_back(new SPIRVInstruction(
+            spv::OpCompositeConstruct, std::get<2>(*DeferredInst), Ops));
 
       } else {
         //
@@ -5086,10 +5379,12 @@ void SPIRVProducerPass::HandleDeferredInstruction() {
 
         auto *CallInst = new SPIRVInstruction(spv::OpFunctionCall,
                                               std::get<2>(*DeferredInst), Ops);
-        SPIRVInstList.insert(InsertPoint, CallInst);
+        SPIRVInstList.push_back(CallInst);
       }
     }
   }
+
+  SPIRVInstList.insert(SPIRVInstList.end(), Copied, Generated.end());
 }
 
 void SPIRVProducerPass::HandleDeferredDecorations(const DataLayout &DL) {
@@ -5097,23 +5392,7 @@ void SPIRVProducerPass::HandleDeferredDecorations(const DataLayout &DL) {
     return;
   }
 
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-
-  // Find an iterator pointing just past the last decoration.
-  bool seen_decorations = false;
-  auto DecoInsertPoint =
-      std::find_if(SPIRVInstList.begin(), SPIRVInstList.end(),
-                   [&seen_decorations](SPIRVInstruction *Inst) -> bool {
-                     const bool is_decoration =
-                         Inst->getOpcode() == spv::OpDecorate ||
-                         Inst->getOpcode() == spv::OpMemberDecorate;
-                     if (is_decoration) {
-                       seen_decorations = true;
-                       return false;
-                     } else {
-                       return seen_decorations;
-                     }
-                   });
+  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList(kAnnotations);
 
   // Insert ArrayStride decorations on pointer types, due to OpPtrAccessChain
   // instructions we generated earlier.
@@ -5142,7 +5421,7 @@ void SPIRVProducerPass::HandleDeferredDecorations(const DataLayout &DL) {
         << MkNum(stride);
 
     auto *DecoInst = new SPIRVInstruction(spv::OpDecorate, Ops);
-    SPIRVInstList.insert(DecoInsertPoint, DecoInst);
+    SPIRVInstList.push_back(DecoInst);
   }
 
   // Emit SpecId decorations targeting the array size value.
@@ -5151,8 +5430,7 @@ void SPIRVProducerPass::HandleDeferredDecorations(const DataLayout &DL) {
     SPIRVOperandList Ops;
     Ops << MkId(arg_info.array_size_id) << MkNum(spv::DecorationSpecId)
         << MkNum(arg_info.spec_id);
-    SPIRVInstList.insert(DecoInsertPoint,
-                         new SPIRVInstruction(spv::OpDecorate, Ops));
+    SPIRVInstList.push_back(new SPIRVInstruction(spv::OpDecorate, Ops));
   }
 }
 
@@ -5174,6 +5452,10 @@ glsl::ExtInst SPIRVProducerPass::getExtInstEnum(StringRef Name) {
       .Case("_Z5clampDv2_fS_S_", glsl::ExtInst::ExtInstFClamp)
       .Case("_Z5clampDv3_fS_S_", glsl::ExtInst::ExtInstFClamp)
       .Case("_Z5clampDv4_fS_S_", glsl::ExtInst::ExtInstFClamp)
+      .Case("_Z5clampDhDhDh", glsl::ExtInst::ExtInstFClamp)
+      .Case("_Z5clampDv2_DhS_S_", glsl::ExtInst::ExtInstFClamp)
+      .Case("_Z5clampDv3_DhS_S_", glsl::ExtInst::ExtInstFClamp)
+      .Case("_Z5clampDv4_DhS_S_", glsl::ExtInst::ExtInstFClamp)
       .Case("_Z3maxii", glsl::ExtInst::ExtInstSMax)
       .Case("_Z3maxDv2_iS_", glsl::ExtInst::ExtInstSMax)
       .Case("_Z3maxDv3_iS_", glsl::ExtInst::ExtInstSMax)
@@ -5186,6 +5468,10 @@ glsl::ExtInst SPIRVProducerPass::getExtInstEnum(StringRef Name) {
       .Case("_Z3maxDv2_fS_", glsl::ExtInst::ExtInstFMax)
       .Case("_Z3maxDv3_fS_", glsl::ExtInst::ExtInstFMax)
       .Case("_Z3maxDv4_fS_", glsl::ExtInst::ExtInstFMax)
+      .Case("_Z3maxDhDh", glsl::ExtInst::ExtInstFMax)
+      .Case("_Z3maxDv2_DhS_", glsl::ExtInst::ExtInstFMax)
+      .Case("_Z3maxDv3_DhS_", glsl::ExtInst::ExtInstFMax)
+      .Case("_Z3maxDv4_DhS_", glsl::ExtInst::ExtInstFMax)
       .StartsWith("_Z4fmax", glsl::ExtInst::ExtInstFMax)
       .Case("_Z3minii", glsl::ExtInst::ExtInstSMin)
       .Case("_Z3minDv2_iS_", glsl::ExtInst::ExtInstSMin)
@@ -5199,6 +5485,10 @@ glsl::ExtInst SPIRVProducerPass::getExtInstEnum(StringRef Name) {
       .Case("_Z3minDv2_fS_", glsl::ExtInst::ExtInstFMin)
       .Case("_Z3minDv3_fS_", glsl::ExtInst::ExtInstFMin)
       .Case("_Z3minDv4_fS_", glsl::ExtInst::ExtInstFMin)
+      .Case("_Z3minDhDh", glsl::ExtInst::ExtInstFMin)
+      .Case("_Z3minDv2_DhS_", glsl::ExtInst::ExtInstFMin)
+      .Case("_Z3minDv3_DhS_", glsl::ExtInst::ExtInstFMin)
+      .Case("_Z3minDv4_DhS_", glsl::ExtInst::ExtInstFMin)
       .StartsWith("_Z4fmin", glsl::ExtInst::ExtInstFMin)
       .StartsWith("_Z7degrees", glsl::ExtInst::ExtInstDegrees)
       .StartsWith("_Z7radians", glsl::ExtInst::ExtInstRadians)
@@ -5256,6 +5546,7 @@ glsl::ExtInst SPIRVProducerPass::getExtInstEnum(StringRef Name) {
       .StartsWith("_Z8distance", glsl::ExtInst::ExtInstDistance)
       .StartsWith("_Z4step", glsl::ExtInst::ExtInstStep)
       .Case("_Z5crossDv3_fS_", glsl::ExtInst::ExtInstCross)
+      .Case("_Z5crossDv3_DhS_", glsl::ExtInst::ExtInstCross)
       .StartsWith("_Z9normalize", glsl::ExtInst::ExtInstNormalize)
       .StartsWith("llvm.fmuladd.", glsl::ExtInst::ExtInstFma)
       .Case("spirv.unpack.v2f16", glsl::ExtInst::ExtInstUnpackHalf2x16)
@@ -5264,6 +5555,10 @@ glsl::ExtInst SPIRVProducerPass::getExtInstEnum(StringRef Name) {
       .Case("clspv.fract.v2f", glsl::ExtInst::ExtInstFract)
       .Case("clspv.fract.v3f", glsl::ExtInst::ExtInstFract)
       .Case("clspv.fract.v4f", glsl::ExtInst::ExtInstFract)
+      .Case("clspv.fract.f16", glsl::ExtInst::ExtInstFract)
+      .Case("clspv.fract.v2f16", glsl::ExtInst::ExtInstFract)
+      .Case("clspv.fract.v3f16", glsl::ExtInst::ExtInstFract)
+      .Case("clspv.fract.v4f16", glsl::ExtInst::ExtInstFract)
       .Default(kGlslExtInstBad);
 }
 
@@ -5271,20 +5566,32 @@ glsl::ExtInst SPIRVProducerPass::getIndirectExtInstEnum(StringRef Name) {
   // Check indirect cases.
   return StringSwitch<glsl::ExtInst>(Name)
       .StartsWith("_Z3clz", glsl::ExtInst::ExtInstFindUMsb)
-      // Use exact match on float arg because these need a multiply
-      // of a constant of the right floating point type.
+      // Use exact match on float and half args because these need a
+      // multiply of a constant of the right floating point type.
       .Case("_Z6acospif", glsl::ExtInst::ExtInstAcos)
       .Case("_Z6acospiDv2_f", glsl::ExtInst::ExtInstAcos)
       .Case("_Z6acospiDv3_f", glsl::ExtInst::ExtInstAcos)
       .Case("_Z6acospiDv4_f", glsl::ExtInst::ExtInstAcos)
+      .Case("_Z6acospiDh", glsl::ExtInst::ExtInstAcos)
+      .Case("_Z6acospiDv2_Dh", glsl::ExtInst::ExtInstAcos)
+      .Case("_Z6acospiDv3_Dh", glsl::ExtInst::ExtInstAcos)
+      .Case("_Z6acospiDv4_Dh", glsl::ExtInst::ExtInstAcos)
       .Case("_Z6asinpif", glsl::ExtInst::ExtInstAsin)
       .Case("_Z6asinpiDv2_f", glsl::ExtInst::ExtInstAsin)
       .Case("_Z6asinpiDv3_f", glsl::ExtInst::ExtInstAsin)
       .Case("_Z6asinpiDv4_f", glsl::ExtInst::ExtInstAsin)
+      .Case("_Z6asinpiDh", glsl::ExtInst::ExtInstAsin)
+      .Case("_Z6asinpiDv2_Dh", glsl::ExtInst::ExtInstAsin)
+      .Case("_Z6asinpiDv3_Dh", glsl::ExtInst::ExtInstAsin)
+      .Case("_Z6asinpiDv4_Dh", glsl::ExtInst::ExtInstAsin)
       .Case("_Z7atan2piff", glsl::ExtInst::ExtInstAtan2)
       .Case("_Z7atan2piDv2_fS_", glsl::ExtInst::ExtInstAtan2)
       .Case("_Z7atan2piDv3_fS_", glsl::ExtInst::ExtInstAtan2)
       .Case("_Z7atan2piDv4_fS_", glsl::ExtInst::ExtInstAtan2)
+      .Case("_Z7atan2piDhDh", glsl::ExtInst::ExtInstAtan2)
+      .Case("_Z7atan2piDv2_DhS_", glsl::ExtInst::ExtInstAtan2)
+      .Case("_Z7atan2piDv3_DhS_", glsl::ExtInst::ExtInstAtan2)
+      .Case("_Z7atan2piDv4_DhS_", glsl::ExtInst::ExtInstAtan2)
       .Default(kGlslExtInstBad);
 }
 
@@ -5295,40 +5602,43 @@ glsl::ExtInst SPIRVProducerPass::getDirectOrIndirectExtInstEnum(StringRef Name)
   return getIndirectExtInstEnum(Name);
 }
 
-void SPIRVProducerPass::PrintResID(SPIRVInstruction *Inst) {
-  out << "%" << Inst->getResultID();
-}
-
-void SPIRVProducerPass::PrintOpcode(SPIRVInstruction *Inst) {
-  spv::Op Opcode = static_cast<spv::Op>(Inst->getOpcode());
-  out << "\t" << spv::getOpName(Opcode);
-}
-
-void SPIRVProducerPass::PrintOperand(SPIRVOperand *Op) {
-  SPIRVOperandType OpTy = Op->getType();
-  switch (OpTy) {
-  default: {
-    llvm_unreachable("Unsupported SPIRV Operand Type???");
-    break;
+void SPIRVProducerPass::PrintOperand(grammar::OperandKind Kind,
+                                     const SPIRVOperand &Op) {
+  if (Kind == grammar::OperandKindLiteralExtInstInteger) {
+    // The only extended instruction set we import is GLSL.std.450.
+    out << glsl::getExtInstName(static_cast<glsl::ExtInst>(Op.getNumID()));
+    return;
   }
+  if (Kind != grammar::OperandKindNone) {
+    switch (grammar::kOperandKinds[Kind].Category) {
+    case grammar::OperandCategoryValueEnum:
+    case grammar::OperandCategoryBitEnum:
+      PrintEnumerant(Kind, Op.getNumID());
+      return;
+    default:
+      break;
+    }
+  }
+
+  switch (Op.getType()) {
   case SPIRVOperandType::NUMBERID: {
-    out << "%" << Op->getNumID();
+    out << "%" << Op.getNumID();
     break;
   }
   case SPIRVOperandType::LITERAL_STRING: {
-    out << "\"" << Op->getLiteralStr() << "\"";
+    out << "\"" << Op.getLiteralStr() << "\"";
     break;
   }
   case SPIRVOperandType::LITERAL_INTEGER: {
     // TODO: Handle LiteralNum carefully.
-    for (auto Word : Op->getLiteralNum()) {
+    for (auto Word : Op.getLiteralNum()) {
       out << Word;
     }
     break;
   }
   case SPIRVOperandType::LITERAL_FLOAT: {
     // TODO: Handle LiteralNum carefully.
-    for (auto Word : Op->getLiteralNum()) {
+    for (auto Word : Op.getLiteralNum()) {
       APFloat APF = APFloat(APFloat::IEEEsingle(), APInt(32, Word));
       SmallString<8> Str;
       APF.toString(Str, 6, 2);
@@ -5336,747 +5646,107 @@ void SPIRVProducerPass::PrintOperand(SPIRVOperand *Op) {
     }
     break;
   }
+  case SPIRVOperandType::LITERAL_HALF: {
+    APFloat APF = APFloat(APFloat::IEEEhalf(), APInt(16, Op.getNumID()));
+    SmallString<8> Str;
+    APF.toString(Str, 6, 2);
+    out << Str;
+    break;
+  }
   }
 }
 
-void SPIRVProducerPass::PrintCapability(SPIRVOperand *Op) {
-  spv::Capability Cap = static_cast<spv::Capability>(Op->getNumID());
-  out << spv::getCapabilityName(Cap);
-}
-
-void SPIRVProducerPass::PrintExtInst(SPIRVOperand *Op) {
-  auto LiteralNum = Op->getLiteralNum();
-  glsl::ExtInst Ext = static_cast<glsl::ExtInst>(LiteralNum[0]);
-  out << glsl::getExtInstName(Ext);
-}
-
-void SPIRVProducerPass::PrintAddrModel(SPIRVOperand *Op) {
-  spv::AddressingModel AddrModel =
-      static_cast<spv::AddressingModel>(Op->getNumID());
-  out << spv::getAddressingModelName(AddrModel);
-}
-
-void SPIRVProducerPass::PrintMemModel(SPIRVOperand *Op) {
-  spv::MemoryModel MemModel = static_cast<spv::MemoryModel>(Op->getNumID());
-  out << spv::getMemoryModelName(MemModel);
-}
-
-void SPIRVProducerPass::PrintExecModel(SPIRVOperand *Op) {
-  spv::ExecutionModel ExecModel =
-      static_cast<spv::ExecutionModel>(Op->getNumID());
-  out << spv::getExecutionModelName(ExecModel);
-}
-
-void SPIRVProducerPass::PrintExecMode(SPIRVOperand *Op) {
-  spv::ExecutionMode ExecMode = static_cast<spv::ExecutionMode>(Op->getNumID());
-  out << spv::getExecutionModeName(ExecMode);
-}
-
-void SPIRVProducerPass::PrintSourceLanguage(SPIRVOperand *Op) {
-  spv::SourceLanguage SourceLang = static_cast<spv::SourceLanguage>(Op->getNumID());
-  out << spv::getSourceLanguageName(SourceLang);
-}
-
-void SPIRVProducerPass::PrintFuncCtrl(SPIRVOperand *Op) {
-  spv::FunctionControlMask FuncCtrl =
-      static_cast<spv::FunctionControlMask>(Op->getNumID());
-  out << spv::getFunctionControlName(FuncCtrl);
-}
-
-void SPIRVProducerPass::PrintStorageClass(SPIRVOperand *Op) {
-  spv::StorageClass StClass = static_cast<spv::StorageClass>(Op->getNumID());
-  out << getStorageClassName(StClass);
-}
-
-void SPIRVProducerPass::PrintDecoration(SPIRVOperand *Op) {
-  spv::Decoration Deco = static_cast<spv::Decoration>(Op->getNumID());
-  out << getDecorationName(Deco);
-}
-
-void SPIRVProducerPass::PrintBuiltIn(SPIRVOperand *Op) {
-  spv::BuiltIn BIn = static_cast<spv::BuiltIn>(Op->getNumID());
-  out << getBuiltInName(BIn);
-}
-
-void SPIRVProducerPass::PrintSelectionControl(SPIRVOperand *Op) {
-  spv::SelectionControlMask BIn =
-      static_cast<spv::SelectionControlMask>(Op->getNumID());
-  out << getSelectionControlName(BIn);
-}
-
-void SPIRVProducerPass::PrintLoopControl(SPIRVOperand *Op) {
-  spv::LoopControlMask BIn = static_cast<spv::LoopControlMask>(Op->getNumID());
-  out << getLoopControlName(BIn);
-}
-
-void SPIRVProducerPass::PrintDimensionality(SPIRVOperand *Op) {
-  spv::Dim DIM = static_cast<spv::Dim>(Op->getNumID());
-  out << getDimName(DIM);
-}
-
-void SPIRVProducerPass::PrintImageFormat(SPIRVOperand *Op) {
-  spv::ImageFormat Format = static_cast<spv::ImageFormat>(Op->getNumID());
-  out << getImageFormatName(Format);
-}
-
-void SPIRVProducerPass::PrintMemoryAccess(SPIRVOperand *Op) {
-  out << spv::getMemoryAccessName(
-      static_cast<spv::MemoryAccessMask>(Op->getNumID()));
-}
+void SPIRVProducerPass::PrintEnumerant(grammar::OperandKind Kind,
+                                       uint32_t Value) {
+  if (const grammar::Enumerant *E = grammar::getEnumerant(Kind, Value)) {
+    out << E->Name;
+    return;
+  }
 
-void SPIRVProducerPass::PrintImageOperandsType(SPIRVOperand *Op) {
-  auto LiteralNum = Op->getLiteralNum();
-  spv::ImageOperandsMask Type =
-      static_cast<spv::ImageOperandsMask>(LiteralNum[0]);
-  out << getImageOperandsName(Type);
+  // Masks combining several bits are spelled out one bit at a time.
+  if (grammar::kOperandKinds[Kind].Category ==
+      grammar::OperandCategoryBitEnum) {
+    StringRef Separator = "";
+    for (uint32_t Bit = 1; Bit && Bit <= Value; Bit <<= 1) {
+      const grammar::Enumerant *E = grammar::getEnumerant(Kind, Bit);
+      if ((Value & Bit) && E) {
+        out << Separator << E->Name;
+        Separator = "|";
+      }
+    }
+  }
 }
 
 void SPIRVProducerPass::WriteSPIRVAssembly() {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-
-  for (auto Inst : SPIRVInstList) {
-    SPIRVOperandList Ops = Inst->getOperands();
-    spv::Op Opcode = static_cast<spv::Op>(Inst->getOpcode());
-
-    switch (Opcode) {
-    default: {
-      llvm_unreachable("Unsupported SPIRV instruction");
-      break;
-    }
-    case spv::OpCapability: {
-      // Ops[0] = Capability
-      PrintOpcode(Inst);
-      out << " ";
-      PrintCapability(Ops[0]);
-      out << "\n";
-      break;
-    }
-    case spv::OpMemoryModel: {
-      // Ops[0] = Addressing Model
-      // Ops[1] = Memory Model
-      PrintOpcode(Inst);
-      out << " ";
-      PrintAddrModel(Ops[0]);
-      out << " ";
-      PrintMemModel(Ops[1]);
-      out << "\n";
-      break;
-    }
-    case spv::OpEntryPoint: {
-      // Ops[0] = Execution Model
-      // Ops[1] = EntryPoint ID
-      // Ops[2] = Name (Literal String)
-      // Ops[3] ... Ops[n] = Interface ID
-      PrintOpcode(Inst);
-      out << " ";
-      PrintExecModel(Ops[0]);
-      for (uint32_t i = 1; i < Ops.size(); i++) {
-        out << " ";
-        PrintOperand(Ops[i]);
+  for (auto &SPIRVInstList : SPIRVSections) {
+    for (auto Inst : SPIRVInstList) {
+      const grammar::Instruction &Grammar = GetGrammar(Inst->getOpcode());
+      if (Grammar.HasResult) {
+        out << "%" << Inst->getResultID() << " = ";
       }
-      out << "\n";
-      break;
-    }
-    case spv::OpExecutionMode: {
-      // Ops[0] = Entry Point ID
-      // Ops[1] = Execution Mode
-      // Ops[2] ... Ops[n] = Optional literals according to Execution Mode
-      PrintOpcode(Inst);
-      out << " ";
-      PrintOperand(Ops[0]);
-      out << " ";
-      PrintExecMode(Ops[1]);
-      for (uint32_t i = 2; i < Ops.size(); i++) {
-        out << " ";
-        PrintOperand(Ops[i]);
-      }
-      out << "\n";
-      break;
-    }
-    case spv::OpSource: {
-      // Ops[0] = SourceLanguage ID
-      // Ops[1] = Version (LiteralNum)
-      PrintOpcode(Inst);
-      out << " ";
-      PrintSourceLanguage(Ops[0]);
-      out << " ";
-      PrintOperand(Ops[1]);
-      out << "\n";
-      break;
-    }
-    case spv::OpDecorate: {
-      // Ops[0] = Target ID
-      // Ops[1] = Decoration (Block or BufferBlock)
-      // Ops[2] ... Ops[n] = Optional literals according to Decoration
-      PrintOpcode(Inst);
-      out << " ";
-      PrintOperand(Ops[0]);
-      out << " ";
-      PrintDecoration(Ops[1]);
-      // Handle BuiltIn OpDecorate specially.
-      if (Ops[1]->getNumID() == spv::DecorationBuiltIn) {
-        out << " ";
-        PrintBuiltIn(Ops[2]);
-      } else {
-        for (uint32_t i = 2; i < Ops.size(); i++) {
-          out << " ";
-          PrintOperand(Ops[i]);
+      out << "\t" << Grammar.Name;
+
+      // Match each operand against the kind the grammar expects next.  A '*'
+      // kind covers all the remaining operands, and an enumerant may bring
+      // its own parameters, like the BuiltIn of a BuiltIn decoration.
+      ArrayRef<grammar::Operand> Kinds(
+          grammar::kOperands + Grammar.FirstOperand, Grammar.NumOperands);
+      ArrayRef<grammar::Operand> Params;
+      SPIRVOperandList Ops = Inst->getOperands();
+      for (const SPIRVOperand &Op : Ops.getOperands()) {
+        grammar::OperandKind Kind = grammar::OperandKindNone;
+        if (!Params.empty()) {
+          Kind = Params.front().Kind;
+          Params = Params.drop_front();
+        } else if (!Kinds.empty()) {
+          Kind = Kinds.front().Kind;
+          if (Kinds.front().Quantifier != '*') {
+            Kinds = Kinds.drop_front();
+          }
+          switch (grammar::kOperandKinds[Kind].Category) {
+          case grammar::OperandCategoryValueEnum:
+          case grammar::OperandCategoryBitEnum:
+            if (const grammar::Enumerant *E =
+                    grammar::getEnumerant(Kind, Op.getNumID())) {
+              Params = makeArrayRef(grammar::kOperands + E->FirstParameter,
+                                    E->NumParameters);
+            }
+            break;
+          default:
+            break;
+          }
         }
-      }
-      out << "\n";
-      break;
-    }
-    case spv::OpMemberDecorate: {
-      // Ops[0] = Structure Type ID
-      // Ops[1] = Member Index(Literal Number)
-      // Ops[2] = Decoration
-      // Ops[3] ... Ops[n] = Optional literals according to Decoration
-      PrintOpcode(Inst);
-      out << " ";
-      PrintOperand(Ops[0]);
-      out << " ";
-      PrintOperand(Ops[1]);
-      out << " ";
-      PrintDecoration(Ops[2]);
-      for (uint32_t i = 3; i < Ops.size(); i++) {
-        out << " ";
-        PrintOperand(Ops[i]);
-      }
-      out << "\n";
-      break;
-    }
-    case spv::OpTypePointer: {
-      // Ops[0] = Storage Class
-      // Ops[1] = Element Type ID
-      PrintResID(Inst);
-      out << " = ";
-      PrintOpcode(Inst);
-      out << " ";
-      PrintStorageClass(Ops[0]);
-      out << " ";
-      PrintOperand(Ops[1]);
-      out << "\n";
-      break;
-    }
-    case spv::OpTypeImage: {
-      // Ops[0] = Sampled Type ID
-      // Ops[1] = Dim ID
-      // Ops[2] = Depth (Literal Number)
-      // Ops[3] = Arrayed (Literal Number)
-      // Ops[4] = MS (Literal Number)
-      // Ops[5] = Sampled (Literal Number)
-      // Ops[6] = Image Format ID
-      PrintResID(Inst);
-      out << " = ";
-      PrintOpcode(Inst);
-      out << " ";
-      PrintOperand(Ops[0]);
-      out << " ";
-      PrintDimensionality(Ops[1]);
-      out << " ";
-      PrintOperand(Ops[2]);
-      out << " ";
-      PrintOperand(Ops[3]);
-      out << " ";
-      PrintOperand(Ops[4]);
-      out << " ";
-      PrintOperand(Ops[5]);
-      out << " ";
-      PrintImageFormat(Ops[6]);
-      out << "\n";
-      break;
-    }
-    case spv::OpFunction: {
-      // Ops[0] : Result Type ID
-      // Ops[1] : Function Control
-      // Ops[2] : Function Type ID
-      PrintResID(Inst);
-      out << " = ";
-      PrintOpcode(Inst);
-      out << " ";
-      PrintOperand(Ops[0]);
-      out << " ";
-      PrintFuncCtrl(Ops[1]);
-      out << " ";
-      PrintOperand(Ops[2]);
-      out << "\n";
-      break;
-    }
-    case spv::OpSelectionMerge: {
-      // Ops[0] = Merge Block ID
-      // Ops[1] = Selection Control
-      PrintOpcode(Inst);
-      out << " ";
-      PrintOperand(Ops[0]);
-      out << " ";
-      PrintSelectionControl(Ops[1]);
-      out << "\n";
-      break;
-    }
-    case spv::OpLoopMerge: {
-      // Ops[0] = Merge Block ID
-      // Ops[1] = Continue Target ID
-      // Ops[2] = Selection Control
-      PrintOpcode(Inst);
-      out << " ";
-      PrintOperand(Ops[0]);
-      out << " ";
-      PrintOperand(Ops[1]);
-      out << " ";
-      PrintLoopControl(Ops[2]);
-      out << "\n";
-      break;
-    }
-    case spv::OpImageSampleExplicitLod: {
-      // Ops[0] = Result Type ID
-      // Ops[1] = Sampled Image ID
-      // Ops[2] = Coordinate ID
-      // Ops[3] = Image Operands Type ID
-      // Ops[4] ... Ops[n] = Operands ID
-      PrintResID(Inst);
-      out << " = ";
-      PrintOpcode(Inst);
-      for (uint32_t i = 0; i < 3; i++) {
-        out << " ";
-        PrintOperand(Ops[i]);
-      }
-      out << " ";
-      PrintImageOperandsType(Ops[3]);
-      for (uint32_t i = 4; i < Ops.size(); i++) {
-        out << " ";
-        PrintOperand(Ops[i]);
-      }
-      out << "\n";
-      break;
-    }
-    case spv::OpVariable: {
-      // Ops[0] : Result Type ID
-      // Ops[1] : Storage Class
-      // Ops[2] ... Ops[n] = Initializer IDs
-      PrintResID(Inst);
-      out << " = ";
-      PrintOpcode(Inst);
-      out << " ";
-      PrintOperand(Ops[0]);
-      out << " ";
-      PrintStorageClass(Ops[1]);
-      for (uint32_t i = 2; i < Ops.size(); i++) {
-        out << " ";
-        PrintOperand(Ops[i]);
-      }
-      out << "\n";
-      break;
-    }
-    case spv::OpExtInst: {
-      // Ops[0] = Result Type ID
-      // Ops[1] = Set ID (OpExtInstImport ID)
-      // Ops[2] = Instruction Number (Literal Number)
-      // Ops[3] ... Ops[n] = Operand 1, ... , Operand n
-      PrintResID(Inst);
-      out << " = ";
-      PrintOpcode(Inst);
-      out << " ";
-      PrintOperand(Ops[0]);
-      out << " ";
-      PrintOperand(Ops[1]);
-      out << " ";
-      PrintExtInst(Ops[2]);
-      for (uint32_t i = 3; i < Ops.size(); i++) {
-        out << " ";
-        PrintOperand(Ops[i]);
-      }
-      out << "\n";
-      break;
-    }
-    case spv::OpCopyMemory: {
-      // Ops[0] = Addressing Model
-      // Ops[1] = Memory Model
-      PrintOpcode(Inst);
-      out << " ";
-      PrintOperand(Ops[0]);
-      out << " ";
-      PrintOperand(Ops[1]);
-      out << " ";
-      PrintMemoryAccess(Ops[2]);
-      out << " ";
-      PrintOperand(Ops[3]);
-      out << "\n";
-      break;
-    }
-    case spv::OpExtension:
-    case spv::OpControlBarrier:
-    case spv::OpMemoryBarrier:
-    case spv::OpBranch:
-    case spv::OpBranchConditional:
-    case spv::OpStore:
-    case spv::OpImageWrite:
-    case spv::OpReturnValue:
-    case spv::OpReturn:
-    case spv::OpFunctionEnd: {
-      PrintOpcode(Inst);
-      for (uint32_t i = 0; i < Ops.size(); i++) {
-        out << " ";
-        PrintOperand(Ops[i]);
-      }
-      out << "\n";
-      break;
-    }
-    case spv::OpExtInstImport:
-    case spv::OpTypeRuntimeArray:
-    case spv::OpTypeStruct:
-    case spv::OpTypeSampler:
-    case spv::OpTypeSampledImage:
-    case spv::OpTypeInt:
-    case spv::OpTypeFloat:
-    case spv::OpTypeArray:
-    case spv::OpTypeVector:
-    case spv::OpTypeBool:
-    case spv::OpTypeVoid:
-    case spv::OpTypeFunction:
-    case spv::OpFunctionParameter:
-    case spv::OpLabel:
-    case spv::OpPhi:
-    case spv::OpLoad:
-    case spv::OpSelect:
-    case spv::OpAccessChain:
-    case spv::OpPtrAccessChain:
-    case spv::OpInBoundsAccessChain:
-    case spv::OpUConvert:
-    case spv::OpSConvert:
-    case spv::OpConvertFToU:
-    case spv::OpConvertFToS:
-    case spv::OpConvertUToF:
-    case spv::OpConvertSToF:
-    case spv::OpFConvert:
-    case spv::OpConvertPtrToU:
-    case spv::OpConvertUToPtr:
-    case spv::OpBitcast:
-    case spv::OpIAdd:
-    case spv::OpFAdd:
-    case spv::OpISub:
-    case spv::OpFSub:
-    case spv::OpIMul:
-    case spv::OpFMul:
-    case spv::OpUDiv:
-    case spv::OpSDiv:
-    case spv::OpFDiv:
-    case spv::OpUMod:
-    case spv::OpSRem:
-    case spv::OpFRem:
-    case spv::OpBitwiseOr:
-    case spv::OpBitwiseXor:
-    case spv::OpBitwiseAnd:
-    case spv::OpNot:
-    case spv::OpShiftLeftLogical:
-    case spv::OpShiftRightLogical:
-    case spv::OpShiftRightArithmetic:
-    case spv::OpBitCount:
-    case spv::OpCompositeConstruct:
-    case spv::OpCompositeExtract:
-    case spv::OpVectorExtractDynamic:
-    case spv::OpCompositeInsert:
-    case spv::OpCopyObject:
-    case spv::OpVectorInsertDynamic:
-    case spv::OpVectorShuffle:
-    case spv::OpIEqual:
-    case spv::OpINotEqual:
-    case spv::OpUGreaterThan:
-    case spv::OpUGreaterThanEqual:
-    case spv::OpULessThan:
-    case spv::OpULessThanEqual:
-    case spv::OpSGreaterThan:
-    case spv::OpSGreaterThanEqual:
-    case spv::OpSLessThan:
-    case spv::OpSLessThanEqual:
-    case spv::OpFOrdEqual:
-    case spv::OpFOrdGreaterThan:
-    case spv::OpFOrdGreaterThanEqual:
-    case spv::OpFOrdLessThan:
-    case spv::OpFOrdLessThanEqual:
-    case spv::OpFOrdNotEqual:
-    case spv::OpFUnordEqual:
-    case spv::OpFUnordGreaterThan:
-    case spv::OpFUnordGreaterThanEqual:
-    case spv::OpFUnordLessThan:
-    case spv::OpFUnordLessThanEqual:
-    case spv::OpFUnordNotEqual:
-    case spv::OpSampledImage:
-    case spv::OpFunctionCall:
-    case spv::OpConstantTrue:
-    case spv::OpConstantFalse:
-    case spv::OpConstant:
-    case spv::OpSpecConstant:
-    case spv::OpConstantComposite:
-    case spv::OpSpecConstantComposite:
-    case spv::OpConstantNull:
-    case spv::OpLogicalOr:
-    case spv::OpLogicalAnd:
-    case spv::OpLogicalNot:
-    case spv::OpLogicalNotEqual:
-    case spv::OpUndef:
-    case spv::OpIsInf:
-    case spv::OpIsNan:
-    case spv::OpAny:
-    case spv::OpAll:
-    case spv::OpImageQuerySize:
-    case spv::OpAtomicIAdd:
-    case spv::OpAtomicISub:
-    case spv::OpAtomicExchange:
-    case spv::OpAtomicIIncrement:
-    case spv::OpAtomicIDecrement:
-    case spv::OpAtomicCompareExchange:
-    case spv::OpAtomicUMin:
-    case spv::OpAtomicSMin:
-    case spv::OpAtomicUMax:
-    case spv::OpAtomicSMax:
-    case spv::OpAtomicAnd:
-    case spv::OpAtomicOr:
-    case spv::OpAtomicXor:
-    case spv::OpDot: {
-      PrintResID(Inst);
-      out << " = ";
-      PrintOpcode(Inst);
-      for (uint32_t i = 0; i < Ops.size(); i++) {
+
         out << " ";
-        PrintOperand(Ops[i]);
+        PrintOperand(Kind, Op);
       }
       out << "\n";
-      break;
-    }
     }
   }
 }
 
-void SPIRVProducerPass::WriteOneWord(uint32_t Word) {
-  binaryOut->write(reinterpret_cast<const char *>(&Word), sizeof(uint32_t));
-}
-
-void SPIRVProducerPass::WriteResultID(SPIRVInstruction *Inst) {
-  WriteOneWord(Inst->getResultID());
-}
-
-void SPIRVProducerPass::WriteWordCountAndOpcode(SPIRVInstruction *Inst) {
-  // High 16 bit : Word Count
-  // Low 16 bit  : Opcode
-  uint32_t Word = Inst->getOpcode();
-  Word |= Inst->getWordCount() << 16;
-  WriteOneWord(Word);
-}
-
-void SPIRVProducerPass::WriteOperand(SPIRVOperand *Op) {
-  SPIRVOperandType OpTy = Op->getType();
-  switch (OpTy) {
-  default: {
-    llvm_unreachable("Unsupported SPIRV Operand Type???");
-    break;
-  }
-  case SPIRVOperandType::NUMBERID: {
-    WriteOneWord(Op->getNumID());
-    break;
-  }
-  case SPIRVOperandType::LITERAL_STRING: {
-    std::string Str = Op->getLiteralStr();
-    const char *Data = Str.c_str();
-    size_t WordSize = Str.size() / 4;
-    for (unsigned Idx = 0; Idx < WordSize; Idx++) {
-      WriteOneWord(*reinterpret_cast<const uint32_t *>(&Data[4 * Idx]));
-    }
-
-    uint32_t Remainder = Str.size() % 4;
-    uint32_t LastWord = 0;
-    if (Remainder) {
-      for (unsigned Idx = 0; Idx < Remainder; Idx++) {
-        LastWord |= Data[4 * WordSize + Idx] << 8 * Idx;
-      }
-    }
-
-    WriteOneWord(LastWord);
-    break;
-  }
-  case SPIRVOperandType::LITERAL_INTEGER:
-  case SPIRVOperandType::LITERAL_FLOAT: {
-    auto LiteralNum = Op->getLiteralNum();
-    // TODO: Handle LiteranNum carefully.
-    for (auto Word : LiteralNum) {
-      WriteOneWord(Word);
+void SPIRVProducerPass::WriteSPIRVBinary() {
+  // Instructions already hold their binary encoding.
+  for (auto &SPIRVInstList : SPIRVSections) {
+    for (auto Inst : SPIRVInstList) {
+      WriteWords(Inst->getWords());
     }
-    break;
   }
+
+  if (outputCInitList) {
+    out << "}\n";
   }
 }
 
-void SPIRVProducerPass::WriteSPIRVBinary() {
-  SPIRVInstructionList &SPIRVInstList = getSPIRVInstList();
-
-  for (auto Inst : SPIRVInstList) {
-    SPIRVOperandList Ops{Inst->getOperands()};
-    spv::Op Opcode = static_cast<spv::Op>(Inst->getOpcode());
-
-    switch (Opcode) {
-    default: {
-      errs() << "Unsupported SPIR-V instruction opcode " << int(Opcode) << "\n";
-      llvm_unreachable("Unsupported SPIRV instruction");
-      break;
-    }
-    case spv::OpCapability:
-    case spv::OpExtension:
-    case spv::OpMemoryModel:
-    case spv::OpEntryPoint:
-    case spv::OpExecutionMode:
-    case spv::OpSource:
-    case spv::OpDecorate:
-    case spv::OpMemberDecorate:
-    case spv::OpBranch:
-    case spv::OpBranchConditional:
-    case spv::OpSelectionMerge:
-    case spv::OpLoopMerge:
-    case spv::OpStore:
-    case spv::OpImageWrite:
-    case spv::OpReturnValue:
-    case spv::OpControlBarrier:
-    case spv::OpMemoryBarrier:
-    case spv::OpReturn:
-    case spv::OpFunctionEnd:
-    case spv::OpCopyMemory: {
-      WriteWordCountAndOpcode(Inst);
-      for (uint32_t i = 0; i < Ops.size(); i++) {
-        WriteOperand(Ops[i]);
-      }
-      break;
-    }
-    case spv::OpTypeBool:
-    case spv::OpTypeVoid:
-    case spv::OpTypeSampler:
-    case spv::OpLabel:
-    case spv::OpExtInstImport:
-    case spv::OpTypePointer:
-    case spv::OpTypeRuntimeArray:
-    case spv::OpTypeStruct:
-    case spv::OpTypeImage:
-    case spv::OpTypeSampledImage:
-    case spv::OpTypeInt:
-    case spv::OpTypeFloat:
-    case spv::OpTypeArray:
-    case spv::OpTypeVector:
-    case spv::OpTypeFunction: {
-      WriteWordCountAndOpcode(Inst);
-      WriteResultID(Inst);
-      for (uint32_t i = 0; i < Ops.size(); i++) {
-        WriteOperand(Ops[i]);
-      }
-      break;
-    }
-    case spv::OpFunction:
-    case spv::OpFunctionParameter:
-    case spv::OpAccessChain:
-    case spv::OpPtrAccessChain:
-    case spv::OpInBoundsAccessChain:
-    case spv::OpUConvert:
-    case spv::OpSConvert:
-    case spv::OpConvertFToU:
-    case spv::OpConvertFToS:
-    case spv::OpConvertUToF:
-    case spv::OpConvertSToF:
-    case spv::OpFConvert:
-    case spv::OpConvertPtrToU:
-    case spv::OpConvertUToPtr:
-    case spv::OpBitcast:
-    case spv::OpIAdd:
-    case spv::OpFAdd:
-    case spv::OpISub:
-    case spv::OpFSub:
-    case spv::OpIMul:
-    case spv::OpFMul:
-    case spv::OpUDiv:
-    case spv::OpSDiv:
-    case spv::OpFDiv:
-    case spv::OpUMod:
-    case spv::OpSRem:
-    case spv::OpFRem:
-    case spv::OpBitwiseOr:
-    case spv::OpBitwiseXor:
-    case spv::OpBitwiseAnd:
-    case spv::OpNot:
-    case spv::OpShiftLeftLogical:
-    case spv::OpShiftRightLogical:
-    case spv::OpShiftRightArithmetic:
-    case spv::OpBitCount:
-    case spv::OpCompositeConstruct:
-    case spv::OpCompositeExtract:
-    case spv::OpVectorExtractDynamic:
-    case spv::OpCompositeInsert:
-    case spv::OpCopyObject:
-    case spv::OpVectorInsertDynamic:
-    case spv::OpVectorShuffle:
-    case spv::OpIEqual:
-    case spv::OpINotEqual:
-    case spv::OpUGreaterThan:
-    case spv::OpUGreaterThanEqual:
-    case spv::OpULessThan:
-    case spv::OpULessThanEqual:
-    case spv::OpSGreaterThan:
-    case spv::OpSGreaterThanEqual:
-    case spv::OpSLessThan:
-    case spv::OpSLessThanEqual:
-    case spv::OpFOrdEqual:
-    case spv::OpFOrdGreaterThan:
-    case spv::OpFOrdGreaterThanEqual:
-    case spv::OpFOrdLessThan:
-    case spv::OpFOrdLessThanEqual:
-    case spv::OpFOrdNotEqual:
-    case spv::OpFUnordEqual:
-    case spv::OpFUnordGreaterThan:
-    case spv::OpFUnordGreaterThanEqual:
-    case spv::OpFUnordLessThan:
-    case spv::OpFUnordLessThanEqual:
-    case spv::OpFUnordNotEqual:
-    case spv::OpExtInst:
-    case spv::OpIsInf:
-    case spv::OpIsNan:
-    case spv::OpAny:
-    case spv::OpAll:
-    case spv::OpUndef:
-    case spv::OpConstantNull:
-    case spv::OpLogicalOr:
-    case spv::OpLogicalAnd:
-    case spv::OpLogicalNot:
-    case spv::OpLogicalNotEqual:
-    case spv::OpConstantComposite:
-    case spv::OpSpecConstantComposite:
-    case spv::OpConstantTrue:
-    case spv::OpConstantFalse:
-    case spv::OpConstant:
-    case spv::OpSpecConstant:
-    case spv::OpVariable:
-    case spv::OpFunctionCall:
-    case spv::OpSampledImage:
-    case spv::OpImageSampleExplicitLod:
-    case spv::OpImageQuerySize:
-    case spv::OpSelect:
-    case spv::OpPhi:
-    case spv::OpLoad:
-    case spv::OpAtomicIAdd:
-    case spv::OpAtomicISub:
-    case spv::OpAtomicExchange:
-    case spv::OpAtomicIIncrement:
-    case spv::OpAtomicIDecrement:
-    case spv::OpAtomicCompareExchange:
-    case spv::OpAtomicUMin:
-    case spv::OpAtomicSMin:
-    case spv::OpAtomicUMax:
-    case spv::OpAtomicSMax:
-    case spv::OpAtomicAnd:
-    case spv::OpAtomicOr:
-    case spv::OpAtomicXor:
-    case spv::OpDot: {
-      WriteWordCountAndOpcode(Inst);
-      WriteOperand(Ops[0]);
-      WriteResultID(Inst);
-      for (uint32_t i = 1; i < Ops.size(); i++) {
-        WriteOperand(Ops[i]);
-      }
-      break;
-    }
+void SPIRVProducerPass::WriteWords(ArrayRef<uint32_t> Words) {
+  if (outputCInitList) {
+    // Format the words straight into |out|, after the first word of the
+    // initializer list.
+    for (uint32_t Word : Words) {
+      out << ",\n" << Word;
     }
+  } else {
+    out.write(reinterpret_cast<const char *>(Words.data()),
+              Words.size() * sizeof(uint32_t));
   }
 }
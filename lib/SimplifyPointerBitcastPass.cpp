@@ -15,8 +15,11 @@
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/ValueHandle.h>
 #include <llvm/Pass.h>
 
+#include <algorithm>
+
 using namespace llvm;
 
 #define DEBUG_TYPE "SimplifyPointerBitcast"
@@ -28,10 +31,21 @@ struct SimplifyPointerBitcastPass : public ModulePass {
 
   bool runOnModule(Module &M) override;
 
-  bool runOnTrivialBitcast(Module &M) const;
-  bool runOnBitcastFromBitcast(Module &M) const;
-  bool runOnBitcastFromGEP(Module &M) const;
-  bool runOnGEPFromGEP(Module &M) const;
+  // Each of these simplifies a single instruction, if it matches, and then
+  // pushes the instructions the simplification could have made simplifiable
+  // onto WorkList.  They return true if they simplified the instruction, in
+  // which case it has been erased.
+  bool runOnTrivialBitcast(BitCastInst *Bitcast);
+  bool runOnBitcastFromBitcast(BitCastInst *Bitcast);
+  bool runOnBitcastFromGEP(BitCastInst *Bitcast);
+  bool runOnGEPFromGEP(GetElementPtrInst *GEP);
+
+  // Pushes |V|, if it is an instruction, and its users onto WorkList.
+  void pushWithUsers(Value *V);
+
+  // The instructions left to simplify.  The handles are nulled when the
+  // instructions are erased.
+  SmallVector<WeakVH, 16> WorkList;
 };
 }
 
@@ -48,244 +62,225 @@ llvm::ModulePass *createSimplifyPointerBitcastPass() {
 bool SimplifyPointerBitcastPass::runOnModule(Module &M) {
   bool Changed = false;
 
-  // Loop through our individual simplification passes until they stop changing
-  // things.
-  for (bool localChanged = true; localChanged; Changed |= localChanged) {
-    localChanged = false;
-
-    localChanged |= runOnTrivialBitcast(M);
-    localChanged |= runOnBitcastFromGEP(M);
-    localChanged |= runOnBitcastFromBitcast(M);
-    localChanged |= runOnGEPFromGEP(M);
-  }
-
-  return Changed;
-}
-
-bool SimplifyPointerBitcastPass::runOnTrivialBitcast(Module &M) const {
-  // Remove things like:
-  //  bitcast i32 addrspace(1)* %ptr to i32 addrspace(1)*
-
-  SmallVector<BitCastInst *, 16> WorkList;
+  // Seed the worklist with every bitcast and GEP once.  From then on, only the
+  // instructions a simplification creates or changes the operands of are
+  // looked at again, so a chain of casts is simplified in linear time.
   for (Function &F : M) {
     for (BasicBlock &BB : F) {
       for (Instruction &I : BB) {
-        // If we have a bitcast instruction...
-        if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
-          // ... whose source type is the same as the destination type.
-          auto Source = Bitcast->getOperand(0);
-          if (Source->getType() == Bitcast->getType()) {
-            // ... record the bitcast as something we need to process.
-            WorkList.push_back(Bitcast);
-          }
+        if (isa<BitCastInst>(I) || isa<GetElementPtrInst>(I)) {
+          WorkList.push_back(&I);
         }
       }
     }
   }
 
-  const bool Changed = !WorkList.empty();
-
-  for (auto Bitcast : WorkList) {
-    auto Source = Bitcast->getOperand(0);
-    Bitcast->replaceAllUsesWith(Source);
+  // Simplify them in order.
+  std::reverse(WorkList.begin(), WorkList.end());
 
-    // Remove the bitcast as it has no users now.
-    Bitcast->eraseFromParent();
+  while (!WorkList.empty()) {
+    Value *V = WorkList.pop_back_val();
 
-    // Check if the source value is an instruction and had no other users...
-    if (auto SourceInst = dyn_cast<Instruction>(Source)) {
-      if (0 == SourceInst->getNumUses()) {
-        // ... and remove it if we were its only user.
-        SourceInst->eraseFromParent();
-      }
+    if (auto Bitcast = dyn_cast_or_null<BitCastInst>(V)) {
+      Changed |= runOnTrivialBitcast(Bitcast) ||
+                 runOnBitcastFromGEP(Bitcast) ||
+                 runOnBitcastFromBitcast(Bitcast);
+    } else if (auto GEP = dyn_cast_or_null<GetElementPtrInst>(V)) {
+      Changed |= runOnGEPFromGEP(GEP);
     }
   }
 
   return Changed;
 }
 
-bool SimplifyPointerBitcastPass::runOnBitcastFromGEP(Module &M) const {
-  SmallVector<BitCastInst *, 16> WorkList;
-  for (Function &F : M) {
-    for (BasicBlock &BB : F) {
-      for (Instruction &I : BB) {
-        // If we have a bitcast instruction...
-        if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
-          // ... whose source is a GEP instruction...
-          if (auto GEP = dyn_cast<GetElementPtrInst>(Bitcast->getOperand(0))) {
-            // ... where the GEP is retrieving an element of the same type...
-            if (GEP->getSourceElementType() == GEP->getResultElementType()) {
-              auto GEPTy = GEP->getResultElementType();
-              auto BitcastTy = Bitcast->getType()->getPointerElementType();
-              // ... and the types have a known compile time size...
-              if ((0 != GEPTy->getPrimitiveSizeInBits()) &&
-                  (0 != BitcastTy->getPrimitiveSizeInBits())) {
-                // ... record the bitcast as something we need to process.
-                WorkList.push_back(Bitcast);
-              }
-            }
-          }
-        }
-      }
-    }
+void SimplifyPointerBitcastPass::pushWithUsers(Value *V) {
+  if (isa<Instruction>(V)) {
+    WorkList.push_back(V);
   }
 
-  const bool Changed = !WorkList.empty();
-
-  for (auto Bitcast : WorkList) {
-    auto BitcastTy = Bitcast->getType();
-    auto BitcastElementTy = BitcastTy->getPointerElementType();
-
-    auto GEP = cast<GetElementPtrInst>(Bitcast->getOperand(0));
-
-    auto SrcTySize = GEP->getResultElementType()->getPrimitiveSizeInBits();
-    auto DstTySize = BitcastElementTy->getPrimitiveSizeInBits();
-
-    SmallVector<Value *, 4> GEPArgs(GEP->idx_begin(), GEP->idx_end());
-
-    // If the source type is smaller than the destination type...
-    if (SrcTySize < DstTySize) {
-      // ... we need to divide the last index of the GEP by the size difference.
-      auto LastIndex = GEPArgs.back();
-      GEPArgs.back() = BinaryOperator::Create(
-          Instruction::SDiv, LastIndex,
-          ConstantInt::get(LastIndex->getType(), DstTySize / SrcTySize), "",
-          Bitcast);
-    } else if (SrcTySize > DstTySize) {
-      // ... we need to multiply the last index of the GEP by the size
-      // difference.
-      auto LastIndex = GEPArgs.back();
-      GEPArgs.back() = BinaryOperator::Create(
-          Instruction::Mul, LastIndex,
-          ConstantInt::get(LastIndex->getType(), SrcTySize / DstTySize), "",
-          Bitcast);
-    } else {
-      // ... the arguments are the same size, nothing to do!
+  for (User *U : V->users()) {
+    if (isa<BitCastInst>(U) || isa<GetElementPtrInst>(U)) {
+      WorkList.push_back(U);
     }
+  }
+}
 
-    // Create a new bitcast from the GEP argument to the bitcast type.
-    auto NewBitcast = CastInst::CreatePointerCast(GEP->getPointerOperand(),
-                                                  BitcastTy, "", Bitcast);
+bool SimplifyPointerBitcastPass::runOnTrivialBitcast(BitCastInst *Bitcast) {
+  // Remove things like:
+  //  bitcast i32 addrspace(1)* %ptr to i32 addrspace(1)*
 
-    // Create a new GEP from the (maybe modified) GEPArgs.
-    auto NewGEP = GetElementPtrInst::Create(BitcastElementTy, NewBitcast,
-                                            GEPArgs, "", Bitcast);
+  // If the bitcast's source type is the same as the destination type...
+  auto Source = Bitcast->getOperand(0);
+  if (Source->getType() != Bitcast->getType()) {
+    return false;
+  }
 
-    // And replace the original bitcast with our replacement GEP.
-    Bitcast->replaceAllUsesWith(NewGEP);
+  Bitcast->replaceAllUsesWith(Source);
 
-    // Remove the bitcast as it has no users now.
-    Bitcast->eraseFromParent();
+  // Remove the bitcast as it has no users now.
+  Bitcast->eraseFromParent();
 
-    // Check if the old GEP had no other users...
-    if (0 == GEP->getNumUses()) {
+  // Check if the source value is an instruction and had no other users...
+  if (auto SourceInst = dyn_cast<Instruction>(Source)) {
+    if (0 == SourceInst->getNumUses()) {
       // ... and remove it if we were its only user.
-      GEP->eraseFromParent();
+      SourceInst->eraseFromParent();
+      return true;
     }
   }
 
-  return Changed;
+  // The users of the bitcast now use its source.
+  pushWithUsers(Source);
+
+  return true;
 }
 
-bool SimplifyPointerBitcastPass::runOnBitcastFromBitcast(Module &M) const {
-  SmallVector<BitCastInst *, 16> WorkList;
-  for (Function &F : M) {
-    for (BasicBlock &BB : F) {
-      for (Instruction &I : BB) {
-        // If we have a bitcast instruction...
-        if (auto Bitcast = dyn_cast<BitCastInst>(&I)) {
-          // ... whose source is a bitcast instruction...
-          if (isa<BitCastInst>(Bitcast->getOperand(0))) {
-            // ... record the bitcast as something we need to process.
-            WorkList.push_back(Bitcast);
-          }
-        }
-      }
-    }
+bool SimplifyPointerBitcastPass::runOnBitcastFromGEP(BitCastInst *Bitcast) {
+  // If the bitcast's source is a GEP instruction...
+  auto GEP = dyn_cast<GetElementPtrInst>(Bitcast->getOperand(0));
+  if (!GEP) {
+    return false;
   }
 
-  const bool Changed = !WorkList.empty();
+  // ... where the GEP is retrieving an element of the same type...
+  if (GEP->getSourceElementType() != GEP->getResultElementType()) {
+    return false;
+  }
 
-  for (auto Bitcast : WorkList) {
-    auto OtherBitcast = cast<BitCastInst>(Bitcast->getOperand(0));
+  auto BitcastTy = Bitcast->getType();
+  auto BitcastElementTy = BitcastTy->getPointerElementType();
 
-    if (OtherBitcast->getType() == Bitcast->getType()) {
-      Bitcast->replaceAllUsesWith(OtherBitcast);
-    } else {
-      // Create a new bitcast from the other bitcasts argument to our type.
-      auto NewBitcast = CastInst::CreatePointerCast(
-          OtherBitcast->getOperand(0), Bitcast->getType(), "", Bitcast);
+  auto SrcTySize = GEP->getResultElementType()->getPrimitiveSizeInBits();
+  auto DstTySize = BitcastElementTy->getPrimitiveSizeInBits();
 
-      // And replace the original bitcast with our replacement bitcast.
-      Bitcast->replaceAllUsesWith(NewBitcast);
-    }
+  // ... and the types have a known compile time size.
+  if ((0 == SrcTySize) || (0 == DstTySize)) {
+    return false;
+  }
 
-    // Remove the bitcast as it has no users now.
-    Bitcast->eraseFromParent();
+  SmallVector<Value *, 4> GEPArgs(GEP->idx_begin(), GEP->idx_end());
+
+  // If the source type is smaller than the destination type...
+  if (SrcTySize < DstTySize) {
+    // ... we need to divide the last index of the GEP by the size difference.
+    auto LastIndex = GEPArgs.back();
+    GEPArgs.back() = BinaryOperator::Create(
+        Instruction::SDiv, LastIndex,
+        ConstantInt::get(LastIndex->getType(), DstTySize / SrcTySize), "",
+        Bitcast);
+  } else if (SrcTySize > DstTySize) {
+    // ... we need to multiply the last index of the GEP by the size
+    // difference.
+    auto LastIndex = GEPArgs.back();
+    GEPArgs.back() = BinaryOperator::Create(
+        Instruction::Mul, LastIndex,
+        ConstantInt::get(LastIndex->getType(), SrcTySize / DstTySize), "",
+        Bitcast);
+  } else {
+    // ... the arguments are the same size, nothing to do!
+  }
 
-    // Check if the other bitcast had no other users...
-    if (0 == OtherBitcast->getNumUses()) {
-      // ... and remove it if we were its only user.
-      OtherBitcast->eraseFromParent();
-    }
+  // Create a new bitcast from the GEP argument to the bitcast type.
+  auto NewBitcast = CastInst::CreatePointerCast(GEP->getPointerOperand(),
+                                                BitcastTy, "", Bitcast);
+
+  // Create a new GEP from the (maybe modified) GEPArgs.
+  auto NewGEP = GetElementPtrInst::Create(BitcastElementTy, NewBitcast,
+                                          GEPArgs, "", Bitcast);
+
+  // And replace the original bitcast with our replacement GEP.
+  Bitcast->replaceAllUsesWith(NewGEP);
+
+  // Remove the bitcast as it has no users now.
+  Bitcast->eraseFromParent();
+
+  // Check if the old GEP had no other users...
+  if (0 == GEP->getNumUses()) {
+    // ... and remove it if we were its only user.
+    GEP->eraseFromParent();
   }
 
-  return Changed;
+  // The new bitcast may be from another bitcast, and the users of the new GEP
+  // may be GEPs or bitcasts of it.
+  WorkList.push_back(NewBitcast);
+  pushWithUsers(NewGEP);
+
+  return true;
 }
 
-bool SimplifyPointerBitcastPass::runOnGEPFromGEP(Module &M) const {
-  SmallVector<GetElementPtrInst *, 16> WorkList;
-  for (Function &F : M) {
-    for (BasicBlock &BB : F) {
-      for (Instruction &I : BB) {
-        // If we have a GEP instruction...
-        if (auto GEP = dyn_cast<GetElementPtrInst>(&I)) {
-          // ... whose operand is also a GEP instruction...
-          if (isa<GetElementPtrInst>(GEP->getPointerOperand())) {
-            // ... record the GEP as something we need to process.
-            WorkList.push_back(GEP);
-          }
-        }
-      }
-    }
+bool SimplifyPointerBitcastPass::runOnBitcastFromBitcast(
+    BitCastInst *Bitcast) {
+  // If the bitcast's source is a bitcast instruction...
+  auto OtherBitcast = dyn_cast<BitCastInst>(Bitcast->getOperand(0));
+  if (!OtherBitcast) {
+    return false;
   }
 
-  const bool Changed = !WorkList.empty();
+  Value *Replacement = OtherBitcast;
+  if (OtherBitcast->getType() != Bitcast->getType()) {
+    // Create a new bitcast from the other bitcasts argument to our type.
+    Replacement = CastInst::CreatePointerCast(OtherBitcast->getOperand(0),
+                                              Bitcast->getType(), "", Bitcast);
+  }
 
-  for (GetElementPtrInst *GEP : WorkList) {
-    IRBuilder<> Builder(GEP);
+  // And replace the original bitcast with our replacement.
+  Bitcast->replaceAllUsesWith(Replacement);
 
-    auto OtherGEP = cast<GetElementPtrInst>(GEP->getPointerOperand());
+  // Remove the bitcast as it has no users now.
+  Bitcast->eraseFromParent();
 
-    SmallVector<Value *, 8> Idxs;
+  // Check if the other bitcast had no other users...
+  if (0 == OtherBitcast->getNumUses()) {
+    // ... and remove it if we were its only user.
+    OtherBitcast->eraseFromParent();
+  }
 
-    Value *SrcLastIdxOp = OtherGEP->getOperand(OtherGEP->getNumOperands() - 1);
-    Value *GEPIdxOp = GEP->getOperand(1);
-    Value *MergedIdx = Builder.CreateAdd(SrcLastIdxOp, GEPIdxOp);
+  pushWithUsers(Replacement);
 
-    Idxs.append(OtherGEP->op_begin() + 1, OtherGEP->op_end() - 1);
-    Idxs.push_back(MergedIdx);
-    Idxs.append(GEP->op_begin() + 2, GEP->op_end());
+  return true;
+}
 
-    Value *NewGEP = nullptr;
-    if (GEP->isInBounds() && OtherGEP->isInBounds()) {
-      NewGEP = Builder.CreateInBoundsGEP(OtherGEP->getPointerOperand(), Idxs);
-    } else {
-      NewGEP = Builder.CreateGEP(OtherGEP->getPointerOperand(), Idxs);
-    }
+bool SimplifyPointerBitcastPass::runOnGEPFromGEP(GetElementPtrInst *GEP) {
+  // If the GEP's operand is also a GEP instruction...
+  auto OtherGEP = dyn_cast<GetElementPtrInst>(GEP->getPointerOperand());
+  if (!OtherGEP) {
+    return false;
+  }
 
-    // And replace the original GEP with our replacement GEP.
-    GEP->replaceAllUsesWith(NewGEP);
+  IRBuilder<> Builder(GEP);
 
-    // Remove the GEP as it has no users now.
-    GEP->eraseFromParent();
+  SmallVector<Value *, 8> Idxs;
 
-    // Check if the other GEP had no other users...
-    if (0 == OtherGEP->getNumUses()) {
-      // ... and remove it if we were its only user.
-      OtherGEP->eraseFromParent();
-    }
+  Value *SrcLastIdxOp = OtherGEP->getOperand(OtherGEP->getNumOperands() - 1);
+  Value *GEPIdxOp = GEP->getOperand(1);
+  Value *MergedIdx = Builder.CreateAdd(SrcLastIdxOp, GEPIdxOp);
+
+  Idxs.append(OtherGEP->op_begin() + 1, OtherGEP->op_end() - 1);
+  Idxs.push_back(MergedIdx);
+  Idxs.append(GEP->op_begin() + 2, GEP->op_end());
+
+  Value *NewGEP = nullptr;
+  if (GEP->isInBounds() && OtherGEP->isInBounds()) {
+    NewGEP = Builder.CreateInBoundsGEP(OtherGEP->getPointerOperand(), Idxs);
+  } else {
+    NewGEP = Builder.CreateGEP(OtherGEP->getPointerOperand(), Idxs);
   }
 
-  return Changed;
+  // And replace the original GEP with our replacement GEP.
+  GEP->replaceAllUsesWith(NewGEP);
+
+  // Remove the GEP as it has no users now.
+  GEP->eraseFromParent();
+
+  // Check if the other GEP had no other users...
+  if (0 == OtherGEP->getNumUses()) {
+    // ... and remove it if we were its only user.
+    OtherGEP->eraseFromParent();
+  }
+
+  // The new GEP may be from another GEP, and its users may be GEPs or
+  // bitcasts of it.
+  pushWithUsers(NewGEP);
+
+  return true;
 }
@@ -0,0 +1,84 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "StructuredControlFlow.h"
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/ErrorHandling.h"
+
+using namespace llvm;
+
+namespace clspv {
+
+StructuredControlFlow::StructuredControlFlow(Function &F,
+                                             const DominatorTree &DT,
+                                             const LoopInfo &LI) {
+  for (BasicBlock &BB : F) {
+    auto Br = dyn_cast<BranchInst>(BB.getTerminator());
+    if (!Br) {
+      continue;
+    }
+
+    if (LI.isLoopHeader(&BB)) {
+      Loop *L = LI.getLoopFor(&BB);
+      BasicBlock *MergeBB = L->getExitBlock();
+      if (!MergeBB) {
+        // StructurizeCFG pass converts CFG into triangle shape and the cfg
+        // has regions with single entry/exit. As a result, loop should not
+        // have multiple exits.
+        llvm_unreachable("Loop has multiple exits???");
+      }
+
+      BasicBlock *ContinueBB = nullptr;
+      if (L->isLoopLatch(&BB)) {
+        ContinueBB = &BB;
+      } else {
+        // From SPIR-V spec 2.11, Continue Target must dominate that back-edge
+        // block.
+        BasicBlock *Latch = L->getLoopLatch();
+        for (BasicBlock *LoopBB : L->blocks()) {
+          if (LoopBB == &BB) {
+            continue;
+          }
+
+          // Check whether block dominates block with back-edge.
+          if (DT.dominates(LoopBB, Latch)) {
+            ContinueBB = LoopBB;
+          }
+        }
+
+        if (!ContinueBB) {
+          llvm_unreachable("Wrong continue block from loop");
+        }
+      }
+
+      LoopMerges[&BB] = std::make_pair(MergeBB, ContinueBB);
+    } else if (Br->isConditional()) {
+      bool HasBackEdge = false;
+      for (unsigned i = 0; i < Br->getNumSuccessors(); i++) {
+        if (LI.isLoopHeader(Br->getSuccessor(i))) {
+          HasBackEdge = true;
+        }
+      }
+
+      if (!HasBackEdge) {
+        // StructurizeCFG pass already manipulated CFG. Just use false block
+        // of branch instruction as merge block.
+        SelectionMerges[&BB] = Br->getSuccessor(1);
+      }
+    }
+  }
+}
+
+} // namespace clspv
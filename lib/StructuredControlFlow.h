@@ -0,0 +1,68 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_STRUCTURED_CONTROL_FLOW_H
+#define CLSPV_LIB_STRUCTURED_CONTROL_FLOW_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+
+namespace clspv {
+
+// The structured control flow of a function, as SPIR-V declares it: the
+// merge and continue blocks of each loop header, and the merge block of each
+// other conditional branch.  The StructurizeCFG pass has already shaped the
+// CFG, so these follow from the loops and the dominator tree, which are only
+// needed while this is computed.
+class StructuredControlFlow {
+public:
+  StructuredControlFlow(llvm::Function &F, const llvm::DominatorTree &DT,
+                        const llvm::LoopInfo &LI);
+
+  // Returns the merge block of the loop headed by |BB|, or null if |BB| is
+  // not a loop header.
+  llvm::BasicBlock *getLoopMerge(const llvm::BasicBlock *BB) const {
+    auto Found = LoopMerges.find(BB);
+    return Found == LoopMerges.end() ? nullptr : Found->second.first;
+  }
+
+  // Returns the continue target of the loop headed by |BB|, or null if |BB| is
+  // not a loop header.
+  llvm::BasicBlock *getContinueTarget(const llvm::BasicBlock *BB) const {
+    auto Found = LoopMerges.find(BB);
+    return Found == LoopMerges.end() ? nullptr : Found->second.second;
+  }
+
+  // Returns the merge block of the selection that the conditional branch
+  // ending |BB| starts, or null if it starts none, because it ends a loop
+  // header or branches back to one.
+  llvm::BasicBlock *getSelectionMerge(const llvm::BasicBlock *BB) const {
+    return SelectionMerges.lookup(BB);
+  }
+
+private:
+  // The merge block and continue target of each loop header.
+  llvm::DenseMap<const llvm::BasicBlock *,
+                 std::pair<llvm::BasicBlock *, llvm::BasicBlock *>>
+      LoopMerges;
+  // The merge block of each block that starts a selection.
+  llvm::DenseMap<const llvm::BasicBlock *, llvm::BasicBlock *> SelectionMerges;
+};
+
+} // namespace clspv
+
+#endif
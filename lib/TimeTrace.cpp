@@ -0,0 +1,114 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "TimeTrace.h"
+
+#include <llvm/Support/Format.h>
+
+using namespace llvm;
+
+namespace {
+
+// The trace recorded on this thread.  Compilations run concurrently in batch
+// mode, each with its own trace.
+thread_local clspv::TimeTrace *CurrentTrace = nullptr;
+
+} // namespace
+
+namespace clspv {
+
+TimeTrace::TimeTrace() : StartTime(std::chrono::steady_clock::now()) {}
+
+int64_t TimeTrace::Now() const {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - StartTime)
+      .count();
+}
+
+std::vector<size_t> &TimeTrace::OpenOnThisThread(unsigned *thread) {
+  auto inserted =
+      Threads.insert(std::make_pair(std::this_thread::get_id(), Open.size()));
+  if (inserted.second) {
+    Open.emplace_back();
+  }
+  *thread = inserted.first->second;
+  return Open[*thread];
+}
+
+void TimeTrace::Begin(StringRef name, StringRef detail) {
+  Span span;
+  span.Name = name.str();
+  span.Detail = detail.str();
+  span.Start = Now();
+  span.Duration = 0;
+  std::lock_guard<std::mutex> lock(Mutex);
+  OpenOnThisThread(&span.Thread).push_back(Spans.size());
+  Spans.push_back(span);
+}
+
+void TimeTrace::End() {
+  const int64_t end = Now();
+  std::lock_guard<std::mutex> lock(Mutex);
+  unsigned thread;
+  std::vector<size_t> &open = OpenOnThisThread(&thread);
+  Span &span = Spans[open.back()];
+  span.Duration = end - span.Start;
+  open.pop_back();
+}
+
+void TimeTrace::Write(raw_ostream &out, StringRef processName) const {
+  out << "{\"traceEvents\": [\n";
+  out << "  {\"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"name\": "
+         "\"process_name\", \"args\": {\"name\": ";
+  WriteJSONString(out, processName);
+  out << "}}";
+  for (const Span &span : Spans) {
+    out << ",\n  {\"ph\": \"X\", \"pid\": 1, \"tid\": " << span.Thread
+        << ", \"name\": ";
+    WriteJSONString(out, span.Name);
+    out << ", \"ts\": " << span.Start << ", \"dur\": " << span.Duration;
+    if (!span.Detail.empty()) {
+      out << ", \"args\": {\"detail\": ";
+      WriteJSONString(out, span.Detail);
+      out << "}";
+    }
+    out << "}";
+  }
+  out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+}
+
+TimeTrace *TimeTrace::Current() { return CurrentTrace; }
+
+TimeTrace::ScopedCurrent::ScopedCurrent(TimeTrace *trace)
+    : Previous(CurrentTrace) {
+  CurrentTrace = trace;
+}
+
+TimeTrace::ScopedCurrent::~ScopedCurrent() { CurrentTrace = Previous; }
+
+void WriteJSONString(raw_ostream &out, StringRef str) {
+  out << '"';
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << format("\\u%04x", c);
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+} // namespace clspv
@@ -0,0 +1,118 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef CLSPV_LIB_TIMETRACE_H_
+#define CLSPV_LIB_TIMETRACE_H_
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace clspv {
+
+// Records nested spans of one compilation, to be written in the Chrome trace
+// event format and loaded in a trace viewer such as chrome://tracing.  Spans
+// may be recorded from several threads, each of which nests its own spans and
+// is shown as a thread of its own.
+class TimeTrace {
+public:
+  TimeTrace();
+
+  // Begins a span called |name|, nested in the spans still open.  |detail|
+  // tells instances of the same span apart, such as the function it works
+  // on.
+  void Begin(llvm::StringRef name, llvm::StringRef detail = "");
+
+  // Ends the span begun last on this thread.
+  void End();
+
+  // Writes the spans as a JSON trace to |out|.  |processName| labels the
+  // compilation in the viewer.
+  void Write(llvm::raw_ostream &out, llvm::StringRef processName) const;
+
+  // Returns the trace recorded on this thread, or null if there is none.
+  static TimeTrace *Current();
+
+  // Records the spans begun on this thread to |trace| until destroyed.  A
+  // worker thread uses this to record its spans to the trace of the thread
+  // that handed it work.
+  class ScopedCurrent {
+  public:
+    explicit ScopedCurrent(TimeTrace *trace);
+    ~ScopedCurrent();
+
+  private:
+    TimeTrace *Previous;
+  };
+
+private:
+  struct Span {
+    std::string Name;
+    std::string Detail;
+    // Index of the thread it was recorded on, in order of first span.
+    unsigned Thread;
+    // Microseconds from the start of the trace.
+    int64_t Start;
+    int64_t Duration;
+  };
+
+  int64_t Now() const;
+
+  // Returns the indices in Spans of the spans still open on this thread,
+  // innermost last, and sets |thread| to the index of this thread.  Mutex
+  // must be held.
+  std::vector<size_t> &OpenOnThisThread(unsigned *thread);
+
+  std::chrono::steady_clock::time_point StartTime;
+  // Guards everything below.
+  std::mutex Mutex;
+  std::vector<Span> Spans;
+  // Indexed by thread.
+  std::vector<std::vector<size_t>> Open;
+  std::map<std::thread::id, unsigned> Threads;
+};
+
+// Records a span of the current thread's trace, if there is one, for as long
+// as it lives.
+class TimeTraceScope {
+public:
+  explicit TimeTraceScope(llvm::StringRef name, llvm::StringRef detail = "")
+      : Trace(TimeTrace::Current()) {
+    if (Trace) {
+      Trace->Begin(name, detail);
+    }
+  }
+
+  ~TimeTraceScope() {
+    if (Trace) {
+      Trace->End();
+    }
+  }
+
+private:
+  TimeTrace *Trace;
+};
+
+// Writes |str| to |out| as a JSON string.
+void WriteJSONString(llvm::raw_ostream &out, llvm::StringRef str);
+
+} // namespace clspv
+
+#endif
@@ -14,30 +14,63 @@
 
 #include <utility>
 
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/UniqueVector.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
-#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "clspv/Option.h"
+
 using namespace llvm;
 
 #define DEBUG_TYPE "rewriteconstantexpressions"
 
 namespace {
 
-llvm::cl::opt<bool>
-    no_zero_allocas("no-zero-allocas", llvm::cl::init(false),
-                    llvm::cl::desc("Don't zero-initialize stack variables"));
-
 struct ZeroInitializeAllocasPass : public ModulePass {
   static char ID;
   ZeroInitializeAllocasPass() : ModulePass(ID) {}
 
   bool runOnModule(Module &M) override;
+
+private:
+  // A load or a store of the bytes [Begin, End) of a stack variable.  If the
+  // access is not exact, it is of some of those bytes.
+  struct Access {
+    Instruction *I;
+    uint64_t Begin;
+    uint64_t End;
+    bool Exact;
+    bool IsWrite;
+  };
+
+  // Collects the accesses to |Alloca|, of |Size| bytes, into |Accesses|, by
+  // the block they are in.  Returns false if the address of the variable
+  // escapes, or is used in a way this does not follow.
+  bool CollectAccesses(
+      AllocaInst *Alloca, uint64_t Size, const DataLayout &DL,
+      DenseMap<BasicBlock *, SmallVector<Access, 4>> &Accesses);
+
+  // Returns the bytes of |Alloca|, of |Size| bytes, that may be read before
+  // they are written, or all of them if that can't be worked out.
+  BitVector FindBytesReadBeforeWritten(AllocaInst *Alloca, uint64_t Size,
+                                       const DataLayout &DL);
+
+  // Stores zero to the parts of the object of type |Ty| at |Offset| in
+  // |Alloca|, addressed by |Indices|, which overlap |Bytes|.  Returns the
+  // number of bytes stored.
+  uint64_t StoreZeros(IRBuilder<> &Builder, AllocaInst *Alloca, Type *Ty,
+                      uint64_t Offset, SmallVectorImpl<Value *> &Indices,
+                      const BitVector &Bytes, const DataLayout &DL);
 };
 } // namespace
 
@@ -52,13 +85,297 @@ llvm::ModulePass *createZeroInitializeAllocasPass() {
 }
 } // namespace clspv
 
+namespace {
+// Stack variables larger than this are zero-initialized whole, so that
+// finding the bytes that need it stays cheap.
+const uint64_t kMaxAnalyzedAllocaSize = 1 << 16;
+
+// Arrays with more elements than this that need some of their bytes zeroed
+// are zeroed whole, rather than one element at a time.
+const unsigned kMaxZeroedElements = 16;
+
+// Returns true if |Bytes| has any of [Begin, End) set.
+bool AnySet(const BitVector &Bytes, uint64_t Begin, uint64_t End) {
+  for (uint64_t i = Begin; i < End; i++) {
+    if (Bytes.test(i)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if |Bytes| has all of [Begin, End) set.
+bool AllSet(const BitVector &Bytes, uint64_t Begin, uint64_t End) {
+  for (uint64_t i = Begin; i < End; i++) {
+    if (!Bytes.test(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+bool ZeroInitializeAllocasPass::CollectAccesses(
+    AllocaInst *Alloca, uint64_t Size, const DataLayout &DL,
+    DenseMap<BasicBlock *, SmallVector<Access, 4>> &Accesses) {
+  // Each pointer derived from the variable, with the bytes it may point into.
+  // The pointer is at the first of them if it is exact.
+  struct Pointer {
+    Value *V;
+    uint64_t Begin;
+    uint64_t End;
+    bool Exact;
+  };
+  SmallVector<Pointer, 8> WorkList;
+  WorkList.push_back({Alloca, 0, Size, true});
+
+  while (!WorkList.empty()) {
+    const Pointer Ptr = WorkList.pop_back_val();
+
+    for (User *U : Ptr.V->users()) {
+      auto *I = cast<Instruction>(U);
+
+      // Returns the access of |Bytes| bytes at the pointer.
+      auto AccessOf = [&Ptr, I, Size](uint64_t Bytes, bool IsWrite) {
+        if (Ptr.Exact && Ptr.Begin + Bytes <= Size) {
+          return Access{I, Ptr.Begin, Ptr.Begin + Bytes, true, IsWrite};
+        }
+        return Access{I, Ptr.Begin, Ptr.End, false, IsWrite};
+      };
+
+      if (auto *Load = dyn_cast<LoadInst>(I)) {
+        Accesses[I->getParent()].push_back(
+            AccessOf(DL.getTypeStoreSize(Load->getType()), false));
+      } else if (auto *Store = dyn_cast<StoreInst>(I)) {
+        if (Store->getValueOperand() == Ptr.V) {
+          return false;
+        }
+        Accesses[I->getParent()].push_back(AccessOf(
+            DL.getTypeStoreSize(Store->getValueOperand()->getType()), true));
+      } else if (isa<BitCastInst>(I) || isa<AddrSpaceCastInst>(I)) {
+        WorkList.push_back({I, Ptr.Begin, Ptr.End, Ptr.Exact});
+      } else if (auto *GEP = dyn_cast<GetElementPtrInst>(I)) {
+        if (!Ptr.Exact) {
+          WorkList.push_back({I, 0, Size, false});
+          continue;
+        }
+
+        // Follow the indices while they are constant.  A variable index
+        // points somewhere into the array or vector it indexes, or anywhere
+        // at all if it is the first index.
+        Pointer Result{I, Ptr.Begin, Size, true};
+        Type *Ty = GEP->getSourceElementType();
+        for (auto Index = GEP->idx_begin(); Index != GEP->idx_end(); ++Index) {
+          auto *CI = dyn_cast<ConstantInt>(*Index);
+          if (Index == GEP->idx_begin()) {
+            if (!CI) {
+              Result = {I, 0, Size, false};
+              break;
+            }
+            Result.Begin += CI->getSExtValue() * DL.getTypeAllocSize(Ty);
+          } else if (auto *STy = dyn_cast<StructType>(Ty)) {
+            Result.Begin += DL.getStructLayout(STy)->getElementOffset(
+                CI->getZExtValue());
+            Ty = STy->getElementType(CI->getZExtValue());
+          } else {
+            Type *ElementTy = Ty->getSequentialElementType();
+            if (!CI) {
+              Result.End = Result.Begin + DL.getTypeAllocSize(Ty);
+              Result.Exact = false;
+              break;
+            }
+            Result.Begin += CI->getSExtValue() * DL.getTypeAllocSize(ElementTy);
+            Ty = ElementTy;
+          }
+        }
+        if (Result.Begin >= Size || Result.End > Size) {
+          Result = {I, 0, Size, false};
+        }
+        WorkList.push_back(Result);
+      } else if (auto *MemSet = dyn_cast<MemSetInst>(I)) {
+        auto *Length = dyn_cast<ConstantInt>(MemSet->getLength());
+        if (!Length || MemSet->getRawDest() != Ptr.V) {
+          return false;
+        }
+        Accesses[I->getParent()].push_back(
+            AccessOf(Length->getZExtValue(), true));
+      } else if (auto *MemTransfer = dyn_cast<MemTransferInst>(I)) {
+        auto *Length = dyn_cast<ConstantInt>(MemTransfer->getLength());
+        if (!Length) {
+          return false;
+        }
+        // The source is read before the destination is written.
+        if (MemTransfer->getRawSource() == Ptr.V) {
+          Accesses[I->getParent()].push_back(
+              AccessOf(Length->getZExtValue(), false));
+        }
+        if (MemTransfer->getRawDest() == Ptr.V) {
+          Accesses[I->getParent()].push_back(
+              AccessOf(Length->getZExtValue(), true));
+        }
+      } else if (auto *Intrinsic = dyn_cast<IntrinsicInst>(I)) {
+        if (Intrinsic->getIntrinsicID() != Intrinsic::lifetime_start &&
+            Intrinsic->getIntrinsicID() != Intrinsic::lifetime_end) {
+          return false;
+        }
+      } else {
+        return false;
+      }
+    }
+  }
+
+  // Within a block, the accesses are followed in the order of their
+  // instructions.
+  for (auto &BlockAccesses : Accesses) {
+    DenseMap<const Instruction *, unsigned> Order;
+    for (const Instruction &I : *BlockAccesses.first) {
+      Order[&I] = Order.size();
+    }
+    std::stable_sort(BlockAccesses.second.begin(), BlockAccesses.second.end(),
+                     [&Order](const Access &A, const Access &B) {
+                       return Order[A.I] < Order[B.I];
+                     });
+  }
+
+  return true;
+}
+
+BitVector ZeroInitializeAllocasPass::FindBytesReadBeforeWritten(
+    AllocaInst *Alloca, uint64_t Size, const DataLayout &DL) {
+  BitVector All(Size, true);
+
+  // A variable allocated outside the entry block may be allocated again each
+  // time around a loop, and is left as it is.
+  Function &F = *Alloca->getFunction();
+  if (Alloca->getParent() != &F.getEntryBlock() || Size == 0 ||
+      Size > kMaxAnalyzedAllocaSize) {
+    return All;
+  }
+
+  DenseMap<BasicBlock *, SmallVector<Access, 4>> Accesses;
+  if (!CollectAccesses(Alloca, Size, DL, Accesses)) {
+    return All;
+  }
+
+  // Find the bytes that are written on every path to the end of each block.
+  // Those of the entry block start out unwritten, and the others start out
+  // as all written, until it is known which paths reach them.
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  DenseMap<BasicBlock *, BitVector> WrittenOut;
+  for (BasicBlock *BB : RPOT) {
+    WrittenOut[BB] = All;
+  }
+
+  // Returns the accesses in |BB|.
+  auto AccessesIn = [&Accesses](BasicBlock *BB) -> ArrayRef<Access> {
+    auto Found = Accesses.find(BB);
+    if (Found == Accesses.end()) {
+      return None;
+    }
+    return Found->second;
+  };
+
+  // Returns the bytes written on every path to the start of |BB|.
+  auto WrittenIn = [&](BasicBlock *BB) {
+    if (BB == &F.getEntryBlock()) {
+      return BitVector(Size);
+    }
+    BitVector Written = All;
+    for (BasicBlock *Pred : predecessors(BB)) {
+      auto Found = WrittenOut.find(Pred);
+      if (Found != WrittenOut.end()) {
+        Written &= Found->second;
+      }
+    }
+    return Written;
+  };
+
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (BasicBlock *BB : RPOT) {
+      BitVector Written = WrittenIn(BB);
+      for (const Access &A : AccessesIn(BB)) {
+        if (A.IsWrite && A.Exact) {
+          Written.set(A.Begin, A.End);
+        }
+      }
+      BitVector &Out = WrittenOut[BB];
+      if (Out != Written) {
+        Out = std::move(Written);
+        Changed = true;
+      }
+    }
+  }
+
+  // Each read needs the bytes it may read that are not written yet on some
+  // path to it.
+  BitVector Needed(Size);
+  for (BasicBlock *BB : RPOT) {
+    BitVector Written = WrittenIn(BB);
+    for (const Access &A : AccessesIn(BB)) {
+      if (A.IsWrite) {
+        if (A.Exact) {
+          Written.set(A.Begin, A.End);
+        }
+        continue;
+      }
+      for (uint64_t i = A.Begin; i < A.End; i++) {
+        if (!Written.test(i)) {
+          Needed.set(i);
+        }
+      }
+    }
+  }
+
+  return Needed;
+}
+
+uint64_t ZeroInitializeAllocasPass::StoreZeros(
+    IRBuilder<> &Builder, AllocaInst *Alloca, Type *Ty, uint64_t Offset,
+    SmallVectorImpl<Value *> &Indices, const BitVector &Bytes,
+    const DataLayout &DL) {
+  const uint64_t End = Offset + DL.getTypeStoreSize(Ty);
+  if (!AnySet(Bytes, Offset, End)) {
+    return 0;
+  }
+
+  auto *STy = dyn_cast<StructType>(Ty);
+  auto *ATy = dyn_cast<ArrayType>(Ty);
+  if (AllSet(Bytes, Offset, End) || (!STy && !ATy) ||
+      (ATy && ATy->getNumElements() > kMaxZeroedElements)) {
+    Value *Ptr = Indices.size() == 1 ? static_cast<Value *>(Alloca)
+                                      : Builder.CreateGEP(Alloca, Indices);
+    Builder.CreateStore(Constant::getNullValue(Ty), Ptr);
+    return End - Offset;
+  }
+
+  uint64_t Stored = 0;
+  const unsigned NumElements =
+      STy ? STy->getNumElements() : ATy->getNumElements();
+  for (unsigned i = 0; i < NumElements; i++) {
+    Type *ElementTy = STy ? STy->getElementType(i) : ATy->getElementType();
+    const uint64_t ElementOffset =
+        STy ? DL.getStructLayout(STy)->getElementOffset(i)
+            : i * DL.getTypeAllocSize(ElementTy);
+    Indices.push_back(Builder.getInt32(i));
+    Stored += StoreZeros(Builder, Alloca, ElementTy, Offset + ElementOffset,
+                         Indices, Bytes, DL);
+    Indices.pop_back();
+  }
+  return Stored;
+}
+
 bool ZeroInitializeAllocasPass::runOnModule(Module &M) {
   bool Changed = false;
-  if (no_zero_allocas)
+  if (!clspv::Option::ZeroInitializeAllocas())
     return Changed;
 
-  SmallVector<AllocaInst *, 8> WorkList;
+  const DataLayout &DL = M.getDataLayout();
+  const bool AsNeeded = clspv::Option::ZeroInitializeAllocasAsNeeded();
+
   for (Function &F : M) {
+    SmallVector<AllocaInst *, 8> WorkList;
     for (BasicBlock &BB : F) {
       for (auto iter = BB.begin(); iter != BB.end() ; ++iter) {
         if (auto *alloca = dyn_cast<AllocaInst>(&*iter)) {
@@ -66,12 +383,38 @@ bool ZeroInitializeAllocasPass::runOnModule(Module &M) {
         }
       }
     }
-  }
 
-  for (AllocaInst *alloca : WorkList) {
-    auto *valueTy = alloca->getType()->getPointerElementType();
-    auto *store = new StoreInst(Constant::getNullValue(valueTy), alloca);
-    store->insertAfter(alloca);
+    uint64_t TotalBytes = 0;
+    uint64_t StoredBytes = 0;
+    for (AllocaInst *alloca : WorkList) {
+      auto *valueTy = alloca->getType()->getPointerElementType();
+      const uint64_t Size = DL.getTypeStoreSize(valueTy);
+      TotalBytes += Size;
+
+      if (!AsNeeded) {
+        auto *store = new StoreInst(Constant::getNullValue(valueTy), alloca);
+        store->insertAfter(alloca);
+        StoredBytes += Size;
+        Changed = true;
+        continue;
+      }
+
+      // Only the bytes that may be read before they are written need to be
+      // zero, so that no read sees an undefined value.
+      const BitVector Needed = FindBytesReadBeforeWritten(alloca, Size, DL);
+      IRBuilder<> Builder(alloca->getNextNode());
+      SmallVector<Value *, 4> Indices{Builder.getInt32(0)};
+      const uint64_t Stored =
+          StoreZeros(Builder, alloca, valueTy, 0, Indices, Needed, DL);
+      StoredBytes += Stored;
+      Changed |= Stored != 0;
+    }
+
+    if (clspv::Option::ZeroInitializeAllocasReport() && TotalBytes != 0) {
+      errs() << "Zero-initialized " << StoredBytes << " of " << TotalBytes
+             << " bytes of stack variables in " << F.getName() << ", "
+             << TotalBytes - StoredBytes << " bytes elided\n";
+    }
   }
 
   return Changed;
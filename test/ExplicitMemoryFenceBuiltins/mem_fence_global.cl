@@ -24,12 +24,12 @@
 // Device
 // CHECK: %[[CONSTANT_1_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 1
 
-// SequentiallyConsistent | StorageBufferMemory
-// CHECK: %[[CONSTANT_0x050_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 80
+// AcquireRelease | StorageBufferMemory
+// CHECK: %[[CONSTANT_0x048_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 72
 
 // CHECK: %[[FOO_ID]] = OpFunction %[[VOID_TYPE_ID]] None %[[FOO_TYPE_ID]]
 // CHECK: %[[LABEL_ID:[a-zA-Z0-9_]*]] = OpLabel
-// CHECK: OpMemoryBarrier %[[CONSTANT_1_ID]] %[[CONSTANT_0x050_ID]]
+// CHECK: OpMemoryBarrier %[[CONSTANT_1_ID]] %[[CONSTANT_0x048_ID]]
 // CHECK: OpReturn
 // CHECK: OpFunctionEnd
 
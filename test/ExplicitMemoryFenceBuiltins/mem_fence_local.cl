@@ -21,15 +21,15 @@
 // CHECK: %[[FOO_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeFunction %[[VOID_TYPE_ID]]
 // CHECK: %[[UINT_TYPE_ID:[a-zA-Z0-9_]*]] = OpTypeInt 32 0
 
-// Device
-// CHECK: %[[CONSTANT_1_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 1
+// Workgroup
+// CHECK: %[[CONSTANT_2_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 2
 
-// SequentiallyConsistent | WorkgroupMemory
-// CHECK: %[[CONSTANT_0x110_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 272
+// AcquireRelease | WorkgroupMemory
+// CHECK: %[[CONSTANT_0x108_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 264
 
 // CHECK: %[[FOO_ID]] = OpFunction %[[VOID_TYPE_ID]] None %[[FOO_TYPE_ID]]
 // CHECK: %[[LABEL_ID:[a-zA-Z0-9_]*]] = OpLabel
-// CHECK: OpMemoryBarrier %[[CONSTANT_1_ID]] %[[CONSTANT_0x110_ID]]
+// CHECK: OpMemoryBarrier %[[CONSTANT_2_ID]] %[[CONSTANT_0x108_ID]]
 // CHECK: OpReturn
 // CHECK: OpFunctionEnd
 
@@ -0,0 +1,110 @@
+// RUN: clspv %s -S -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// A long chain of pointer casts, and a deep chain of calls that each pass a
+// cast pointer on, are all simplified and inlined away.  Their compile time
+// is measured by bench/corpus/pointer_cast_chain.cl.
+
+// CHECK: OpEntryPoint GLCompute [[CASTS:%[0-9a-zA-Z_]+]] "casts"
+// CHECK: OpEntryPoint GLCompute [[CALLS:%[0-9a-zA-Z_]+]] "calls"
+// CHECK-NOT: OpFunctionCall
+// CHECK: [[CASTS]] = OpFunction
+// CHECK-NOT: OpFunctionCall
+// CHECK: [[CALLS]] = OpFunction
+// CHECK-NOT: OpFunctionCall
+// CHECK: OpFunctionEnd
+
+// 512 casts, each with an offset, one after the other.
+#define CAST1 p = (global uint *)((global float *)p + 1);
+#define CAST2 CAST1 CAST1
+#define CAST4 CAST2 CAST2
+#define CAST8 CAST4 CAST4
+#define CAST16 CAST8 CAST8
+#define CAST32 CAST16 CAST16
+#define CAST64 CAST32 CAST32
+#define CAST128 CAST64 CAST64
+#define CAST256 CAST128 CAST128
+#define CAST512 CAST256 CAST256
+
+kernel void casts(global uint *A) {
+  global uint *p = A;
+  CAST512
+  *p = 42;
+}
+
+// Each function passes its pointer on to the one below as the other type.
+#define CALL_AS_FLOAT(n, m)                                                    \
+  void f##n(global uint *p) { f##m((global float *)p); }
+#define CALL_AS_UINT(n, m)                                                     \
+  void f##n(global float *p) { f##m((global uint *)p); }
+
+void f0(global uint *p) { *p = 7; }
+
+CALL_AS_UINT(1, 0)
+CALL_AS_FLOAT(2, 1)
+CALL_AS_UINT(3, 2)
+CALL_AS_FLOAT(4, 3)
+CALL_AS_UINT(5, 4)
+CALL_AS_FLOAT(6, 5)
+CALL_AS_UINT(7, 6)
+CALL_AS_FLOAT(8, 7)
+CALL_AS_UINT(9, 8)
+CALL_AS_FLOAT(10, 9)
+CALL_AS_UINT(11, 10)
+CALL_AS_FLOAT(12, 11)
+CALL_AS_UINT(13, 12)
+CALL_AS_FLOAT(14, 13)
+CALL_AS_UINT(15, 14)
+CALL_AS_FLOAT(16, 15)
+CALL_AS_UINT(17, 16)
+CALL_AS_FLOAT(18, 17)
+CALL_AS_UINT(19, 18)
+CALL_AS_FLOAT(20, 19)
+CALL_AS_UINT(21, 20)
+CALL_AS_FLOAT(22, 21)
+CALL_AS_UINT(23, 22)
+CALL_AS_FLOAT(24, 23)
+CALL_AS_UINT(25, 24)
+CALL_AS_FLOAT(26, 25)
+CALL_AS_UINT(27, 26)
+CALL_AS_FLOAT(28, 27)
+CALL_AS_UINT(29, 28)
+CALL_AS_FLOAT(30, 29)
+CALL_AS_UINT(31, 30)
+CALL_AS_FLOAT(32, 31)
+CALL_AS_UINT(33, 32)
+CALL_AS_FLOAT(34, 33)
+CALL_AS_UINT(35, 34)
+CALL_AS_FLOAT(36, 35)
+CALL_AS_UINT(37, 36)
+CALL_AS_FLOAT(38, 37)
+CALL_AS_UINT(39, 38)
+CALL_AS_FLOAT(40, 39)
+CALL_AS_UINT(41, 40)
+CALL_AS_FLOAT(42, 41)
+CALL_AS_UINT(43, 42)
+CALL_AS_FLOAT(44, 43)
+CALL_AS_UINT(45, 44)
+CALL_AS_FLOAT(46, 45)
+CALL_AS_UINT(47, 46)
+CALL_AS_FLOAT(48, 47)
+CALL_AS_UINT(49, 48)
+CALL_AS_FLOAT(50, 49)
+CALL_AS_UINT(51, 50)
+CALL_AS_FLOAT(52, 51)
+CALL_AS_UINT(53, 52)
+CALL_AS_FLOAT(54, 53)
+CALL_AS_UINT(55, 54)
+CALL_AS_FLOAT(56, 55)
+CALL_AS_UINT(57, 56)
+CALL_AS_FLOAT(58, 57)
+CALL_AS_UINT(59, 58)
+CALL_AS_FLOAT(60, 59)
+CALL_AS_UINT(61, 60)
+CALL_AS_FLOAT(62, 61)
+CALL_AS_UINT(63, 62)
+CALL_AS_FLOAT(64, 63)
+
+kernel void calls(global uint *A) { f64(A); }
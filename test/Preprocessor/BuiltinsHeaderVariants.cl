@@ -0,0 +1,37 @@
+// The builtins header is precompiled for the default options and for
+// -cl-fast-relaxed-math, and included textually for other option sets.
+// Check each option set picks its own form of the header, and that builtins
+// resolve the same way in each case.
+
+// REQUIRES: precompiled-builtins
+
+// RUN: clspv %s -S -o %t.spvasm -print-builtins 2> %t.default.log
+// RUN: FileCheck %s < %t.spvasm
+// RUN: FileCheck -check-prefix=DEFAULT %s < %t.default.log
+// RUN: clspv -cl-fast-relaxed-math %s -S -o %t.spvasm -print-builtins 2> %t.fast.log
+// RUN: FileCheck %s < %t.spvasm
+// RUN: FileCheck -check-prefix=FAST %s < %t.fast.log
+// RUN: clspv -cl-single-precision-constant %s -S -o %t.spvasm -print-builtins 2> %t.single.log
+// RUN: FileCheck %s < %t.spvasm
+// RUN: FileCheck -check-prefix=HEADER %s < %t.single.log
+// RUN: clspv -cl-finite-math-only -DUSER_SPECIFIED=1 %s -o %t.spv -print-builtins 2> %t.finite.log
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: FileCheck -check-prefix=HEADER %s < %t.finite.log
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv -lazy-builtins %s -S -o %t.spvasm -print-builtins 2> %t.lazy.log
+// RUN: FileCheck %s < %t.spvasm
+// RUN: FileCheck -check-prefix=TABLE %s < %t.lazy.log
+
+// CHECK: [[_1:%[0-9a-zA-Z_]+]] = OpExtInstImport "GLSL.std.450"
+// CHECK: OpEntryPoint GLCompute {{%[0-9a-zA-Z_]+}} "foo"
+// CHECK: OpExtInst {{%[0-9a-zA-Z_]+}} [[_1]] FAbs
+
+// DEFAULT: builtins: precompiled default
+// FAST: builtins: precompiled fast_relaxed_math
+// HEADER: builtins: header
+// TABLE: builtins: table
+
+void kernel foo(global float* A) {
+  *A = fabs(*A);
+}
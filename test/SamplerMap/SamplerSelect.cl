@@ -0,0 +1,39 @@
+// RUN: clspv -samplermap %S/foo.samplermap %s -S -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv -samplermap %S/foo.samplermap %s -o %t.spv
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// A choice between samplers is folded into a choice between the literals
+// they are initialized from.  The legalizer splits the call that translates
+// the literal back into one call per sampler, including when the choices are
+// nested.
+
+// CHECK: OpDecorate [[S0:%[0-9a-zA-Z_]+]] DescriptorSet 0
+// CHECK: OpDecorate [[S0]] Binding 0
+// CHECK: OpDecorate [[S1:%[0-9a-zA-Z_]+]] DescriptorSet 0
+// CHECK: OpDecorate [[S1]] Binding 1
+
+// CHECK: = OpFunction
+// CHECK-DAG: OpLoad {{%[0-9a-zA-Z_]+}} [[S0]]
+// CHECK-DAG: OpLoad {{%[0-9a-zA-Z_]+}} [[S1]]
+// CHECK: OpImageSampleExplicitLod
+// CHECK: OpFunctionEnd
+
+// CHECK: = OpFunction
+// CHECK-DAG: OpLoad {{%[0-9a-zA-Z_]+}} [[S0]]
+// CHECK-DAG: OpLoad {{%[0-9a-zA-Z_]+}} [[S1]]
+// CHECK: OpImageSampleExplicitLod
+// CHECK: OpFunctionEnd
+
+constant sampler_t s0 = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+constant sampler_t s1 = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+kernel void select_sampler(read_only image2d_t i, float2 c, global float4 *a,
+                           int k) {
+  *a = read_imagef(i, k ? s0 : s1, c);
+}
+
+kernel void select_nested_sampler(read_only image2d_t i, float2 c,
+                                  global float4 *a, int k, int j) {
+  *a = read_imagef(i, k ? s0 : (j ? s1 : s0), c);
+}
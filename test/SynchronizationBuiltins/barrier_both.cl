@@ -27,12 +27,12 @@
 // Device
 // CHECK: %[[CONSTANT_1_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 1
 
-// SequentiallyConsistent | StorageBufferMemory | WorkgroupMemory
-// CHECK: %[[CONSTANT_0x150_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 336
+// AcquireRelease | StorageBufferMemory | WorkgroupMemory
+// CHECK: %[[CONSTANT_0x148_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 328
 
 // CHECK: %[[FOO_ID]] = OpFunction %[[VOID_TYPE_ID]] None %[[FOO_TYPE_ID]]
 // CHECK: %[[LABEL_ID:[a-zA-Z0-9_]*]] = OpLabel
-// CHECK: OpControlBarrier %[[CONSTANT_2_ID]] %[[CONSTANT_1_ID]] %[[CONSTANT_0x150_ID]]
+// CHECK: OpControlBarrier %[[CONSTANT_2_ID]] %[[CONSTANT_1_ID]] %[[CONSTANT_0x148_ID]]
 // CHECK: OpReturn
 // CHECK: OpFunctionEnd
 
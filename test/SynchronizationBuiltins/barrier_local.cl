@@ -24,12 +24,12 @@
 // Workgroup
 // CHECK: %[[CONSTANT_2_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 2
 
-// SequentiallyConsistent | WorkgroupMemory
-// CHECK: %[[CONSTANT_0x110_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 272
+// AcquireRelease | WorkgroupMemory
+// CHECK: %[[CONSTANT_0x108_ID:[a-zA-Z0-9_]*]] = OpConstant %[[UINT_TYPE_ID]] 264
 
 // CHECK: %[[FOO_ID]] = OpFunction %[[VOID_TYPE_ID]] None %[[FOO_TYPE_ID]]
 // CHECK: %[[LABEL_ID:[a-zA-Z0-9_]*]] = OpLabel
-// CHECK: OpControlBarrier %[[CONSTANT_2_ID]] %[[CONSTANT_2_ID]] %[[CONSTANT_0x110_ID]]
+// CHECK: OpControlBarrier %[[CONSTANT_2_ID]] %[[CONSTANT_2_ID]] %[[CONSTANT_0x108_ID]]
 // CHECK: OpReturn
 // CHECK: OpFunctionEnd
 
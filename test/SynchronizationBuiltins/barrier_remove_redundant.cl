@@ -0,0 +1,34 @@
+// RUN: clspv %s -S -o %t.spvasm -remove-redundant-barriers
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv -remove-redundant-barriers
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv %s -S -o %t.all.spvasm
+// RUN: FileCheck -check-prefix=ALL %s < %t.all.spvasm
+
+// The first barrier has no accesses before it, the third repeats the second,
+// and the last has no accesses after it.  Only the second orders anything.
+// CHECK: OpEntryPoint GLCompute %[[FOO_ID:[a-zA-Z0-9_]*]] "foo"
+// CHECK: %[[FOO_ID]] = OpFunction
+// CHECK-NOT: OpControlBarrier
+// CHECK: OpStore
+// CHECK: OpControlBarrier
+// CHECK-NOT: OpControlBarrier
+// CHECK: OpFunctionEnd
+
+// Without the option, every barrier is kept.
+// ALL: OpControlBarrier
+// ALL: OpControlBarrier
+// ALL: OpControlBarrier
+// ALL: OpControlBarrier
+// ALL-NOT: OpControlBarrier
+
+void kernel foo(global float *A) {
+  local float tile[64];
+  const size_t i = get_local_id(0);
+  barrier(CLK_LOCAL_MEM_FENCE);
+  tile[i] = A[get_global_id(0)];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  barrier(CLK_LOCAL_MEM_FENCE);
+  A[get_global_id(0)] = tile[63 - i];
+  barrier(CLK_LOCAL_MEM_FENCE);
+}
@@ -0,0 +1,44 @@
+// RUN: clspv %s -S -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Fence flags that are not a literal when barriers and fences are lowered
+// give the same semantics and scope as literal flags: a fence of no memory
+// has no semantics.
+
+// CHECK-DAG: [[UINT:%[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[NONE:%[0-9a-zA-Z_]+]] = OpConstant [[UINT]] 0
+// CHECK-DAG: [[DEVICE:%[0-9a-zA-Z_]+]] = OpConstant [[UINT]] 1
+// CHECK-DAG: [[WORKGROUP:%[0-9a-zA-Z_]+]] = OpConstant [[UINT]] 2
+// AcquireRelease | UniformMemory
+// CHECK-DAG: [[GLOBAL:%[0-9a-zA-Z_]+]] = OpConstant [[UINT]] 72
+// AcquireRelease | WorkgroupMemory
+// CHECK-DAG: [[LOCAL:%[0-9a-zA-Z_]+]] = OpConstant [[UINT]] 264
+
+// CHECK: OpControlBarrier [[WORKGROUP]] [[WORKGROUP]] [[NONE]]
+// CHECK: OpControlBarrier [[WORKGROUP]] [[WORKGROUP]] [[LOCAL]]
+// CHECK: OpControlBarrier [[WORKGROUP]] [[DEVICE]] [[GLOBAL]]
+// CHECK: OpMemoryBarrier [[WORKGROUP]] [[NONE]]
+
+void kernel __attribute__((reqd_work_group_size(1, 1, 1))) none() {
+  cl_mem_fence_flags flags = 0;
+  barrier(flags);
+}
+
+void kernel __attribute__((reqd_work_group_size(1, 1, 1))) local_flags() {
+  cl_mem_fence_flags flags = CLK_LOCAL_MEM_FENCE;
+  barrier(flags);
+}
+
+void kernel __attribute__((reqd_work_group_size(1, 1, 1))) global_flags() {
+  cl_mem_fence_flags flags = CLK_GLOBAL_MEM_FENCE;
+  barrier(flags);
+}
+
+void kernel __attribute__((reqd_work_group_size(1, 1, 1))) fence_none() {
+  cl_mem_fence_flags flags = 0;
+  mem_fence(flags);
+}
@@ -0,0 +1,50 @@
+// RUN: clspv %s -S -o %t.spvasm -f8bit_storage -f16bit_storage -fp16
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv -f8bit_storage -f16bit_storage -fp16
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// vload4 of char, short and half is split into one load of each element,
+// like that of float.
+
+// CHECK: OpEntryPoint GLCompute [[CHAR:%[0-9a-zA-Z_]+]] "global_char"
+// CHECK: OpEntryPoint GLCompute [[SHORT:%[0-9a-zA-Z_]+]] "global_short"
+// CHECK: OpEntryPoint GLCompute [[HALF:%[0-9a-zA-Z_]+]] "global_half"
+// CHECK-DAG: [[UCHAR:%[0-9a-zA-Z_]+]] = OpTypeInt 8 0
+// CHECK-DAG: [[USHORT:%[0-9a-zA-Z_]+]] = OpTypeInt 16 0
+// CHECK-DAG: [[FLOAT16:%[0-9a-zA-Z_]+]] = OpTypeFloat 16
+
+// CHECK: [[CHAR]] = OpFunction
+// CHECK: OpLoad [[UCHAR]]
+// CHECK: OpLoad [[UCHAR]]
+// CHECK: OpLoad [[UCHAR]]
+// CHECK: OpLoad [[UCHAR]]
+// CHECK: OpFunctionEnd
+
+// CHECK: [[SHORT]] = OpFunction
+// CHECK: OpLoad [[USHORT]]
+// CHECK: OpLoad [[USHORT]]
+// CHECK: OpLoad [[USHORT]]
+// CHECK: OpLoad [[USHORT]]
+// CHECK: OpFunctionEnd
+
+// CHECK: [[HALF]] = OpFunction
+// CHECK: OpLoad [[FLOAT16]]
+// CHECK: OpLoad [[FLOAT16]]
+// CHECK: OpLoad [[FLOAT16]]
+// CHECK: OpLoad [[FLOAT16]]
+// CHECK: OpFunctionEnd
+
+kernel void global_char(global char4 *A, global char *B) {
+  size_t i = get_global_id(0);
+  A[i] = vload4(i, B);
+}
+
+kernel void global_short(global short4 *A, global short *B) {
+  size_t i = get_global_id(0);
+  A[i] = vload4(i, B);
+}
+
+kernel void global_half(global half4 *A, global half *B) {
+  size_t i = get_global_id(0);
+  A[i] = vload4(i, B);
+}
@@ -0,0 +1,59 @@
+// RUN: clspv %s -S -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// vload4 from a pointer to narrower values is split into one load of each
+// value the pointer points to: an element of a scalar buffer or array, or
+// a whole float2.  The loaded values are then put together.
+
+// CHECK: OpEntryPoint GLCompute [[GLOBAL:%[0-9a-zA-Z_]+]] "global_float"
+// CHECK: OpEntryPoint GLCompute [[HALVES:%[0-9a-zA-Z_]+]] "global_float2"
+// CHECK: OpEntryPoint GLCompute [[PRIVATE:%[0-9a-zA-Z_]+]] "private_float"
+// CHECK-DAG: [[FLOAT:%[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK-DAG: [[FLOAT2:%[0-9a-zA-Z_]+]] = OpTypeVector [[FLOAT]] 2
+// CHECK-DAG: [[FLOAT4:%[0-9a-zA-Z_]+]] = OpTypeVector [[FLOAT]] 4
+
+// CHECK: [[GLOBAL]] = OpFunction
+// CHECK-NOT: OpLoad [[FLOAT4]]
+// CHECK: OpLoad [[FLOAT]]
+// CHECK: OpLoad [[FLOAT]]
+// CHECK: OpLoad [[FLOAT]]
+// CHECK: OpLoad [[FLOAT]]
+// CHECK-NOT: OpLoad
+// CHECK: OpFunctionEnd
+
+// CHECK: [[HALVES]] = OpFunction
+// CHECK-NOT: OpLoad [[FLOAT4]]
+// CHECK: OpLoad [[FLOAT2]]
+// CHECK: OpLoad [[FLOAT2]]
+// CHECK-NOT: OpLoad
+// CHECK: OpFunctionEnd
+
+// CHECK: [[PRIVATE]] = OpFunction
+// CHECK: OpVariable {{%[0-9a-zA-Z_]+}} Function
+// CHECK-NOT: OpLoad [[FLOAT4]]
+// CHECK: OpLoad [[FLOAT]]
+// CHECK: OpLoad [[FLOAT]]
+// CHECK: OpLoad [[FLOAT]]
+// CHECK: OpLoad [[FLOAT]]
+// CHECK-NOT: OpLoad [[FLOAT4]]
+// CHECK: OpFunctionEnd
+
+kernel void global_float(global float4 *A, global float *B) {
+  size_t i = get_global_id(0);
+  A[i] = vload4(i, B);
+}
+
+kernel void global_float2(global float4 *A, global float2 *B) {
+  size_t i = get_global_id(0);
+  A[i] = vload4(i, (global float *)B);
+}
+
+kernel void private_float(global float4 *A, global float *B, uint n) {
+  float tmp[8];
+  for (int j = 0; j < 8; j++) {
+    tmp[j] = B[j];
+  }
+  A[0] = vload4(n & 1, tmp);
+}
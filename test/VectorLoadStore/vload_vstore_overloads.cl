@@ -0,0 +1,54 @@
+// RUN: clspv %s -S -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// vloadn and vstoren of other element types, sizes and address spaces.
+
+// CHECK: OpEntryPoint GLCompute [[INT2:%[0-9a-zA-Z_]+]] "local_int2"
+// CHECK: OpEntryPoint GLCompute [[UINT3:%[0-9a-zA-Z_]+]] "global_uint3"
+// CHECK: OpEntryPoint GLCompute [[FLOAT2:%[0-9a-zA-Z_]+]] "constant_float2"
+// CHECK-DAG: [[UINT:%[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[V2UINT:%[0-9a-zA-Z_]+]] = OpTypeVector [[UINT]] 2
+// CHECK-DAG: [[V3UINT:%[0-9a-zA-Z_]+]] = OpTypeVector [[UINT]] 3
+// CHECK-DAG: [[UINT_3:%[0-9a-zA-Z_]+]] = OpConstant [[UINT]] 3
+// CHECK-DAG: [[FLOAT:%[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK-DAG: [[V2FLOAT:%[0-9a-zA-Z_]+]] = OpTypeVector [[FLOAT]] 2
+
+// The __local array of int2 is loaded from as a whole vector.
+// CHECK: [[INT2]] = OpFunction
+// CHECK: OpLoad [[V2UINT]]
+// CHECK: OpFunctionEnd
+
+// The elements of a uint3 are 3 apart, loaded and stored one at a time.
+// CHECK: [[UINT3]] = OpFunction
+// CHECK: OpIMul [[UINT]] {{%[0-9a-zA-Z_]+}} [[UINT_3]]
+// CHECK: OpLoad [[UINT]]
+// CHECK: OpLoad [[UINT]]
+// CHECK: OpLoad [[UINT]]
+// CHECK: OpIMul [[UINT]] {{%[0-9a-zA-Z_]+}} [[UINT_3]]
+// CHECK: OpStore
+// CHECK: OpStore
+// CHECK: OpStore
+// CHECK: OpFunctionEnd
+
+// The float2 buffer is loaded from as a whole vector.
+// CHECK: [[FLOAT2]] = OpFunction
+// CHECK: OpLoad [[V2FLOAT]]
+// CHECK: OpFunctionEnd
+
+kernel void local_int2(global int2 *A, local int2 *B) {
+  size_t i = get_local_id(0);
+  B[i] = A[i];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  A[i] = vload2(i ^ 1, (local int *)B);
+}
+
+kernel void global_uint3(global uint *A, uint n) {
+  vstore3(vload3(n, A) + 1, n + 1, A);
+}
+
+kernel void constant_float2(global float2 *A, constant float2 *B) {
+  size_t i = get_global_id(0);
+  A[i] = vload2(i, (constant float *)B) * 2.0f;
+}
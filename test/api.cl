@@ -0,0 +1,14 @@
+// RUN: clspv %s -o %t.spv
+// RUN: clspv %s -O0 -o %t.O0.spv
+// RUN: clspv-api-test %s %t.spv %t.O0.spv
+
+// clspv::CompileFromSourceString gives the same output as the command line
+// tool, whatever the options of earlier calls, and on several threads at
+// once.
+
+kernel void foo(global float *A, global float *B, float f) {
+  size_t i = get_global_id(0);
+  for (int j = 0; j < 4; j++) {
+    A[i + j] = B[i + j] * f;
+  }
+}
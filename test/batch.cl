@@ -0,0 +1,49 @@
+// RUN: echo "%s -o %t.foo.spv -descriptormap=%t.foo.map" > %t.batch
+// RUN: echo "# Comments and blank lines are ignored." >> %t.batch
+// RUN: echo "" >> %t.batch
+// RUN: echo "%s -o %t.bar.spv -DNAME=bar" >> %t.batch
+// RUN: clspv -batch=%t.batch -batch-jobs=2 -cluster-pod-kernel-args
+// RUN: spirv-dis -o %t.foo.spvasm %t.foo.spv
+// RUN: FileCheck %s < %t.foo.spvasm
+// RUN: FileCheck -check-prefix=MAP %s < %t.foo.map
+// RUN: spirv-val --target-env vulkan1.0 %t.foo.spv
+// RUN: spirv-dis -o %t.bar.spvasm %t.bar.spv
+// RUN: FileCheck -check-prefix=BAR %s < %t.bar.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.bar.spv
+
+// A failed compilation is reported, and does not stop the others.
+// RUN: echo "%s.missing -o %t.missing.spv" > %t.fail.batch
+// RUN: echo "%s -o %t.ok.spv" >> %t.fail.batch
+// RUN: not clspv -batch=%t.fail.batch 2> %t.fail.log
+// RUN: FileCheck -check-prefix=FAIL %s < %t.fail.log
+// RUN: spirv-val --target-env vulkan1.0 %t.ok.spv
+
+// LLVM's options apply to the whole process, so a manifest line cannot give
+// one, though the common command line can.
+// RUN: echo "%s -o %t.llvm.spv -inline-threshold=1" > %t.llvm.batch
+// RUN: not clspv -batch=%t.llvm.batch 2> %t.llvm.log
+// RUN: FileCheck -check-prefix=LLVM %s < %t.llvm.log
+// RUN: echo "%s -o %t.common.spv" > %t.common.batch
+// RUN: clspv -batch=%t.common.batch -inline-threshold=1
+// RUN: spirv-val --target-env vulkan1.0 %t.common.spv
+
+// CHECK: OpEntryPoint GLCompute {{%[0-9a-zA-Z_]+}} "foo"
+// BAR: OpEntryPoint GLCompute {{%[0-9a-zA-Z_]+}} "bar"
+
+// The common -cluster-pod-kernel-args applies to the manifest's lines.
+// MAP: kernel,foo,arg,A,argOrdinal,0,descriptorSet,0,binding,0,offset,0,argKind,buffer
+// MAP-NEXT: kernel,foo,arg,c,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,pod
+// MAP-NEXT: kernel,foo,arg,d,argOrdinal,2,descriptorSet,0,binding,1,offset,4,argKind,pod
+
+// FAIL: fail.batch:1: Error: compilation failed
+// FAIL: .missing'
+// FAIL: Error: 1 of 2 compilations in '{{.*}}fail.batch' failed!
+
+// LLVM: llvm.batch:1: Error: compilation failed
+// LLVM: Error: LLVM option '-inline-threshold' applies to the whole process, so it cannot be given to a single compilation!
+
+#ifndef NAME
+#define NAME foo
+#endif
+
+kernel void NAME(global int *A, int c, int d) { A[0] = c + d; }
@@ -0,0 +1,39 @@
+// RUN: rm -rf %t.cache
+// RUN: clspv %s -o %t.spv -descriptormap=%t.map -cache-dir=%t.cache -time-report-json=%t.miss.json
+// RUN: ls %t.cache | FileCheck -check-prefix=ONE %s
+// RUN: FileCheck -check-prefix=MISS %s < %t.miss.json
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The same program, with the same options, is found in the cache, without
+// parsing it.
+// RUN: clspv %s -o %t.hit.spv -descriptormap=%t.hit.map -cache-dir=%t.cache -time-report-json=%t.hit.json
+// RUN: FileCheck -check-prefix=HIT %s < %t.hit.json
+// RUN: cmp %t.spv %t.hit.spv
+// RUN: cmp %t.map %t.hit.map
+// RUN: ls %t.cache | FileCheck -check-prefix=ONE %s
+
+// Different options make a new entry.
+// RUN: clspv %s -o %t.pod.spv -descriptormap=%t.pod.map -cache-dir=%t.cache -pod-ubo
+// RUN: ls %t.cache | FileCheck -check-prefix=TWO %s
+// RUN: FileCheck -check-prefix=POD %s < %t.pod.map
+
+// MISS: {"name": "Cache lookup",
+// MISS: {"name": "Parse and generate IR",
+// MISS: {"name": "SPIR-V Producer",
+
+// HIT: {"name": "Cache lookup",
+// HIT-NOT: "Parse and generate IR"
+// HIT-NOT: "SPIR-V Producer"
+
+// ONE: {{^[0-9A-F]+}}.map
+// ONE-NEXT: {{^[0-9A-F]+}}.out
+// ONE-NOT: {{.}}
+
+// TWO: {{^[0-9A-F]+}}.map
+// TWO-NEXT: {{^[0-9A-F]+}}.out
+// TWO-NEXT: {{^[0-9A-F]+}}.map
+// TWO-NEXT: {{^[0-9A-F]+}}.out
+
+// POD: kernel,foo,arg,c,argOrdinal,1,descriptorSet,0,binding,1,offset,0,argKind,pod_ubo
+
+kernel void foo(global int *A, int c) { A[0] = c; }
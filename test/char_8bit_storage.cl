@@ -0,0 +1,30 @@
+// RUN: clspv %s -S -o %t.spvasm -f8bit_storage
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv -f8bit_storage
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// With 8-bit storage, char and uchar4 buffers are loaded and stored as 8-bit
+// values, with no packing into 32-bit integers.
+
+// CHECK-DAG: OpCapability Int8
+// CHECK-DAG: OpCapability StorageBuffer8BitAccess
+// CHECK-DAG: OpExtension "SPV_KHR_8bit_storage"
+// CHECK-DAG: [[UCHAR:%[0-9a-zA-Z_]+]] = OpTypeInt 8 0
+// CHECK-DAG: [[UCHAR4:%[0-9a-zA-Z_]+]] = OpTypeVector [[UCHAR]] 4
+// CHECK-DAG: OpDecorate {{%[0-9a-zA-Z_]+}} ArrayStride 1
+// CHECK-DAG: OpDecorate {{%[0-9a-zA-Z_]+}} ArrayStride 4
+// CHECK-NOT: OpShiftLeftLogical
+// CHECK: OpLoad [[UCHAR]]
+// CHECK: OpStore
+// CHECK: OpLoad [[UCHAR4]]
+// CHECK: OpStore
+
+kernel void add_chars(global char *A, global char *B) {
+  size_t i = get_global_id(0);
+  A[i] = A[i] + B[i];
+}
+
+kernel void invert_pixels(global uchar4 *A) {
+  size_t i = get_global_id(0);
+  A[i] = (uchar4)(255) - A[i];
+}
@@ -0,0 +1,33 @@
+// RUN: clspv %s -S -o %t.spvasm -fp16 -f16bit_storage
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv -fp16 -f16bit_storage
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// With -fp16, arithmetic and extended instructions on half values are done
+// on 16-bit floats, with no conversion to 32-bit floats.
+
+// CHECK-DAG: OpCapability Float16
+// CHECK-DAG: OpCapability StorageBuffer16BitAccess
+// CHECK-DAG: [[HALF:%[0-9a-zA-Z_]+]] = OpTypeFloat 16
+// CHECK-DAG: [[HALF4:%[0-9a-zA-Z_]+]] = OpTypeVector [[HALF]] 4
+// CHECK-DAG: [[TWO:%[0-9a-zA-Z_]+]] = OpConstant [[HALF]] 2
+// CHECK-NOT: OpFConvert
+// CHECK: OpFMul [[HALF]] {{%[0-9a-zA-Z_]+}} [[TWO]]
+// CHECK: OpFAdd [[HALF]]
+// CHECK: OpExtInst [[HALF4]] {{%[0-9a-zA-Z_]+}} Sqrt
+// CHECK: OpExtInst [[HALF4]] {{%[0-9a-zA-Z_]+}} FClamp
+// CHECK-NOT: OpFConvert
+
+kernel void axpy(global half *Y, global half *X) {
+  size_t i = get_global_id(0);
+  // Separate statements, so the multiply and add are not contracted to fma.
+  half AX = X[i] * (half)2.0f;
+  Y[i] = AX + Y[i];
+}
+
+kernel void clamp_sqrt(global half4 *A) {
+  size_t i = get_global_id(0);
+  A[i] = clamp(sqrt(A[i]), (half4)((half)0.0f), (half4)((half)1.0f));
+}
@@ -0,0 +1,68 @@
+// RUN: clspv %s -S -o %t.spvasm -fp16 -f16bit_storage
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv -fp16 -f16bit_storage
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The overloads of clamp, min, max, fmin, fmax and mix that take half
+// scalars with half vectors splat the scalars, as they do for float, with
+// an insert and a shuffle.
+
+// CHECK-DAG: [[EXT:%[0-9a-zA-Z_]+]] = OpExtInstImport "GLSL.std.450"
+// CHECK-DAG: [[HALF:%[0-9a-zA-Z_]+]] = OpTypeFloat 16
+// CHECK-DAG: [[HALF4:%[0-9a-zA-Z_]+]] = OpTypeVector [[HALF]] 4
+// CHECK-DAG: [[HALF2:%[0-9a-zA-Z_]+]] = OpTypeVector [[HALF]] 2
+// CHECK-NOT: OpFConvert
+
+// CHECK: [[LO:%[0-9a-zA-Z_]+]] = OpVectorShuffle [[HALF4]]
+// CHECK: [[HI:%[0-9a-zA-Z_]+]] = OpVectorShuffle [[HALF4]]
+// CHECK: OpExtInst [[HALF4]] [[EXT]] FClamp {{%[0-9a-zA-Z_]+}} [[LO]] [[HI]]
+
+// CHECK: [[MAX:%[0-9a-zA-Z_]+]] = OpVectorShuffle [[HALF4]]
+// CHECK: OpExtInst [[HALF4]] [[EXT]] FMax {{%[0-9a-zA-Z_]+}} [[MAX]]
+
+// CHECK: [[FMAX:%[0-9a-zA-Z_]+]] = OpVectorShuffle [[HALF4]]
+// CHECK: OpExtInst [[HALF4]] [[EXT]] FMax {{%[0-9a-zA-Z_]+}} [[FMAX]]
+
+// CHECK: [[MIN:%[0-9a-zA-Z_]+]] = OpVectorShuffle [[HALF4]]
+// CHECK: OpExtInst [[HALF4]] [[EXT]] FMin {{%[0-9a-zA-Z_]+}} [[MIN]]
+
+// CHECK: [[FMIN:%[0-9a-zA-Z_]+]] = OpVectorShuffle [[HALF4]]
+// CHECK: OpExtInst [[HALF4]] [[EXT]] FMin {{%[0-9a-zA-Z_]+}} [[FMIN]]
+
+// CHECK: [[T:%[0-9a-zA-Z_]+]] = OpVectorShuffle [[HALF4]]
+// CHECK: OpExtInst [[HALF4]] [[EXT]] FMix {{%[0-9a-zA-Z_]+}} {{%[0-9a-zA-Z_]+}} [[T]]
+
+// CHECK: [[T2:%[0-9a-zA-Z_]+]] = OpVectorShuffle [[HALF2]]
+// CHECK: OpExtInst [[HALF2]] [[EXT]] FMix {{%[0-9a-zA-Z_]+}} {{%[0-9a-zA-Z_]+}} [[T2]]
+
+// CHECK-NOT: OpFConvert
+
+kernel void clamp_splat(global half4 *A, global half *B) {
+  *A = clamp(*A, B[0], B[1]);
+}
+
+kernel void max_splat(global half4 *A, global half *B) {
+  *A = max(*A, B[0]);
+}
+
+kernel void fmax_splat(global half4 *A, global half *B) {
+  *A = fmax(*A, B[0]);
+}
+
+kernel void min_splat(global half4 *A, global half *B) {
+  *A = min(*A, B[0]);
+}
+
+kernel void fmin_splat(global half4 *A, global half *B) {
+  *A = fmin(*A, B[0]);
+}
+
+kernel void mix_splat(global half4 *A, global half4 *C, global half *B) {
+  *A = mix(*A, *C, B[0]);
+}
+
+kernel void mix_splat2(global half2 *A, global half2 *C, global half *B) {
+  *A = mix(*A, *C, B[0]);
+}
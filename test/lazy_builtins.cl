@@ -0,0 +1,23 @@
+// REQUIRES: precompiled-builtins
+// RUN: clspv -lazy-builtins %s -S -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv -lazy-builtins %s -o %t.spv
+// RUN: spirv-dis -o %t2.spvasm %t.spv
+// RUN: FileCheck %s < %t2.spvasm
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Builtins declared on demand from the table lower the same way as those
+// declared by the full header: overloads on vector types and address spaces,
+// const builtins and convergent builtins all resolve.
+
+// CHECK: [[_1:%[0-9a-zA-Z_]+]] = OpExtInstImport "GLSL.std.450"
+// CHECK: OpEntryPoint GLCompute {{%[0-9a-zA-Z_]+}} "foo"
+// CHECK: OpExtInst {{%[0-9a-zA-Z_]+}} [[_1]] FAbs
+// CHECK: OpExtInst {{%[0-9a-zA-Z_]+}} [[_1]] FMax
+// CHECK: OpControlBarrier
+
+kernel void foo(global float4* A, local float4* B, float f) {
+  B[0] = fabs(A[get_global_id(0)]);
+  barrier(CLK_LOCAL_MEM_FENCE);
+  A[0] = fmax(B[1], f);
+}
@@ -0,0 +1,102 @@
+// RUN: clspv %s -S -o %t.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Each of the things the legalizer undoes, in one module.
+
+// CHECK: OpEntryPoint GLCompute [[SWITCH:%[0-9a-zA-Z_]+]] "switch_low_bits"
+// CHECK: OpEntryPoint GLCompute [[CLAMP:%[0-9a-zA-Z_]+]] "clamp_scalars"
+// CHECK: OpEntryPoint GLCompute [[SELECT:%[0-9a-zA-Z_]+]] "select_vectors"
+// CHECK: OpEntryPoint GLCompute [[CONSTANT:%[0-9a-zA-Z_]+]] "constant_index"
+// CHECK: OpEntryPoint GLCompute [[NESTED:%[0-9a-zA-Z_]+]] "nested_constant_index"
+// CHECK-DAG: [[UINT:%[0-9a-zA-Z_]+]] = OpTypeInt 32 0
+// CHECK-DAG: [[FLOAT:%[0-9a-zA-Z_]+]] = OpTypeFloat 32
+// CHECK-DAG: [[FLOAT4:%[0-9a-zA-Z_]+]] = OpTypeVector [[FLOAT]] 4
+// CHECK-DAG: [[BOOL:%[0-9a-zA-Z_]+]] = OpTypeBool
+// CHECK-DAG: [[BOOL2:%[0-9a-zA-Z_]+]] = OpTypeVector [[BOOL]] 2
+// CHECK-NOT: OpTypeInt 3
+// CHECK-NOT: OpTypeInt 8
+
+// The switch on the low bits of x stays on a 32-bit integer.
+// CHECK: [[SWITCH]] = OpFunction
+// CHECK: OpFunctionEnd
+
+// The scalar bounds of clamp are splatted.
+// CHECK: [[CLAMP]] = OpFunction
+// CHECK: OpExtInst [[FLOAT4]] {{%[0-9a-zA-Z_]+}} FClamp
+// CHECK: OpFunctionEnd
+
+// The scalar condition of the select is splatted.
+// CHECK: [[SELECT]] = OpFunction
+// CHECK: [[COND:%[0-9a-zA-Z_]+]] = OpVectorShuffle [[BOOL2]]
+// CHECK: OpSelect {{%[0-9a-zA-Z_]+}} [[COND]]
+// CHECK: OpFunctionEnd
+
+// The constant index into the __local array is an access chain.
+// CHECK: [[CONSTANT]] = OpFunction
+// CHECK: OpAccessChain
+// CHECK: OpFunctionEnd
+
+// Constant indices into a member of a __local struct nest one constant
+// expression in another.  Each becomes an access chain, including those
+// that reach a phi.
+// CHECK: [[NESTED]] = OpFunction
+// CHECK: OpAccessChain
+// CHECK: OpAccessChain
+// CHECK: OpFunctionEnd
+
+kernel void switch_low_bits(global int *A, int x) {
+  switch (x & 3) {
+  case 0:
+    *A = 10;
+    break;
+  case 1:
+    *A = 20;
+    break;
+  case 2:
+    *A = 30;
+    break;
+  default:
+    *A = 40;
+    break;
+  }
+}
+
+kernel void clamp_scalars(global float4 *A, float lo, float hi) {
+  size_t i = get_global_id(0);
+  A[i] = clamp(A[i], lo, hi);
+}
+
+kernel void select_vectors(global float2 *A, int c) {
+  *A = c ? A[1] * 2.0f : A[2] + 1.0f;
+}
+
+kernel void constant_index(global int *A) {
+  local int scratch[4];
+  scratch[get_local_id(0)] = A[get_local_id(0)];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  A[0] = scratch[2];
+}
+
+typedef struct {
+  int a[4];
+  int b[4];
+} pair;
+
+kernel void nested_constant_index(global int *A, int c) {
+  local pair p;
+  p.a[get_local_id(0)] = A[get_local_id(0)];
+  p.b[get_local_id(0)] = A[get_local_id(0) + 4];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  local int *b = p.b;
+  A[1] = b[2];
+  local int *q;
+  if (c) {
+    q = &p.a[1];
+    A[2] = c;
+  } else {
+    q = b + 3;
+  }
+  A[3] = *q;
+}
@@ -0,0 +1,42 @@
+// RUN: clspv %s -S -o %t.spvasm -opt-threads=2
+// RUN: clspv %s -S -o %t.threads.spvasm -opt-threads=0
+// RUN: cmp %t.spvasm %t.threads.spvasm
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv -opt-threads=4
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// The kernels keep their order, and each is still optimized.
+
+// CHECK: OpEntryPoint GLCompute [[SCALE:%[0-9a-zA-Z_]+]] "scale"
+// CHECK: OpEntryPoint GLCompute [[LOOKUP:%[0-9a-zA-Z_]+]] "lookup"
+// CHECK: OpEntryPoint GLCompute [[SCRATCH:%[0-9a-zA-Z_]+]] "scratch"
+// CHECK: [[SCALE]] = OpFunction
+// CHECK-NOT: OpVariable %{{.*}} Function
+// CHECK: [[LOOKUP]] = OpFunction
+// CHECK: [[SCRATCH]] = OpFunction
+// CHECK: OpControlBarrier
+
+constant float table[4] = {1.0f, 2.0f, 3.0f, 4.0f};
+
+float twice(float x) {
+  float y = x;
+  return y * 2.0f;
+}
+
+kernel void scale(global float *A) {
+  size_t i = get_global_id(0);
+  A[i] = twice(A[i]);
+}
+
+kernel void lookup(global float *A, int n) {
+  size_t i = get_global_id(0);
+  A[i] = twice(table[n & 3]);
+}
+
+kernel void scratch(global float *A) {
+  local float tile[64];
+  size_t i = get_local_id(0);
+  tile[i] = A[i];
+  barrier(CLK_LOCAL_MEM_FENCE);
+  A[i] = tile[63 - i];
+}
@@ -0,0 +1,15 @@
+// The module is written to the output file as it is produced.
+// RUN: clspv %s -o %t.spv
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv %s -o - > %t.stdout.spv
+// RUN: cmp %t.spv %t.stdout.spv
+
+// A failed compilation leaves the previous output alone.
+// RUN: not clspv %s -o %t.spv -DFAIL
+// RUN: cmp %t.spv %t.stdout.spv
+
+#ifdef FAIL
+#error failing on purpose
+#endif
+
+kernel void foo(global int *A, int c) { A[0] = c; }
@@ -0,0 +1,26 @@
+// RUN: clspv %s -print-pipeline | FileCheck -check-prefix=O2 %s
+// RUN: clspv %s -print-pipeline -O0 | FileCheck -check-prefix=O0 %s
+
+// The default pipeline, given with -passes, gives the same module.
+// RUN: clspv %s -o %t.spv
+// RUN: clspv %s -o %t.passes.spv -passes=ZeroInitializeAllocasPass,DefineOpenCLWorkItemBuiltins,OpenCLInliner,UndoByval,UndoSRet,ReplaceOpenCLBuiltin,mem2reg,HideConstantLoads,instcombine,InlineFuncWithPointerBitCastArg,InlineFuncWithPointerToFunctionArgPass,llvm-opt,UnhideConstantLoads,FunctionInternalizer,ReplaceLLVMIntrinsics,Legalize,structurizecfg,ReorderBasicBlocks,SimplifyPointerBitcast,ReplacePointerBitcast,RewriteInserts
+// RUN: cmp %t.spv %t.passes.spv
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// Unknown passes are rejected.
+// RUN: not clspv %s -o %t.bad.spv -passes=mem2reg,NoSuchPass 2>&1 | FileCheck -check-prefix=BAD %s
+
+// O2: {{^}}ZeroInitializeAllocasPass,DefineOpenCLWorkItemBuiltins,OpenCLInliner,UndoByval,UndoSRet,ReplaceOpenCLBuiltin,mem2reg,HideConstantLoads,instcombine,InlineFuncWithPointerBitCastArg,InlineFuncWithPointerToFunctionArgPass,llvm-opt,UnhideConstantLoads,FunctionInternalizer,ReplaceLLVMIntrinsics,Legalize,structurizecfg,ReorderBasicBlocks,SimplifyPointerBitcast,ReplacePointerBitcast,RewriteInserts{{$}}
+
+// O0-NOT: OpenCLInliner
+// O0: InlineFuncWithPointerToFunctionArgPass,mem2reg,sroa,instcombine,llvm-opt,
+
+// BAD: Error: Unknown pass 'NoSuchPass' in -passes!
+
+kernel void foo(global float *A, int n) {
+  for (int i = 0; i < n; i++) {
+    if (A[i] > 0.0f) {
+      A[i] = A[i] * 2.0f;
+    }
+  }
+}
@@ -0,0 +1,19 @@
+// RUN: clspv %s -S -o %t.spvasm -f16bit_storage
+// RUN: FileCheck %s < %t.spvasm
+// RUN: clspv %s -o %t.spv -f16bit_storage
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// With 16-bit storage, buffers of 16-bit types use its capability.
+
+// CHECK-DAG: OpCapability Int16
+// CHECK-DAG: OpCapability StorageBuffer16BitAccess
+// CHECK-DAG: OpExtension "SPV_KHR_16bit_storage"
+// CHECK-DAG: [[USHORT:%[0-9a-zA-Z_]+]] = OpTypeInt 16 0
+// CHECK-DAG: OpDecorate {{%[0-9a-zA-Z_]+}} ArrayStride 2
+// CHECK: OpLoad [[USHORT]]
+// CHECK: OpStore
+
+kernel void add_shorts(global short *A, global short *B) {
+  size_t i = get_global_id(0);
+  A[i] = A[i] + B[i];
+}
@@ -0,0 +1,41 @@
+// RUN: clspv %s -S -o %t.spvasm -pod-ubo -f8bit_storage -f16bit_storage
+// RUN: FileCheck %s < %t.spvasm
+// RUN: FileCheck -check-prefix=NOBUFFER %s < %t.spvasm
+// RUN: clspv %s -o %t.spv -pod-ubo -f8bit_storage -f16bit_storage
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+
+// RUN: clspv %s -S -o %t2.spvasm -pod-ubo -f8bit_storage -f16bit_storage -DWITH_BUFFER
+// RUN: FileCheck -check-prefix=BUFFER %s < %t2.spvasm
+// RUN: clspv %s -o %t2.spv -pod-ubo -f8bit_storage -f16bit_storage -DWITH_BUFFER
+// RUN: spirv-val --target-env vulkan1.0 %t2.spv
+
+// 8-bit and 16-bit POD arguments in a uniform buffer need the capabilities
+// for uniform buffers, and the ones for storage buffers only when a storage
+// buffer also holds them.
+
+// CHECK-DAG: OpCapability UniformAndStorageBuffer8BitAccess
+// CHECK-DAG: OpCapability {{UniformAndStorageBuffer16BitAccess|StorageUniform16}}
+// CHECK-DAG: OpExtension "SPV_KHR_8bit_storage"
+// CHECK-DAG: OpExtension "SPV_KHR_16bit_storage"
+// CHECK: OpTypePointer Uniform
+
+// With no storage buffer of 8-bit or 16-bit values, the whole module has no
+// capability for them.
+// NOBUFFER-NOT: OpCapability StorageBuffer8BitAccess
+// NOBUFFER-NOT: OpCapability StorageBuffer16BitAccess
+
+// BUFFER-DAG: OpCapability UniformAndStorageBuffer8BitAccess
+// BUFFER-DAG: OpCapability {{UniformAndStorageBuffer16BitAccess|StorageUniform16}}
+// BUFFER-DAG: OpCapability StorageBuffer8BitAccess
+// BUFFER-DAG: OpCapability StorageBuffer16BitAccess
+// BUFFER-DAG: OpExtension "SPV_KHR_8bit_storage"
+// BUFFER-DAG: OpExtension "SPV_KHR_16bit_storage"
+
+#ifdef WITH_BUFFER
+kernel void foo(char c, short s, global char *A, global short *B) {
+  A[0] = c;
+  B[0] = s;
+}
+#else
+kernel void foo(char c, short s, global int *A) { *A = c + s; }
+#endif
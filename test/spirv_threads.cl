@@ -0,0 +1,45 @@
+// RUN: clspv %s -o %t.spv -descriptormap=%t.map -spirv-threads=1
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv %s -o %t.threads.spv -descriptormap=%t.threads.map -spirv-threads=4
+// RUN: spirv-val --target-env vulkan1.0 %t.threads.spv
+// RUN: cmp %t.spv %t.threads.spv
+// RUN: cmp %t.map %t.threads.map
+
+// The module is the same whatever the number of threads, down to the IDs.
+// RUN: clspv %s -S -o %t.spvasm -spirv-threads=1
+// RUN: clspv %s -S -o %t.threads.spvasm -spirv-threads=0
+// RUN: cmp %t.spvasm %t.threads.spvasm
+// RUN: FileCheck %s < %t.threads.spvasm
+
+// CHECK: OpEntryPoint GLCompute [[SUM:%[0-9a-zA-Z_]+]] "sum"
+// CHECK: OpEntryPoint GLCompute [[SCALE:%[0-9a-zA-Z_]+]] "scale"
+// CHECK: OpEntryPoint GLCompute [[CLAMP:%[0-9a-zA-Z_]+]] "clamp_all"
+// CHECK: [[HELPER:%[0-9a-zA-Z_]+]] = OpFunction
+// CHECK: [[SUM]] = OpFunction
+// CHECK: OpPhi
+// CHECK: OpLoopMerge
+// CHECK: [[SCALE]] = OpFunction
+// CHECK: OpFunctionCall {{%[0-9a-zA-Z_]+}} [[HELPER]]
+// CHECK: [[CLAMP]] = OpFunction
+
+__attribute__((noinline)) float helper(float x, float y) {
+  return x > y ? x * y : x + y;
+}
+
+kernel void sum(global float *A, global float *B, int n) {
+  float total = 0.0f;
+  for (int i = 0; i < n; i++) {
+    total += A[i];
+  }
+  B[0] = total;
+}
+
+kernel void scale(global float *A, float f) {
+  size_t i = get_global_id(0);
+  A[i] = helper(A[i], f);
+}
+
+kernel void clamp_all(global int4 *A, int lo, int hi) {
+  size_t i = get_global_id(0);
+  A[i] = clamp(A[i], lo, hi);
+}
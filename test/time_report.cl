@@ -0,0 +1,20 @@
+// RUN: clspv %s -o %t.spv -time-report-json=%t.json
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: FileCheck %s < %t.json
+// RUN: clspv %s -o %t.spv -time-report 2>&1 | FileCheck -check-prefix=TEXT %s
+
+// CHECK: "wall_seconds":
+// CHECK: "steps": [
+// CHECK: {"name": "Frontend setup",
+// CHECK: {"name": "Parse and generate IR", {{.*}}"instructions_after":
+// CHECK: {"name": "Zero-initialize stack variables", {{.*}}"instructions_before":
+// CHECK: {"name": "SPIR-V Producer",
+
+// TEXT: Clspv compilation time report
+// TEXT: Wall Time{{.*}}Allocated{{.*}}IR Instructions
+// TEXT: Parse and generate IR
+// TEXT: LLVM optimizations
+// TEXT: SPIR-V Producer
+// TEXT: (100.0%) Total
+
+kernel void foo(global int *A, int c) { A[0] = c; }
@@ -0,0 +1,30 @@
+// RUN: clspv %s -o %t.spv -time-trace=%t.json
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: FileCheck %s < %t.json
+
+// Function bodies generated on worker threads are recorded as well.
+// RUN: clspv %s -o %t.threads.spv -time-trace=%t.threads.json -spirv-threads=2
+// RUN: FileCheck %s < %t.threads.json
+// RUN: FileCheck %s --check-prefix=THREADS < %t.threads.json
+
+// CHECK: {"traceEvents": [
+// CHECK: "name": "process_name", "args": {"name": "clspv {{.*}}time_trace.cl"}
+// CHECK-DAG: "name": "Parse and generate IR", "ts":
+// CHECK-DAG: "name": "Codegen function", {{.*}}"args": {"detail": "foo"}
+// CHECK-DAG: "name": "Codegen function", {{.*}}"args": {"detail": "bar"}
+// CHECK-DAG: "name": "LLVM optimizations", "ts":
+// CHECK-DAG: "name": "SPIR-V Producer", "ts":
+// CHECK-DAG: "name": "GenerateSPIRVTypes", "ts":
+// CHECK-DAG: "name": "GenerateFuncBody", {{.*}}"args": {"detail": "foo"}
+// CHECK-DAG: "name": "GenerateFuncBody", {{.*}}"args": {"detail": "bar"}
+// CHECK-DAG: "name": "HandleDeferredInstruction", "ts":
+// CHECK-DAG: "name": "WriteSPIRV", "ts":
+// CHECK: ], "displayTimeUnit": "ms"}
+
+// THREADS-DAG: "tid": 0, "name": "GenerateFunctions", "ts":
+// THREADS-DAG: "tid": {{[1-9][0-9]*}}, "name": "GenerateFuncBody", {{.*}}"args": {"detail": "foo"}
+// THREADS-DAG: "tid": {{[1-9][0-9]*}}, "name": "GenerateFuncBody", {{.*}}"args": {"detail": "bar"}
+
+kernel void foo(global int *A, int c) { A[0] = c; }
+
+kernel void bar(global float *A, float c) { A[1] = c; }
@@ -0,0 +1,18 @@
+// RUN: clspv %s -O0 -o %t.spv -zero-allocas-report 2>&1 | FileCheck -check-prefix=ALL %s
+// RUN: spirv-val --target-env vulkan1.0 %t.spv
+// RUN: clspv %s -O0 -o %t.needed.spv -zero-allocas-as-needed -zero-allocas-report 2>&1 | FileCheck -check-prefix=NEEDED %s
+// RUN: spirv-val --target-env vulkan1.0 %t.needed.spv
+
+// Every stack variable is zeroed by default.
+// ALL: Zero-initialized [[TOTAL:[0-9]+]] of [[TOTAL]] bytes of stack variables in foo, 0 bytes elided
+
+// The arguments are written before they are read, as are the first two
+// elements of t.  Only the last two elements of t may be read unwritten.
+// NEEDED: Zero-initialized 8 of [[TOTAL:[0-9]+]] bytes of stack variables in foo, {{[1-9][0-9]*}} bytes elided
+
+kernel void foo(global int *A, int n) {
+  int t[4];
+  t[0] = A[0];
+  t[1] = A[1];
+  A[2] = t[0] + t[1] + t[n & 3];
+}
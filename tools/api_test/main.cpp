@@ -0,0 +1,132 @@
+// Copyright 2018 The Clspv Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Checks clspv::CompileFromSourceString against the command line tool.
+//
+//   clspv-api-test <input .cl file> <default .spv> <-O0 .spv>
+//
+// where the .spv files are the command line tool's output for the input,
+// without options and with -O0.  Compiles the input in memory:
+//  - without options, then with -O0, then without options again, so that
+//    the options of one call must not leak into the next;
+//  - without options on two threads at once;
+//  - with an LLVM option, which must be rejected;
+// and checks each result matches the command line tool's.
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clspv/Compiler.h"
+
+namespace {
+
+// Reads the file |filename| into |contents|.  Returns false on failure.
+bool ReadFile(const char *filename, std::string *contents) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  contents->assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+  return true;
+}
+
+// Compiles |program| with |options| into |binary|, as bytes.  Returns false
+// after writing the log to std::cerr on failure.
+bool Compile(const std::string &program, const std::string &options,
+             std::string *binary) {
+  std::vector<uint32_t> words;
+  std::string log;
+  if (clspv::CompileFromSourceString(program, "", options, &words, nullptr,
+                                     &log)) {
+    std::cerr << "Compiling with options '" << options << "' failed:\n"
+              << log;
+    return false;
+  }
+  binary->assign(reinterpret_cast<const char *>(words.data()),
+                 words.size() * sizeof(uint32_t));
+  return true;
+}
+
+// Returns true if |actual| is |expected|, else writes a message naming
+// |what| to std::cerr and returns false.
+bool Matches(const std::string &actual, const std::string &expected,
+             const char *what) {
+  if (actual != expected) {
+    std::cerr << what << " does not match the command line tool's output\n";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(const int argc, const char *const argv[]) {
+  if (argc != 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " <input .cl file> <default .spv> <-O0 .spv>\n";
+    return 1;
+  }
+
+  std::string program, expected, expectedO0;
+  if (!ReadFile(argv[1], &program) || !ReadFile(argv[2], &expected) ||
+      !ReadFile(argv[3], &expectedO0)) {
+    std::cerr << "Cannot read the input files\n";
+    return 1;
+  }
+
+  bool ok = true;
+
+  // One call after another, with different options.
+  std::string first, withO0, second;
+  if (!Compile(program, "", &first) || !Compile(program, "-O0", &withO0) ||
+      !Compile(program, "", &second)) {
+    return 1;
+  }
+  ok &= Matches(first, expected, "The first compilation");
+  ok &= Matches(withO0, expectedO0, "The compilation with -O0");
+  ok &= Matches(second, expected, "The compilation after the one with -O0");
+
+  // Two calls at once.
+  std::string threaded[2];
+  bool compiled[2] = {false, false};
+  std::thread threads[2];
+  for (int i = 0; i < 2; i++) {
+    threads[i] = std::thread([&program, &threaded, &compiled, i]() {
+      compiled[i] = Compile(program, "", &threaded[i]);
+    });
+  }
+  for (int i = 0; i < 2; i++) {
+    threads[i].join();
+    if (!compiled[i]) {
+      return 1;
+    }
+    ok &= Matches(threaded[i], expected, "A concurrent compilation");
+  }
+
+  // LLVM's own options would outlive the call, so they are rejected.
+  std::vector<uint32_t> words;
+  if (!clspv::CompileFromSourceString(program, "", "-inline-threshold=1",
+                                      &words)) {
+    std::cerr << "An LLVM option was not rejected\n";
+    ok = false;
+  }
+
+  return ok ? 0 : 1;
+}
@@ -103,7 +103,9 @@ class GoodCommit(object):
         command_output(['git', 'clone', self.GetUrl(), '.'], self.subdir)
 
     def Fetch(self):
-        command_output(['git', 'fetch', DEPS_REMOTE, self.branch], self.subdir)
+        # The known-good commit may be given as a release tag.
+        command_output(['git', 'fetch', '--tags', DEPS_REMOTE, self.branch],
+                       self.subdir)
 
     def Checkout(self):
         if not os.path.exists(os.path.join(self.subdir,'.git')):